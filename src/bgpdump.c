@@ -30,6 +30,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <locale.h>
+#include <unistd.h>
 
 #include "benchmark.h"
 #include "queue.h"
@@ -48,6 +49,17 @@
 #include "bgpdump_peer.h"
 #include "bgpdump_peerstat.h"
 #include "bgpdump_heatmap.h"
+#include "bgpdump_community.h"
+#include "bgpdump_filter.h"
+#include "bgpdump_aspath_regex.h"
+#include "bgpdump_sink.h"
+#include "bgpdump_sample.h"
+#include "bgpdump_obuf.h"
+#include "bgpdump_output.h"
+#include "bgpdump_extract.h"
+#include "bgpdump_index.h"
+#include "bgpdump_server.h"
+#include "bgpdump_diff.h"
 
 extern int optind;
 
@@ -58,15 +70,14 @@ struct ptree *ptree[AF_INET6 + 1];
 
 int qafi = 0;
 
-unsigned long autnums[AUTLIM];
+unsigned long *autnums = NULL;
 int autsiz = 0;
-
-struct bgp_route *diff_table[2];
-struct ptree *diff_ptree[2];
+int autlim = 0;
 
 char *filepath = NULL;         /* current file-path in process */
 char *filename = NULL;         /* current file-name in process */
 uint64_t processed_bytes = 0;  /* processed bytes in the file */
+int file_done = 0;             /* the rest of the file is not needed */
 
 int
 bgpdump_process (char *buf, size_t *data_len)
@@ -89,10 +100,13 @@ bgpdump_process (char *buf, size_t *data_len)
     printf ("%s(): mrt message: length: %'lu bytes.\n", __func__, len);
 
   /* Process as long as entire MRT message is in the buffer */
-  while (len && p + hsize + len <= data_end)
+  while (len && p + hsize + len <= data_end && ! file_done)
     {
       bgpdump_process_mrt_header (h, &info);
 
+      if (index_build)
+        index_message (h, p + hsize + len);
+
       switch (mrt_type)
         {
         case BGPDUMP_TYPE_TABLE_DUMP_V2:
@@ -123,7 +137,7 @@ bgpdump_process (char *buf, size_t *data_len)
 
   /* move the partial, last-part data
      to the beginning of the buffer. */
-  rest = data_end - p;
+  rest = (file_done ? 0 : data_end - p);
   if (rest)
     memmove (buf, p, rest);
   *data_len = rest;
@@ -139,6 +153,7 @@ int
 main (int argc, char **argv)
 {
   int status = 0;
+  char **args = argv;
   int i;
 
   setlocale (LC_ALL, "");
@@ -156,6 +171,49 @@ main (int argc, char **argv)
   if (status)
     return status;
 
+  /* the rebuild for the reload of the lookup server: it only saves
+     the tables, and leaves the files of the parent (-o, -E, -W, -x,
+     -X, -Q) alone, which the parent may be writing. */
+  if (serve_path && getenv (SERVER_RELOAD_ENV))
+    {
+      save_file = getenv (SERVER_RELOAD_ENV);
+      serve_path = NULL;
+      output_file = NULL;
+      output_compress = -1;
+      export_file = NULL;
+      mrt_file = NULL;
+      extract = 0;
+      index_build = 0;
+      publish_name = NULL;
+    }
+
+  /* with -x, -Z compresses the extracted files. */
+  if (extract)
+    {
+      if (output_compress > 0)
+        extract_compress = output_compress;
+      output_compress = -1;
+    }
+
+  /* the output stage: to the file, compressed, or simply
+     to the stdout that is not a terminal (e.g., a pipe). */
+  if (output_file && output_compress < 0)
+    {
+      file_format_t format = get_file_format (output_file);
+      if (format == FORMAT_GZIP)
+        output_compress = OUTPUT_COMPRESS_GZIP;
+      else if (format == FORMAT_ZSTD)
+        output_compress = OUTPUT_COMPRESS_ZSTD;
+    }
+  if (output_compress < 0)
+    output_compress = OUTPUT_COMPRESS_NONE;
+  if (output_file || output_compress || ! isatty (fileno (stdout)))
+    {
+      if (output_open (output_file, output_compress) < 0)
+        exit (-1);
+    }
+  obuf_setup ();
+
 #if 0
   if (argc == 0)
     {
@@ -171,16 +229,35 @@ main (int argc, char **argv)
       printf ("nroutes = %'llu\n", nroutes);
     }
 
+  /* the savefile keeps the routes in the lazy form. */
+  if (save_file || load_file || publish_name)
+    lazy = 1;
+
+  if (filter)
+    {
+      if (filter_compile (filter_expr) < 0)
+        {
+          printf ("malformed filter: %s\n",
+                  (filter_expr ? filter_expr : "(aspath-regex)"));
+          exit (-1);
+        }
+      if (verbose)
+        {
+          filter_program_print ();
+          if (aspath_regex_size)
+            aspath_regex_print ();
+        }
+    }
+
   /* default cmd */
   if (! brief && ! show && ! route_count && ! route_count_peers &&
       ! plen_dist && ! udiff &&
       ! lookup && ! peer_table_only && ! stat && ! compat_mode &&
-      ! autsiz && ! heatmap)
+      ! autsiz && ! heatmap && ! export_file &&
+      ! mrt_file && ! index_build && ! save_file &&
+      ! publish_name && ! serve_path && ! peer_matrix)
     show++;
 
-  if (stat)
-    peer_stat_init ();
-
   char *buf;
   buf = malloc (bufsiz);
   if (! buf)
@@ -194,51 +271,52 @@ main (int argc, char **argv)
     printf ("buf: %p (%'lluB-size)\n", buf, bufsiz);
 
   peer_table_init ();
+  community_init ();
 
-  if (peer_spec_size)
+  if (load_file)
     {
-      if (peer_spec_size >= PEER_INDEX_MAX)
-        peer_spec_size = PEER_INDEX_MAX;
-      for (i = 0; i < peer_spec_size; i++)
+      if (lookup_join)
         {
-          peer_route_table[i] = route_table_create ();
-          peer_route_size[i] = 0;
-          peer_ptree[i] = ptree_create ();
+          printf ("the lookup join (-J) reads the rib files, "
+                  "not the savefile (-O).\n");
+          exit (-1);
         }
-    }
-
-  if (unified)
-    {
-      for (i = 0; i < 1; i++)
+      if (argc)
         {
-          peer_route_table[i] = route_table_create ();
-          peer_route_size[i] = 0;
-          peer_ptree[i] = ptree_create ();
+          printf ("no rib file can be read with the savefile (-O).\n");
+          exit (-1);
         }
+      if (savefile_open (load_file) < 0)
+        exit (-1);
     }
 
-  if (lookup)
-    {
-      route_init ();
-      ptree[AF_INET] = ptree_create ();
-      ptree[AF_INET6] = ptree_create ();
-    }
-
-  if (udiff)
+  /* the diff of the two files: each is read by a child, and the
+     parent merges them at the end (see bgpdump_diff.h). */
+  if (diff_files)
     {
-      diff_table[0] = malloc (nroutes * sizeof (struct bgp_route));
-      diff_table[1] = malloc (nroutes * sizeof (struct bgp_route));
-      assert (diff_table[0] && diff_table[1]);
-      memset (diff_table[0], 0, nroutes * sizeof (struct bgp_route));
-      memset (diff_table[1], 0, nroutes * sizeof (struct bgp_route));
-
-      if (udiff_lookup)
+      if (load_file)
         {
-          diff_ptree[0] = ptree_create ();
-          diff_ptree[1] = ptree_create ();
+          printf ("the diff (-D) reads the rib files, "
+                  "not the savefile (-O).\n");
+          exit (-1);
+        }
+      if (! brief && ! compat_mode)
+        show = 1;
+      i = diff_start (argc, argv);
+      if (i == DIFF_MERGE)
+        argc = 0;
+      else
+        {
+          argv += i;
+          argc = 1;
         }
     }
 
+  sink_setup ();
+  if (debug)
+    sink_print ();
+  sink_init ();
+
   /* for each rib files. */
   for (i = 0; i < argc; i++)
     {
@@ -248,19 +326,43 @@ main (int argc, char **argv)
       struct access_method *method;
       void *file;
       size_t ret;
+      int index_ret;
 
       filename = get_file_filename (filepath);
       format = get_file_format (filepath);
       method = get_access_method (format);
+      if (! method)
+        {
+          fprintf (stderr, "# unsupported file format: %s\n", filepath);
+          diff_file_error (filepath);
+          continue;
+        }
+
+      /* read only the records selected by the index. the records
+         already processed are not read again on a failure. */
+      if (index_use && ! index_build &&
+          (index_ret = index_process (filepath, method, buf, bufsiz)) != -1)
+        {
+          if (index_ret == INDEX_FAILED)
+            status = -1;
+          sink_file_end ();
+          continue;
+        }
+
       file = method->fopen (filepath, "r");
       if (! file)
         {
           fprintf (stderr, "# could not open file: %s\n", filepath);
+          diff_file_error (filepath);
           continue;
         }
 
       size_t datalen = 0;
       processed_bytes = 0;
+      file_done = 0;
+
+      if (index_build)
+        index_file_start (filepath);
 
       while (1)
         {
@@ -284,11 +386,15 @@ main (int argc, char **argv)
               printf ("bgpdump_process(): failed: ret: %ld.\n", ret);
               printf ("processed bytes: %'llu.\n",
                       (unsigned long long)processed_bytes);
+              diff_file_error (filepath);
               break;
             }
 
           if (debug)
             printf ("process rest: %'lu bytes\n", datalen);
+
+          if (file_done)
+            break;
         }
 
       if (datalen)
@@ -299,183 +405,41 @@ main (int argc, char **argv)
         }
       method->fclose (file);
 
-      /* For each end of the processing of files. */
-      if (route_count)
-        {
-          peer_route_count_show ();
-          peer_route_count_clear ();
-        }
-      if (route_count_peers)
-        {
-          peer_route_count_list ();
-        }
-
-      if (plen_dist)
-        {
-          peer_route_count_by_plen_show ();
-          peer_route_count_by_plen_clear ();
-        }
-    }
+      if (index_build)
+        index_file_end ();
 
-  if (extract)
-    {
-      for (i = 0; i < peer_size; i++)
-        {
-          if (peer_table[i].fp)
-            fclose (peer_table[i].fp);
-        }
-    }
-
-  /* query_table construction. */
-  if (lookup)
-    {
-      if (! qafi && lookup_addr)
-        {
-          struct in6_addr tmp;
-          if (inet_pton (AF_INET6, lookup_addr, &tmp) == 1)
-            qafi = AF_INET6;
-          else
-            qafi = AF_INET;
-        }
-
-      if (! qafi)
-        qafi = AF_INET;
-
-      printf ("lookup: query afi: %d\n", qafi);
-
-      query_limit = 0;
-
-      if (lookup_file)
-        query_limit = query_file_count (lookup_file);
-
-      if (lookup_addr)
-        query_limit++;
-
-      query_init ();
-
-      if (lookup_addr)
-        query_addr (lookup_addr);
-
-      if (lookup_file)
-        query_file (lookup_file);
-
-      if (debug)
-        query_list ();
-    }
-
-  /* query to route_table (ptree). */
-  if (lookup)
-    {
-      if (benchmark)
-        benchmark_start ();
-
-      if (lookup)
-        {
-          if (! peer_spec_size)
-            printf ("warning: no peer spec. lookup needs a specified peer.\n");
-          for (i = 0; i < peer_spec_size; i++)
-            {
-              printf ("peer %d:\n", peer_spec_index[i]);
-              if (verbose)
-                ptree_list (peer_ptree[i]);
-              ptree_query (peer_spec_index[i], peer_ptree[i], query_table, query_size);
-            }
-        }
-
-      if (benchmark)
-        {
-          benchmark_stop ();
-          benchmark_print (query_size);
-        }
-    }
-
-  if (unified)
-    {
-      int peer_index = 0;
-      FILE *fp = stdout;
-      struct bgp_route *rp;
-      struct ptree_node *x;
-      for (x = ptree_head (peer_ptree[0]); x; x = ptree_next (x))
-        {
-          rp = (struct bgp_route *) x->data;
-          if (! rp)
-            continue;
-
-          if (brief)
-            route_print_brief (fp, peer_index, rp);
-          else if (show)
-            route_print (fp, peer_index, rp);
-          else if (compat_mode)
-            route_print_compat (fp, peer_index, rp);
-        }
-    }
-
-  if (heatmap)
-    {
-      if (! strcmp (heatmap_prefix, "testprint"))
-        {
-          struct ptree *ptree;
-          unsigned char addr[4] = {0};
-          for (i = 0; i < 256; i++)
-            {
-              addr[0] = (unsigned char) i;
-              ptree = ptree_create ();
-              ptree_add ((char *)addr, 8, (void *)1, ptree);
-              heatmap_image_hilbert_gplot (i);
-              heatmap_image_hilbert_data (i, ptree);
-              ptree_delete (ptree);
-            }
-        }
-      else
-        {
-          for (i = 0; i < peer_spec_size; i++)
-            {
-              int peer_index = peer_spec_index[i];
-              struct ptree *ptree = peer_ptree[i];
-              heatmap_image_hilbert_gplot (peer_index);
-              heatmap_image_hilbert_data (peer_index, ptree);
-              //heatmap_image_hilbert_data_aspath_max_distance (peer_index);
-            }
-        }
+      /* For each end of the processing of files. */
+      sink_file_end ();
     }
 
-  if (lookup)
-    {
-      free (query_table);
-      ptree_delete (ptree[AF_INET]);
-      ptree_delete (ptree[AF_INET6]);
-      route_finish ();
-    }
+  if (serve_path && server_run (serve_path, args) < 0)
+    status = -1;
 
-  if (udiff)
-    {
-      free (diff_table[0]);
-      free (diff_table[1]);
+  sink_finish ();
+  savefile_close ();
 
-      if (lookup)
-        {
-          ptree_delete (diff_ptree[0]);
-          ptree_delete (diff_ptree[1]);
-        }
-    }
+  if (verbose && sample_rate)
+    sample_print ();
 
-  if (stat)
-    {
-      peer_stat_show ();
-      //peer_stat_finish ();
-    }
+  peer_spec_finish ();
 
-  if (peer_spec_size)
+  if (lazy)
     {
-      for (i = 0; i < peer_spec_size; i++)
-        {
-          free (peer_route_table[i]);
-          ptree_delete (peer_ptree[i]);
-        }
+      if (verbose)
+        printf ("lazy: %'llu bytes of raw attributes retained.\n",
+                (unsigned long long) route_arena_size);
+      route_arena_finish ();
     }
 
+  if (verbose && aspath_regex_size)
+    aspath_regex_print ();
+  aspath_regex_finish ();
+  community_finish ();
+  peer_table_finish ();
+  free (autnums);
   free (buf);
 
+  output_close ();
   return status;
 }
 
@@ -24,8 +24,9 @@
 #endif /*MIN*/
 
 #define AUTLIM 8
-extern unsigned long autnums[];
+extern unsigned long *autnums;
 extern int autsiz;
+extern int autlim;
 
 extern struct ptree *ptree[];
 #define ROUTE_ORIG_SIZE (1000 * 1000 * 1000)
@@ -36,6 +37,9 @@ extern int qafi;
 
 extern char *filename;
 extern uint64_t processed_bytes;
+extern int file_done;
+
+int bgpdump_process (char *buf, size_t *data_len);
 
 #endif /*_BGPDUMP_H_*/
 
@@ -0,0 +1,990 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The patterns are parsed into one Thompson NFA whose input symbols
+ * are the ASN "classes": the 32-bit ASN space is partitioned into the
+ * intervals between the ASNs and the ranges in the patterns, and the
+ * intervals that every atom of the patterns treats alike share one
+ * class. Two more classes mark the beginning and the end of the path,
+ * for "^" and "$". Each pattern P is wrapped as "(^|.)* P (.|$)*",
+ * and the subset construction makes the DFA over the classes.
+ *
+ * An ASN is mapped to its class with a perfect hash (hash and
+ * displace) of the literal ASNs in the patterns, falling back to a
+ * binary search of the intervals only when ranges are used.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <sys/types.h>
+#include <assert.h>
+
+#include "bgpdump_route.h"
+#include "bgpdump_aspath_regex.h"
+
+#define ASPATH_DFA_STATE_MAX (64 * 1024)
+
+#define ATOM_ANY   0
+#define ATOM_BEGIN 1
+#define ATOM_END   2
+#define ATOM_ASN   3
+
+#define CLASS_BEGIN 0
+#define CLASS_END   1
+
+struct aspath_atom
+{
+  int type;
+  int negate;
+  int nranges;
+  uint32_t *lo;
+  uint32_t *hi;
+};
+
+struct aspath_nfa
+{
+  int atom;     /* -1 for the epsilon transitions. */
+  int out1;
+  int out2;
+  int accept;   /* pattern index + 1. */
+};
+
+struct aspath_frag
+{
+  int start;
+  int end;
+};
+
+char *aspath_regex_pattern[ASPATH_REGEX_MAX];
+int aspath_regex_size = 0;
+uint64_t aspath_regex_count[ASPATH_REGEX_MAX];
+
+struct aspath_atom *atoms = NULL;
+int natoms = 0;
+
+struct aspath_nfa *nfa = NULL;
+int nnfa = 0;
+int nfa_limit = 0;
+int nfa_pattern_start[ASPATH_REGEX_MAX];
+
+/* the partition of the ASN space into the classes. */
+uint32_t *interval_start = NULL;
+int *interval_class = NULL;
+int ninterval = 0;
+int nclasses = 0;
+int interval_search = 0;
+int default_class = 0;
+
+/* perfect hash of the literal ASNs. */
+uint32_t *phash_key = NULL;
+int *phash_class = NULL;
+uint32_t *phash_disp = NULL;
+uint32_t phash_size = 0;
+uint32_t phash_nbucket = 0;
+int nliteral = 0;
+
+/* DFA */
+uint32_t *dfa_delta = NULL;
+uint64_t *dfa_accept = NULL;
+int ndfa = 0;
+int dfa_start = 0;
+
+/* the lexer. */
+enum re_token
+{
+  TOK_END, TOK_NUM, TOK_DOT, TOK_STAR, TOK_PLUS, TOK_QMARK, TOK_BAR,
+  TOK_LPAREN, TOK_RPAREN, TOK_LBRACK, TOK_CARET, TOK_DOLLAR, TOK_ERROR
+};
+
+char *re_p;
+enum re_token re_tok;
+uint32_t re_val;
+
+static void
+re_lex ()
+{
+  char *endptr;
+  unsigned long val;
+
+  while (*re_p && (isspace ((unsigned char) *re_p) || *re_p == '_'))
+    re_p++;
+
+  switch (*re_p)
+    {
+    case '\0':
+      re_tok = TOK_END;
+      return;
+    case '.':
+      re_tok = TOK_DOT;
+      break;
+    case '*':
+      re_tok = TOK_STAR;
+      break;
+    case '+':
+      re_tok = TOK_PLUS;
+      break;
+    case '?':
+      re_tok = TOK_QMARK;
+      break;
+    case '|':
+      re_tok = TOK_BAR;
+      break;
+    case '(':
+      re_tok = TOK_LPAREN;
+      break;
+    case ')':
+      re_tok = TOK_RPAREN;
+      break;
+    case '[':
+      re_tok = TOK_LBRACK;
+      break;
+    case '^':
+      re_tok = TOK_CARET;
+      break;
+    case '$':
+      re_tok = TOK_DOLLAR;
+      break;
+    default:
+      if (isdigit ((unsigned char) *re_p))
+        {
+          val = strtoul (re_p, &endptr, 10);
+          if (val > 0xffffffffUL)
+            {
+              re_tok = TOK_ERROR;
+              return;
+            }
+          re_val = val;
+          re_tok = TOK_NUM;
+          re_p = endptr;
+          return;
+        }
+      re_tok = TOK_ERROR;
+      return;
+    }
+  re_p++;
+}
+
+static int
+nfa_new (int atom, int out1, int out2)
+{
+  if (nnfa == nfa_limit)
+    {
+      nfa_limit = (nfa_limit ? nfa_limit * 2 : 256);
+      nfa = realloc (nfa, nfa_limit * sizeof (struct aspath_nfa));
+      assert (nfa);
+    }
+  nfa[nnfa].atom = atom;
+  nfa[nnfa].out1 = out1;
+  nfa[nnfa].out2 = out2;
+  nfa[nnfa].accept = 0;
+  return nnfa++;
+}
+
+static int
+atom_new (int type)
+{
+  atoms = realloc (atoms, (natoms + 1) * sizeof (struct aspath_atom));
+  assert (atoms);
+  memset (&atoms[natoms], 0, sizeof (struct aspath_atom));
+  atoms[natoms].type = type;
+  return natoms++;
+}
+
+static void
+atom_add_range (int atom, uint32_t lo, uint32_t hi)
+{
+  struct aspath_atom *a = &atoms[atom];
+  a->lo = realloc (a->lo, (a->nranges + 1) * sizeof (uint32_t));
+  a->hi = realloc (a->hi, (a->nranges + 1) * sizeof (uint32_t));
+  assert (a->lo && a->hi);
+  a->lo[a->nranges] = lo;
+  a->hi[a->nranges] = hi;
+  a->nranges++;
+}
+
+static void
+frag_atom (struct aspath_frag *f, int atom)
+{
+  f->end = nfa_new (-1, -1, -1);
+  f->start = nfa_new (atom, f->end, -1);
+}
+
+/* "[<asn> <asn>-<asn> ...]" or "[^...]", just after the '['. */
+static int
+re_parse_set (struct aspath_frag *f)
+{
+  int atom;
+  char *endptr;
+  unsigned long lo, hi;
+
+  atom = atom_new (ATOM_ASN);
+  if (*re_p == '^')
+    {
+      atoms[atom].negate = 1;
+      re_p++;
+    }
+
+  while (1)
+    {
+      while (*re_p && (isspace ((unsigned char) *re_p) || *re_p == ','))
+        re_p++;
+      if (*re_p == ']')
+        {
+          re_p++;
+          break;
+        }
+      if (! isdigit ((unsigned char) *re_p))
+        return -1;
+      lo = strtoul (re_p, &endptr, 10);
+      re_p = endptr;
+      hi = lo;
+      if (*re_p == '-')
+        {
+          re_p++;
+          if (! isdigit ((unsigned char) *re_p))
+            return -1;
+          hi = strtoul (re_p, &endptr, 10);
+          re_p = endptr;
+        }
+      if (lo > 0xffffffffUL || hi > 0xffffffffUL || hi < lo)
+        return -1;
+      atom_add_range (atom, lo, hi);
+    }
+
+  if (atoms[atom].nranges == 0)
+    return -1;
+
+  frag_atom (f, atom);
+  re_lex ();
+  return 0;
+}
+
+static int re_parse_alt (struct aspath_frag *f);
+
+static int
+re_parse_atom (struct aspath_frag *f)
+{
+  int atom;
+
+  switch (re_tok)
+    {
+    case TOK_NUM:
+      atom = atom_new (ATOM_ASN);
+      atom_add_range (atom, re_val, re_val);
+      frag_atom (f, atom);
+      re_lex ();
+      return 0;
+    case TOK_DOT:
+      frag_atom (f, ATOM_ANY);
+      re_lex ();
+      return 0;
+    case TOK_CARET:
+      frag_atom (f, ATOM_BEGIN);
+      re_lex ();
+      return 0;
+    case TOK_DOLLAR:
+      frag_atom (f, ATOM_END);
+      re_lex ();
+      return 0;
+    case TOK_LBRACK:
+      return re_parse_set (f);
+    case TOK_LPAREN:
+      re_lex ();
+      if (re_parse_alt (f) < 0)
+        return -1;
+      if (re_tok != TOK_RPAREN)
+        return -1;
+      re_lex ();
+      return 0;
+    default:
+      return -1;
+    }
+}
+
+static int
+re_parse_repeat (struct aspath_frag *f)
+{
+  int s, e;
+
+  if (re_parse_atom (f) < 0)
+    return -1;
+
+  while (re_tok == TOK_STAR || re_tok == TOK_PLUS || re_tok == TOK_QMARK)
+    {
+      e = nfa_new (-1, -1, -1);
+      switch (re_tok)
+        {
+        case TOK_STAR:
+          s = nfa_new (-1, f->start, e);
+          nfa[f->end].out1 = f->start;
+          nfa[f->end].out2 = e;
+          break;
+        case TOK_PLUS:
+          s = f->start;
+          nfa[f->end].out1 = f->start;
+          nfa[f->end].out2 = e;
+          break;
+        default:
+          s = nfa_new (-1, f->start, e);
+          nfa[f->end].out1 = e;
+          break;
+        }
+      f->start = s;
+      f->end = e;
+      re_lex ();
+    }
+  return 0;
+}
+
+static int
+re_parse_concat (struct aspath_frag *f)
+{
+  struct aspath_frag g;
+
+  f->start = f->end = nfa_new (-1, -1, -1);
+  while (re_tok == TOK_NUM || re_tok == TOK_DOT || re_tok == TOK_LBRACK ||
+         re_tok == TOK_LPAREN || re_tok == TOK_CARET || re_tok == TOK_DOLLAR)
+    {
+      if (re_parse_repeat (&g) < 0)
+        return -1;
+      nfa[f->end].out1 = g.start;
+      f->end = g.end;
+    }
+  return 0;
+}
+
+static int
+re_parse_alt (struct aspath_frag *f)
+{
+  struct aspath_frag g;
+  int s, e;
+
+  if (re_parse_concat (f) < 0)
+    return -1;
+  while (re_tok == TOK_BAR)
+    {
+      re_lex ();
+      if (re_parse_concat (&g) < 0)
+        return -1;
+      e = nfa_new (-1, -1, -1);
+      s = nfa_new (-1, f->start, g.start);
+      nfa[f->end].out1 = e;
+      nfa[g.end].out1 = e;
+      f->start = s;
+      f->end = e;
+    }
+  return 0;
+}
+
+/* aspath_regex_add() parses the pattern, and returns the index
+   of the pattern, or -1 if malformed. */
+int
+aspath_regex_add (char *pattern)
+{
+  struct aspath_frag f;
+  int index = aspath_regex_size;
+  int s0, x, t0, y, acc;
+
+  if (aspath_regex_size >= ASPATH_REGEX_MAX)
+    {
+      printf ("aspath-regex: too many patterns (max: %d).\n",
+              ASPATH_REGEX_MAX);
+      return -1;
+    }
+
+  if (natoms == 0)
+    {
+      atom_new (ATOM_ANY);
+      atom_new (ATOM_BEGIN);
+      atom_new (ATOM_END);
+    }
+
+  re_p = pattern;
+  re_lex ();
+  if (re_parse_alt (&f) < 0 || re_tok != TOK_END)
+    {
+      printf ("aspath-regex: malformed pattern: \"%s\" at \"%s\"\n",
+              pattern, re_p);
+      return -1;
+    }
+
+  /* (^|.)* P (.|$)* */
+  s0 = nfa_new (-1, -1, f.start);
+  x = nfa_new (-1, nfa_new (ATOM_ANY, s0, -1), nfa_new (ATOM_BEGIN, s0, -1));
+  nfa[s0].out1 = x;
+
+  acc = nfa_new (-1, -1, -1);
+  nfa[acc].accept = index + 1;
+  t0 = nfa_new (-1, -1, acc);
+  y = nfa_new (-1, nfa_new (ATOM_ANY, t0, -1), nfa_new (ATOM_END, t0, -1));
+  nfa[t0].out1 = y;
+  nfa[f.end].out1 = t0;
+
+  nfa_pattern_start[index] = s0;
+  aspath_regex_pattern[index] = pattern;
+  aspath_regex_count[index] = 0;
+  aspath_regex_size++;
+  return index;
+}
+
+static int
+uint32_cmp (const void *a, const void *b)
+{
+  uint32_t x = *(uint32_t *) a, y = *(uint32_t *) b;
+  return (x < y ? -1 : (x > y ? 1 : 0));
+}
+
+static uint32_t
+phash_mix (uint32_t key, uint32_t seed)
+{
+  uint32_t h = key ^ (seed * 0x9e3779b9U);
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35U;
+  h ^= h >> 16;
+  return h;
+}
+
+#define PHASH_SEED 0x5bd1e995U
+
+static int
+aspath_regex_class (uint32_t asn)
+{
+  uint32_t b, slot;
+  int lo, hi, mid;
+
+  if (phash_size)
+    {
+      b = phash_mix (asn, PHASH_SEED) % phash_nbucket;
+      slot = phash_mix (asn, phash_disp[b]) & (phash_size - 1);
+      if (phash_class[slot] >= 0 && phash_key[slot] == asn)
+        return phash_class[slot];
+    }
+
+  if (! interval_search)
+    return default_class;
+
+  /* the last interval that starts at or below the asn. */
+  lo = 0;
+  hi = ninterval - 1;
+  while (lo < hi)
+    {
+      mid = (lo + hi + 1) / 2;
+      if (interval_start[mid] <= asn)
+        lo = mid;
+      else
+        hi = mid - 1;
+    }
+  return interval_class[lo];
+}
+
+static int
+phash_build (uint32_t *keys, int *classes, int n)
+{
+  int *bucket_size, *order, *bucket_of;
+  uint32_t b, d, slot;
+  int i, j, k, tmp, ok;
+  uint32_t *slots;
+
+  phash_size = 2;
+  while (phash_size < 2 * n)
+    phash_size *= 2;
+  phash_nbucket = n / 2 + 1;
+
+  phash_key = malloc (phash_size * sizeof (uint32_t));
+  phash_class = malloc (phash_size * sizeof (int));
+  phash_disp = malloc (phash_nbucket * sizeof (uint32_t));
+  bucket_size = calloc (phash_nbucket, sizeof (int));
+  order = malloc (phash_nbucket * sizeof (int));
+  bucket_of = malloc (n * sizeof (int));
+  slots = malloc (n * sizeof (uint32_t));
+  assert (phash_key && phash_class && phash_disp && bucket_size &&
+          order && bucket_of && slots);
+
+  for (i = 0; i < phash_size; i++)
+    phash_class[i] = -1;
+
+  for (i = 0; i < n; i++)
+    {
+      bucket_of[i] = phash_mix (keys[i], PHASH_SEED) % phash_nbucket;
+      bucket_size[bucket_of[i]]++;
+    }
+
+  /* place the larger buckets first. */
+  for (b = 0; b < phash_nbucket; b++)
+    order[b] = b;
+  for (i = 0; i < phash_nbucket; i++)
+    for (j = i + 1; j < phash_nbucket; j++)
+      if (bucket_size[order[j]] > bucket_size[order[i]])
+        {
+          tmp = order[i];
+          order[i] = order[j];
+          order[j] = tmp;
+        }
+
+  for (i = 0; i < phash_nbucket; i++)
+    {
+      b = order[i];
+      phash_disp[b] = 0;
+      if (bucket_size[b] == 0)
+        continue;
+
+      for (d = 1; d < (1U << 24); d++)
+        {
+          ok = 1;
+          k = 0;
+          for (j = 0; j < n && ok; j++)
+            {
+              if (bucket_of[j] != b)
+                continue;
+              slot = phash_mix (keys[j], d) & (phash_size - 1);
+              if (phash_class[slot] >= 0)
+                ok = 0;
+              for (tmp = 0; tmp < k && ok; tmp++)
+                if (slots[tmp] == slot)
+                  ok = 0;
+              slots[k++] = slot;
+            }
+          if (ok)
+            break;
+        }
+      if (d == (1U << 24))
+        return -1;
+
+      phash_disp[b] = d;
+      for (j = 0; j < n; j++)
+        {
+          if (bucket_of[j] != b)
+            continue;
+          slot = phash_mix (keys[j], d) & (phash_size - 1);
+          phash_key[slot] = keys[j];
+          phash_class[slot] = classes[j];
+        }
+    }
+
+  free (bucket_size);
+  free (order);
+  free (bucket_of);
+  free (slots);
+  return 0;
+}
+
+static int
+aspath_regex_partition (uint8_t **matchp)
+{
+  uint32_t *bounds;
+  uint64_t *sigs, *sig;
+  uint8_t *match;
+  uint32_t *literal_keys;
+  int *literal_classes;
+  int nbounds, nsig;
+  int words = (natoms + 63) / 64;
+  int i, j, k, a, r;
+
+  /* the interval boundaries. */
+  nbounds = 1;
+  for (a = 0; a < natoms; a++)
+    nbounds += 2 * atoms[a].nranges;
+  bounds = malloc (nbounds * sizeof (uint32_t));
+  assert (bounds);
+  nbounds = 0;
+  bounds[nbounds++] = 0;
+  for (a = 0; a < natoms; a++)
+    for (r = 0; r < atoms[a].nranges; r++)
+      {
+        bounds[nbounds++] = atoms[a].lo[r];
+        if (atoms[a].hi[r] != 0xffffffffU)
+          bounds[nbounds++] = atoms[a].hi[r] + 1;
+      }
+  qsort (bounds, nbounds, sizeof (uint32_t), uint32_cmp);
+  for (i = 0, j = 0; i < nbounds; i++)
+    if (j == 0 || bounds[j - 1] != bounds[i])
+      bounds[j++] = bounds[i];
+  ninterval = j;
+
+  interval_start = bounds;
+  interval_class = malloc (ninterval * sizeof (int));
+  sigs = calloc ((size_t) ninterval * words, sizeof (uint64_t));
+  assert (interval_class && sigs);
+
+  /* the signature of the interval: the set of the atoms that match. */
+  nsig = 0;
+  nclasses = 2;
+  for (k = 0; k < ninterval; k++)
+    {
+      uint32_t v = interval_start[k];
+      sig = &sigs[(size_t) nsig * words];
+      memset (sig, 0, words * sizeof (uint64_t));
+      for (a = 0; a < natoms; a++)
+        {
+          int in = 0;
+          if (atoms[a].type != ATOM_ASN)
+            continue;
+          for (r = 0; r < atoms[a].nranges && ! in; r++)
+            if (atoms[a].lo[r] <= v && v <= atoms[a].hi[r])
+              in = 1;
+          if (atoms[a].negate)
+            in = ! in;
+          if (in)
+            sig[a / 64] |= (1ULL << (a % 64));
+        }
+
+      for (i = 0; i < nsig; i++)
+        if (! memcmp (&sigs[(size_t) i * words], sig,
+                      words * sizeof (uint64_t)))
+          break;
+      if (i == nsig)
+        nsig++;
+      interval_class[k] = 2 + i;
+    }
+  nclasses = 2 + nsig;
+
+  match = calloc ((size_t) natoms * nclasses, sizeof (uint8_t));
+  assert (match);
+  for (a = 0; a < natoms; a++)
+    {
+      switch (atoms[a].type)
+        {
+        case ATOM_ANY:
+          for (k = 2; k < nclasses; k++)
+            match[a * nclasses + k] = 1;
+          break;
+        case ATOM_BEGIN:
+          match[a * nclasses + CLASS_BEGIN] = 1;
+          break;
+        case ATOM_END:
+          match[a * nclasses + CLASS_END] = 1;
+          break;
+        default:
+          for (i = 0; i < nsig; i++)
+            if (sigs[(size_t) i * words + a / 64] & (1ULL << (a % 64)))
+              match[a * nclasses + 2 + i] = 1;
+          break;
+        }
+    }
+  free (sigs);
+
+  /* the literal ASNs (the intervals of one ASN) go to the perfect hash,
+     and the rest needs the interval search only if they differ. */
+  literal_keys = malloc (ninterval * sizeof (uint32_t));
+  literal_classes = malloc (ninterval * sizeof (int));
+  assert (literal_keys && literal_classes);
+  nliteral = 0;
+  default_class = -1;
+  interval_search = 0;
+  for (k = 0; k < ninterval; k++)
+    {
+      if (k + 1 < ninterval && interval_start[k + 1] == interval_start[k] + 1)
+        {
+          literal_keys[nliteral] = interval_start[k];
+          literal_classes[nliteral] = interval_class[k];
+          nliteral++;
+        }
+      else if (k + 1 == ninterval && interval_start[k] == 0xffffffffU)
+        {
+          literal_keys[nliteral] = interval_start[k];
+          literal_classes[nliteral] = interval_class[k];
+          nliteral++;
+        }
+      else if (default_class < 0)
+        default_class = interval_class[k];
+      else if (default_class != interval_class[k])
+        interval_search++;
+    }
+  if (default_class < 0)
+    default_class = 2;
+
+  phash_size = 0;
+  if (nliteral && phash_build (literal_keys, literal_classes, nliteral) < 0)
+    {
+      /* should not happen; the interval search is always correct. */
+      free (phash_key);
+      free (phash_class);
+      free (phash_disp);
+      phash_key = NULL;
+      phash_class = NULL;
+      phash_disp = NULL;
+      phash_size = 0;
+      interval_search++;
+    }
+  free (literal_keys);
+  free (literal_classes);
+
+  *matchp = match;
+  return 0;
+}
+
+static void
+nfa_closure (uint64_t *set, int *stack)
+{
+  int sp = 0, s, i, o;
+
+  for (i = 0; i < nnfa; i++)
+    if (set[i / 64] & (1ULL << (i % 64)))
+      stack[sp++] = i;
+
+  while (sp > 0)
+    {
+      s = stack[--sp];
+      if (nfa[s].atom >= 0)
+        continue;
+      for (i = 0; i < 2; i++)
+        {
+          o = (i == 0 ? nfa[s].out1 : nfa[s].out2);
+          if (o < 0 || (set[o / 64] & (1ULL << (o % 64))))
+            continue;
+          set[o / 64] |= (1ULL << (o % 64));
+          stack[sp++] = o;
+        }
+    }
+}
+
+static uint64_t
+set_hash (uint64_t *set, int words)
+{
+  uint64_t h = 14695981039346656037ULL;
+  int i;
+  for (i = 0; i < words; i++)
+    h = (h ^ set[i]) * 1099511628211ULL;
+  return h;
+}
+
+/* aspath_regex_compile() builds the DFA of all the patterns. */
+int
+aspath_regex_compile ()
+{
+  uint8_t *match;
+  int words, root, i, s, c, d, id;
+  uint64_t *sets = NULL, *next;
+  int sets_limit = 0;
+  int *hash, hash_size;
+  int *stack;
+  uint64_t h;
+
+  if (aspath_regex_size == 0)
+    return 0;
+
+  aspath_regex_partition (&match);
+
+  /* the root state branches to every pattern. */
+  root = -1;
+  for (i = aspath_regex_size - 1; i >= 0; i--)
+    root = nfa_new (-1, nfa_pattern_start[i], root);
+
+  words = (nnfa + 63) / 64;
+  stack = malloc (nnfa * sizeof (int));
+  next = malloc (words * sizeof (uint64_t));
+  hash_size = 1024;
+  hash = malloc (hash_size * sizeof (int));
+  assert (stack && next && hash);
+  memset (hash, -1, hash_size * sizeof (int));
+
+  ndfa = 0;
+  memset (next, 0, words * sizeof (uint64_t));
+  next[root / 64] |= (1ULL << (root % 64));
+
+  for (d = -1; d < ndfa; d++)
+    {
+      for (c = 0; c < (d < 0 ? 1 : nclasses); c++)
+        {
+          if (d >= 0)
+            {
+              uint64_t *cur = &sets[(size_t) d * words];
+              memset (next, 0, words * sizeof (uint64_t));
+              for (s = 0; s < nnfa; s++)
+                if ((cur[s / 64] & (1ULL << (s % 64))) &&
+                    nfa[s].atom >= 0 &&
+                    match[nfa[s].atom * nclasses + c])
+                  next[nfa[s].out1 / 64] |= (1ULL << (nfa[s].out1 % 64));
+            }
+          nfa_closure (next, stack);
+
+          /* look up the state set. */
+          h = set_hash (next, words);
+          i = h & (hash_size - 1);
+          while ((id = hash[i]) >= 0 &&
+                 memcmp (&sets[(size_t) id * words], next,
+                         words * sizeof (uint64_t)))
+            i = (i + 1) & (hash_size - 1);
+
+          if (id < 0)
+            {
+              if (ndfa >= ASPATH_DFA_STATE_MAX)
+                {
+                  printf ("aspath-regex: too many DFA states (max: %d).\n",
+                          ASPATH_DFA_STATE_MAX);
+                  free (sets);
+                  free (hash);
+                  free (stack);
+                  free (next);
+                  free (match);
+                  return -1;
+                }
+              if (ndfa == sets_limit)
+                {
+                  sets_limit = (sets_limit ? sets_limit * 2 : 64);
+                  sets = realloc (sets, (size_t) sets_limit * words *
+                                  sizeof (uint64_t));
+                  dfa_delta = realloc (dfa_delta, (size_t) sets_limit *
+                                       nclasses * sizeof (uint32_t));
+                  dfa_accept = realloc (dfa_accept, (size_t) sets_limit *
+                                        sizeof (uint64_t));
+                  assert (sets && dfa_delta && dfa_accept);
+                }
+              id = ndfa++;
+              memcpy (&sets[(size_t) id * words], next,
+                      words * sizeof (uint64_t));
+              dfa_accept[id] = 0;
+              for (s = 0; s < nnfa; s++)
+                if ((next[s / 64] & (1ULL << (s % 64))) && nfa[s].accept)
+                  dfa_accept[id] |= (1ULL << (nfa[s].accept - 1));
+              hash[i] = id;
+
+              if (ndfa * 2 > hash_size)
+                {
+                  int k;
+                  free (hash);
+                  hash_size *= 2;
+                  hash = malloc (hash_size * sizeof (int));
+                  assert (hash);
+                  memset (hash, -1, hash_size * sizeof (int));
+                  for (k = 0; k < ndfa; k++)
+                    {
+                      i = set_hash (&sets[(size_t) k * words], words) &
+                          (hash_size - 1);
+                      while (hash[i] >= 0)
+                        i = (i + 1) & (hash_size - 1);
+                      hash[i] = k;
+                    }
+                }
+            }
+
+          if (d < 0)
+            dfa_start = id;
+          else
+            dfa_delta[(size_t) d * nclasses + c] = id;
+        }
+    }
+
+  free (sets);
+  free (hash);
+  free (stack);
+  free (next);
+  free (match);
+  return 0;
+}
+
+void
+aspath_regex_finish ()
+{
+  int a;
+  for (a = 0; a < natoms; a++)
+    {
+      free (atoms[a].lo);
+      free (atoms[a].hi);
+    }
+  free (atoms);
+  free (nfa);
+  free (interval_start);
+  free (interval_class);
+  free (phash_key);
+  free (phash_class);
+  free (phash_disp);
+  free (dfa_delta);
+  free (dfa_accept);
+  atoms = NULL;
+  nfa = NULL;
+  interval_start = NULL;
+  interval_class = NULL;
+  phash_key = NULL;
+  phash_class = NULL;
+  phash_disp = NULL;
+  dfa_delta = NULL;
+  dfa_accept = NULL;
+  natoms = nnfa = nfa_limit = ndfa = 0;
+  aspath_regex_size = 0;
+}
+
+/* aspath_regex_match() returns the bitmask of the matched patterns. */
+uint64_t
+aspath_regex_match (uint32_t *path, int path_size,
+                    uint32_t *set, int set_size)
+{
+  uint32_t state;
+  uint64_t mask;
+  int i;
+
+  if (! ndfa)
+    return 0;
+
+  state = dfa_delta[(size_t) dfa_start * nclasses + CLASS_BEGIN];
+  for (i = 0; i < path_size; i++)
+    state = dfa_delta[(size_t) state * nclasses +
+                      aspath_regex_class (path[i])];
+
+  if (set_size == 0)
+    mask = dfa_accept[dfa_delta[(size_t) state * nclasses + CLASS_END]];
+  else
+    {
+      /* the AS_SET is one position that any of its member can take. */
+      mask = 0;
+      for (i = 0; i < set_size; i++)
+        {
+          uint32_t s;
+          s = dfa_delta[(size_t) state * nclasses +
+                        aspath_regex_class (set[i])];
+          mask |= dfa_accept[dfa_delta[(size_t) s * nclasses + CLASS_END]];
+        }
+    }
+
+  for (i = 0; i < aspath_regex_size; i++)
+    if (mask & (1ULL << i))
+      aspath_regex_count[i]++;
+
+  return mask;
+}
+
+uint64_t
+aspath_regex_match_route (struct bgp_route *route)
+{
+  return aspath_regex_match (route->path_list,
+                             MIN (route->path_size, ROUTE_PATH_LIMIT),
+                             route->set_list,
+                             MIN (route->set_size, ROUTE_SET_LIMIT));
+}
+
+void
+aspath_regex_print ()
+{
+  int i;
+
+  printf ("aspath-regex: %d patterns, %d classes, %d literal asns, "
+          "%d nfa states, %d dfa states%s.\n",
+          aspath_regex_size, nclasses, nliteral,
+          nnfa, ndfa, (interval_search ? ", interval search" : ""));
+  for (i = 0; i < aspath_regex_size; i++)
+    printf ("aspath-regex[%d]: \"%s\": %'llu paths matched.\n",
+            i, aspath_regex_pattern[i],
+            (unsigned long long) aspath_regex_count[i]);
+}
@@ -0,0 +1,47 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BGPDUMP_ASPATH_REGEX_H_
+#define _BGPDUMP_ASPATH_REGEX_H_
+
+/* AS-path regular expressions over the ASN tokens (not the text).
+   All the patterns are compiled together into one DFA whose states
+   carry the bitmask of the matched patterns, so that a path is
+   matched against every pattern in one pass.
+
+   syntax: <asn>, ".", "[<asn> <asn>-<asn> ...]", "[^...]", "(...)",
+   "|", "*", "+", "?", "^", "$", and "_" (the token boundary, ignored).
+   An AS_SET is one position that matches if any of its members does. */
+
+#define ASPATH_REGEX_MAX 64
+
+extern char *aspath_regex_pattern[];
+extern int aspath_regex_size;
+extern uint64_t aspath_regex_count[];
+
+int aspath_regex_add (char *pattern);
+int aspath_regex_compile ();
+void aspath_regex_finish ();
+
+uint64_t aspath_regex_match (uint32_t *path, int path_size,
+                             uint32_t *set, int set_size);
+uint64_t aspath_regex_match_route (struct bgp_route *route);
+
+void aspath_regex_print ();
+
+#endif /*_BGPDUMP_ASPATH_REGEX_H_*/
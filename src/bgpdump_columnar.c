@@ -0,0 +1,261 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "bgpdump.h"
+#include "bgpdump_data.h"
+#include "bgpdump_route.h"
+#include "bgpdump_community.h"
+#include "bgpdump_columnar.h"
+
+struct columnar_column columnar_schema[COLUMNAR_COL_MAX] =
+{
+  { "af",           1, 0 },
+  { "prefix",      16, 0 },
+  { "plen",         1, 0 },
+  { "peer",         2, 0 },
+  { "nexthop",     16, 0 },
+  { "origin_as",    4, 0 },
+  { "origin",       1, 0 },
+  { "atomic",       1, 0 },
+  { "localpref",    4, 0 },
+  { "med",          4, 0 },
+  { "path_offset",  4, 0 },
+  { "path",         4, 0 },
+  { "set_offset",   4, 0 },
+  { "set",          4, 0 },
+  { "comm_offset",  4, 0 },
+  { "comm",         4, 0 },
+  { "lcomm_offset", 4, 0 },
+  { "lcomm",       12, 0 },
+};
+
+struct columnar_buffer
+{
+  char *buf;
+  size_t len;
+  size_t size;
+};
+
+static struct columnar_buffer columnar_buf[COLUMNAR_COL_MAX];
+static uint64_t columnar_rows = 0;
+
+static FILE *columnar_fp = NULL;
+static char *columnar_path = NULL;
+static uint64_t columnar_offset = 0;
+static struct columnar_chunk *columnar_chunks = NULL;
+static uint32_t columnar_nchunks = 0;
+static uint32_t columnar_chunk_limit = 0;
+
+static void
+columnar_append (int col, const void *data, size_t len)
+{
+  struct columnar_buffer *b = &columnar_buf[col];
+
+  if (b->len + len > b->size)
+    {
+      b->size = (b->size ? b->size : 4096);
+      while (b->len + len > b->size)
+        b->size *= 2;
+      b->buf = realloc (b->buf, b->size);
+      assert (b->buf);
+    }
+  memcpy (b->buf + b->len, data, len);
+  b->len += len;
+}
+
+/* the list offsets start with 0 in each chunk. */
+static void
+columnar_offset_init ()
+{
+  uint32_t zero = 0;
+  columnar_append (COLUMNAR_COL_PATH_OFFSET, &zero, sizeof (zero));
+  columnar_append (COLUMNAR_COL_SET_OFFSET, &zero, sizeof (zero));
+  columnar_append (COLUMNAR_COL_COMM_OFFSET, &zero, sizeof (zero));
+  columnar_append (COLUMNAR_COL_LCOMM_OFFSET, &zero, sizeof (zero));
+}
+
+static void
+columnar_write (const void *data, size_t len)
+{
+  if (len && fwrite (data, 1, len, columnar_fp) != len)
+    {
+      fprintf (stderr, "columnar: write failed: %s: %s\n",
+               columnar_path, strerror (errno));
+      exit (-1);
+    }
+  columnar_offset += len;
+}
+
+static void
+columnar_align ()
+{
+  static const char pad[8] = { 0 };
+  columnar_write (pad, (8 - columnar_offset % 8) % 8);
+}
+
+int
+columnar_open (char *path)
+{
+  struct columnar_header header;
+
+  columnar_fp = fopen (path, "w");
+  if (! columnar_fp)
+    {
+      fprintf (stderr, "columnar: can't open %s: %s\n",
+               path, strerror (errno));
+      return -1;
+    }
+  columnar_path = path;
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, COLUMNAR_MAGIC, sizeof (header.magic));
+  header.version = COLUMNAR_VERSION;
+  header.byte_order = COLUMNAR_BYTE_ORDER;
+  columnar_write (&header, sizeof (header));
+
+  columnar_offset_init ();
+  return 0;
+}
+
+void
+columnar_route (int peer_index, struct bgp_route *route)
+{
+  uint8_t u8;
+  uint16_t u16;
+  uint32_t u32;
+  int i;
+
+  u8 = route->af;
+  columnar_append (COLUMNAR_COL_AF, &u8, 1);
+  columnar_append (COLUMNAR_COL_PREFIX, route->prefix, 16);
+  columnar_append (COLUMNAR_COL_PLEN, &route->prefix_length, 1);
+  u16 = peer_index;
+  columnar_append (COLUMNAR_COL_PEER, &u16, 2);
+  columnar_append (COLUMNAR_COL_NEXTHOP, route->nexthop, 16);
+  columnar_append (COLUMNAR_COL_ORIGIN_AS, &route->origin_as, 4);
+  columnar_append (COLUMNAR_COL_ORIGIN, &route->origin, 1);
+  columnar_append (COLUMNAR_COL_ATOMIC, &route->atomic_aggregate, 1);
+  columnar_append (COLUMNAR_COL_LOCALPREF, &route->localpref, 4);
+  columnar_append (COLUMNAR_COL_MED, &route->med, 4);
+
+  columnar_append (COLUMNAR_COL_PATH, route->path_list,
+                   MIN (route->path_size, ROUTE_PATH_LIMIT) * 4);
+  u32 = columnar_buf[COLUMNAR_COL_PATH].len / 4;
+  columnar_append (COLUMNAR_COL_PATH_OFFSET, &u32, 4);
+
+  columnar_append (COLUMNAR_COL_SET, route->set_list,
+                   MIN (route->set_size, ROUTE_SET_LIMIT) * 4);
+  u32 = columnar_buf[COLUMNAR_COL_SET].len / 4;
+  columnar_append (COLUMNAR_COL_SET_OFFSET, &u32, 4);
+
+  if (route->community != COMMUNITY_NONE)
+    {
+      struct community_entry *e = COMMUNITY_ENTRY (route->community);
+      columnar_append (COLUMNAR_COL_COMM, COMMUNITY_STD (e),
+                       e->std_size * 4);
+      for (i = 0; i < e->large_size; i++)
+        columnar_append (COLUMNAR_COL_LCOMM, COMMUNITY_LARGE (e) + i * 3,
+                         12);
+    }
+  u32 = columnar_buf[COLUMNAR_COL_COMM].len / 4;
+  columnar_append (COLUMNAR_COL_COMM_OFFSET, &u32, 4);
+  u32 = columnar_buf[COLUMNAR_COL_LCOMM].len / 12;
+  columnar_append (COLUMNAR_COL_LCOMM_OFFSET, &u32, 4);
+
+  columnar_rows++;
+  if (columnar_rows >= COLUMNAR_CHUNK_ROWS)
+    columnar_flush ();
+}
+
+/* write the rows so far as a chunk. */
+void
+columnar_flush ()
+{
+  struct columnar_chunk *chunk;
+  int i;
+
+  if (! columnar_fp || ! columnar_rows)
+    return;
+
+  if (columnar_nchunks >= columnar_chunk_limit)
+    {
+      columnar_chunk_limit = (columnar_chunk_limit ?
+                              columnar_chunk_limit * 2 : 64);
+      columnar_chunks = realloc (columnar_chunks, columnar_chunk_limit *
+                                 sizeof (struct columnar_chunk));
+      assert (columnar_chunks);
+    }
+
+  chunk = &columnar_chunks[columnar_nchunks++];
+  memset (chunk, 0, sizeof (struct columnar_chunk));
+  chunk->rows = columnar_rows;
+  chunk->timestamp = timestamp;
+
+  for (i = 0; i < COLUMNAR_COL_MAX; i++)
+    {
+      columnar_align ();
+      chunk->col[i].offset = columnar_offset;
+      chunk->col[i].length = columnar_buf[i].len;
+      columnar_write (columnar_buf[i].buf, columnar_buf[i].len);
+      columnar_buf[i].len = 0;
+    }
+
+  columnar_rows = 0;
+  columnar_offset_init ();
+}
+
+void
+columnar_close ()
+{
+  struct columnar_trailer trailer;
+  int i;
+
+  if (! columnar_fp)
+    return;
+
+  columnar_flush ();
+
+  columnar_align ();
+  memset (&trailer, 0, sizeof (trailer));
+  trailer.footer_offset = columnar_offset;
+  trailer.nchunks = columnar_nchunks;
+  trailer.ncolumns = COLUMNAR_COL_MAX;
+  memcpy (trailer.magic, COLUMNAR_MAGIC, sizeof (trailer.magic));
+
+  columnar_write (columnar_schema, sizeof (columnar_schema));
+  columnar_write (columnar_chunks,
+                  columnar_nchunks * sizeof (struct columnar_chunk));
+  columnar_write (&trailer, sizeof (trailer));
+
+  fclose (columnar_fp);
+  columnar_fp = NULL;
+
+  for (i = 0; i < COLUMNAR_COL_MAX; i++)
+    free (columnar_buf[i].buf);
+  memset (columnar_buf, 0, sizeof (columnar_buf));
+  free (columnar_chunks);
+  columnar_chunks = NULL;
+  columnar_nchunks = columnar_chunk_limit = 0;
+}
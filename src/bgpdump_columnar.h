@@ -0,0 +1,105 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BGPDUMP_COLUMNAR_H_
+#define _BGPDUMP_COLUMNAR_H_
+
+/* The columnar export (-E) writes the routes in chunks of up to
+   COLUMNAR_CHUNK_ROWS rows. A chunk is a set of column arrays, each
+   aligned to 8 bytes, so that a column can be used in place from
+   mmap(). The lists (AS path, AS set, communities) are a column of
+   n + 1 uint32 offsets into a shared value column, as in Arrow.
+   All the numbers are in the host byte order (see the header).
+
+   file:    struct columnar_header
+            chunk 0 columns, chunk 1 columns, ...
+            footer: struct columnar_column[COLUMNAR_COL_MAX] (schema)
+                    struct columnar_chunk[nchunks]
+            struct columnar_trailer (at the end of the file)
+
+   A reader maps the file, reads the trailer at the end, and finds
+   the chunks and the columns from the footer. */
+
+#define COLUMNAR_MAGIC "BGPDCOL1"
+#define COLUMNAR_VERSION 1
+#define COLUMNAR_BYTE_ORDER 0x01020304
+#define COLUMNAR_CHUNK_ROWS (64 * 1024)
+
+enum columnar_col
+{
+  COLUMNAR_COL_AF,            /* uint8 */
+  COLUMNAR_COL_PREFIX,        /* 16 bytes (IPv4 in the first 4) */
+  COLUMNAR_COL_PLEN,          /* uint8 */
+  COLUMNAR_COL_PEER,          /* uint16, the peer_index */
+  COLUMNAR_COL_NEXTHOP,       /* 16 bytes */
+  COLUMNAR_COL_ORIGIN_AS,     /* uint32 */
+  COLUMNAR_COL_ORIGIN,        /* uint8 */
+  COLUMNAR_COL_ATOMIC,        /* uint8 */
+  COLUMNAR_COL_LOCALPREF,     /* uint32 */
+  COLUMNAR_COL_MED,           /* uint32 */
+  COLUMNAR_COL_PATH_OFFSET,   /* uint32 x (rows + 1) */
+  COLUMNAR_COL_PATH,          /* uint32 ASNs */
+  COLUMNAR_COL_SET_OFFSET,    /* uint32 x (rows + 1) */
+  COLUMNAR_COL_SET,           /* uint32 ASNs */
+  COLUMNAR_COL_COMM_OFFSET,   /* uint32 x (rows + 1) */
+  COLUMNAR_COL_COMM,          /* uint32 standard communities */
+  COLUMNAR_COL_LCOMM_OFFSET,  /* uint32 x (rows + 1), in 3-word units */
+  COLUMNAR_COL_LCOMM,         /* uint32 x 3 large communities */
+  COLUMNAR_COL_MAX
+};
+
+struct columnar_header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;        /* COLUMNAR_BYTE_ORDER as written. */
+};
+
+struct columnar_column
+{
+  char name[16];
+  uint32_t width;             /* bytes of an element. */
+  uint32_t reserved;
+};
+
+struct columnar_chunk
+{
+  uint64_t rows;
+  uint32_t timestamp;         /* of the MRT file. */
+  uint32_t reserved;
+  struct
+  {
+    uint64_t offset;
+    uint64_t length;
+  } col[COLUMNAR_COL_MAX];
+};
+
+struct columnar_trailer
+{
+  uint64_t footer_offset;
+  uint32_t nchunks;
+  uint32_t ncolumns;
+  char magic[8];
+};
+
+int columnar_open (char *path);
+void columnar_route (int peer_index, struct bgp_route *route);
+void columnar_flush ();
+void columnar_close ();
+
+#endif /*_BGPDUMP_COLUMNAR_H_*/
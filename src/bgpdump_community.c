@@ -0,0 +1,400 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <assert.h>
+
+#include "bgpdump_obuf.h"
+#include "bgpdump_community.h"
+
+#define COMMUNITY_TABLE_INIT 1024
+#define COMMUNITY_DATA_INIT (16 * 1024)
+
+struct community_entry *community_table = NULL;
+uint32_t community_size = 0;
+uint32_t community_limit = 0;
+
+uint32_t *community_data = NULL;
+uint32_t community_data_size = 0;
+uint32_t community_data_limit = 0;
+
+/* open-addressing hash of the ids. 0 (COMMUNITY_NONE) is empty. */
+uint32_t *community_hash = NULL;
+uint32_t community_hash_size = 0;
+
+/* scratch buffer to convert the attribute into the host byte-order. */
+uint32_t *community_words = NULL;
+uint32_t community_words_limit = 0;
+
+void
+community_init ()
+{
+  community_limit = COMMUNITY_TABLE_INIT;
+  community_table = malloc (community_limit * sizeof (struct community_entry));
+  assert (community_table);
+  memset (community_table, 0, sizeof (struct community_entry));
+  community_size = 1; /* id 0 is reserved for COMMUNITY_NONE */
+
+  community_data_limit = COMMUNITY_DATA_INIT;
+  community_data = malloc (community_data_limit * sizeof (uint32_t));
+  assert (community_data);
+  community_data_size = 0;
+
+  community_hash_size = 2 * COMMUNITY_TABLE_INIT;
+  community_hash = malloc (community_hash_size * sizeof (uint32_t));
+  assert (community_hash);
+  memset (community_hash, 0, community_hash_size * sizeof (uint32_t));
+}
+
+void
+community_finish ()
+{
+  free (community_table);
+  free (community_data);
+  free (community_hash);
+  free (community_words);
+  community_table = NULL;
+  community_data = NULL;
+  community_hash = NULL;
+  community_words = NULL;
+  community_size = community_limit = 0;
+  community_data_size = community_data_limit = 0;
+  community_hash_size = 0;
+  community_words_limit = 0;
+}
+
+static uint32_t
+community_hash_words (uint32_t *words, int nwords,
+                      int std_size, int ext_size, int large_size)
+{
+  /* FNV-1a */
+  uint32_t hash = 2166136261U;
+  int i;
+
+  hash = (hash ^ std_size) * 16777619U;
+  hash = (hash ^ ext_size) * 16777619U;
+  hash = (hash ^ large_size) * 16777619U;
+  for (i = 0; i < nwords; i++)
+    hash = (hash ^ words[i]) * 16777619U;
+  return hash;
+}
+
+static void
+community_hash_resize ()
+{
+  uint32_t i, id, mask;
+  uint32_t *old = community_hash;
+  uint32_t old_size = community_hash_size;
+
+  community_hash_size *= 2;
+  community_hash = malloc (community_hash_size * sizeof (uint32_t));
+  assert (community_hash);
+  memset (community_hash, 0, community_hash_size * sizeof (uint32_t));
+
+  mask = community_hash_size - 1;
+  for (i = 0; i < old_size; i++)
+    {
+      uint32_t slot;
+      id = old[i];
+      if (id == COMMUNITY_NONE)
+        continue;
+      slot = community_table[id].hash & mask;
+      while (community_hash[slot] != COMMUNITY_NONE)
+        slot = (slot + 1) & mask;
+      community_hash[slot] = id;
+    }
+  free (old);
+}
+
+static void
+community_words_convert (uint32_t *words, char *p, int len)
+{
+  int i;
+  for (i = 0; i < len / 4; i++)
+    words[i] = ntohl (*(uint32_t *)(p + i * 4));
+}
+
+/* community_intern() returns the id of the set of communities in
+   the attribute values (std: COMMUNITY, ext: EXTENDED_COMMUNITY,
+   large: LARGE_COMMUNITY), in the network byte-order.
+   Any of them may be NULL. */
+uint32_t
+community_intern (char *std, int std_len, char *ext, int ext_len,
+                  char *large, int large_len)
+{
+  int std_size, ext_size, large_size, nwords;
+  uint32_t hash, mask, slot, id;
+  uint32_t *words;
+  struct community_entry *e;
+
+  std_size = (std ? std_len / 4 : 0);
+  ext_size = (ext ? ext_len / 8 : 0);
+  large_size = (large ? large_len / 12 : 0);
+  nwords = std_size + 2 * ext_size + 3 * large_size;
+  if (nwords == 0)
+    return COMMUNITY_NONE;
+
+  if (! community_table)
+    community_init ();
+
+  if (community_words_limit < nwords)
+    {
+      community_words_limit = nwords;
+      community_words = realloc (community_words,
+                                 community_words_limit * sizeof (uint32_t));
+      assert (community_words);
+    }
+  words = community_words;
+  community_words_convert (&words[0], std, std_size * 4);
+  community_words_convert (&words[std_size], ext, ext_size * 8);
+  community_words_convert (&words[std_size + 2 * ext_size], large,
+                           large_size * 12);
+
+  hash = community_hash_words (words, nwords, std_size, ext_size, large_size);
+
+  mask = community_hash_size - 1;
+  slot = hash & mask;
+  while ((id = community_hash[slot]) != COMMUNITY_NONE)
+    {
+      e = &community_table[id];
+      if (e->hash == hash && e->std_size == std_size &&
+          e->ext_size == ext_size && e->large_size == large_size &&
+          ! memcmp (&community_data[e->offset], words,
+                    nwords * sizeof (uint32_t)))
+        return id;
+      slot = (slot + 1) & mask;
+    }
+
+  /* not found. add the new entry. */
+  if (community_size == community_limit)
+    {
+      community_limit *= 2;
+      community_table = realloc (community_table, community_limit *
+                                 sizeof (struct community_entry));
+      assert (community_table);
+    }
+  while (community_data_size + nwords > community_data_limit)
+    {
+      community_data_limit *= 2;
+      community_data = realloc (community_data,
+                                community_data_limit * sizeof (uint32_t));
+      assert (community_data);
+    }
+
+  id = community_size++;
+  e = &community_table[id];
+  e->hash = hash;
+  e->offset = community_data_size;
+  e->std_size = std_size;
+  e->ext_size = ext_size;
+  e->large_size = large_size;
+  memcpy (&community_data[e->offset], words, nwords * sizeof (uint32_t));
+  community_data_size += nwords;
+
+  community_hash[slot] = id;
+  if (community_size * 2 > community_hash_size)
+    community_hash_resize ();
+
+  return id;
+}
+
+int
+community_has_std (uint32_t id, uint32_t value)
+{
+  struct community_entry *e;
+  uint32_t *p;
+  int i;
+
+  if (id == COMMUNITY_NONE)
+    return 0;
+  e = COMMUNITY_ENTRY (id);
+  p = COMMUNITY_STD (e);
+  for (i = 0; i < e->std_size; i++)
+    if (p[i] == value)
+      return 1;
+  return 0;
+}
+
+int
+community_has_large (uint32_t id, uint32_t global, uint32_t local1,
+                     uint32_t local2)
+{
+  struct community_entry *e;
+  uint32_t *p;
+  int i;
+
+  if (id == COMMUNITY_NONE)
+    return 0;
+  e = COMMUNITY_ENTRY (id);
+  p = COMMUNITY_LARGE (e);
+  for (i = 0; i < e->large_size; i++, p += 3)
+    if (p[0] == global && p[1] == local1 && p[2] == local2)
+      return 1;
+  return 0;
+}
+
+/* The community_*_print() print the communities separated by a space. */
+
+void
+community_std_format (struct obuf *ob, uint32_t id)
+{
+  struct community_entry *e;
+  uint32_t *p;
+  int i;
+
+  if (id == COMMUNITY_NONE)
+    return;
+
+  e = COMMUNITY_ENTRY (id);
+  p = COMMUNITY_STD (e);
+  for (i = 0; i < e->std_size; i++)
+    {
+      if (i > 0)
+        OBUF_CHAR (ob, ' ');
+      obuf_u32 (ob, p[i] >> 16);
+      OBUF_CHAR (ob, ':');
+      obuf_u32 (ob, p[i] & 0xffff);
+    }
+}
+
+void
+community_ext_format (struct obuf *ob, uint32_t id)
+{
+  struct community_entry *e;
+  uint32_t *p;
+  int i;
+  uint8_t type, subtype;
+  char *name;
+  struct in_addr in;
+
+  if (id == COMMUNITY_NONE)
+    return;
+
+  e = COMMUNITY_ENTRY (id);
+  p = COMMUNITY_EXT (e);
+  for (i = 0; i < e->ext_size; i++, p += 2)
+    {
+      type = p[0] >> 24;
+      subtype = (p[0] >> 16) & 0xff;
+      switch (subtype)
+        {
+        case 0x02:
+          name = "rt";
+          break;
+        case 0x03:
+          name = "soo";
+          break;
+        default:
+          name = NULL;
+          break;
+        }
+
+      if (i > 0)
+        OBUF_CHAR (ob, ' ');
+
+      /* two-octet AS, IPv4 address, and four-octet AS specific
+         (RFC 4360, RFC 5668), transitive or non-transitive. */
+      if (name && (type & 0xbf) == 0x00)
+        {
+          obuf_str (ob, name);
+          OBUF_CHAR (ob, ':');
+          obuf_u32 (ob, p[0] & 0xffff);
+          OBUF_CHAR (ob, ':');
+          obuf_u32 (ob, p[1]);
+        }
+      else if (name && (type & 0xbf) == 0x01)
+        {
+          in.s_addr = htonl (((p[0] & 0xffff) << 16) | (p[1] >> 16));
+          obuf_str (ob, name);
+          OBUF_CHAR (ob, ':');
+          obuf_ipv4 (ob, &in);
+          OBUF_CHAR (ob, ':');
+          obuf_u32 (ob, p[1] & 0xffff);
+        }
+      else if (name && (type & 0xbf) == 0x02)
+        {
+          obuf_str (ob, name);
+          OBUF_CHAR (ob, ':');
+          obuf_u32 (ob, ((p[0] & 0xffff) << 16) | (p[1] >> 16));
+          OBUF_CHAR (ob, ':');
+          obuf_u32 (ob, p[1] & 0xffff);
+        }
+      else
+        {
+          obuf_str (ob, "0x");
+          obuf_hex32 (ob, p[0]);
+          obuf_hex32 (ob, p[1]);
+        }
+    }
+}
+
+void
+community_large_format (struct obuf *ob, uint32_t id)
+{
+  struct community_entry *e;
+  uint32_t *p;
+  int i;
+
+  if (id == COMMUNITY_NONE)
+    return;
+
+  e = COMMUNITY_ENTRY (id);
+  p = COMMUNITY_LARGE (e);
+  for (i = 0; i < e->large_size; i++, p += 3)
+    {
+      if (i > 0)
+        OBUF_CHAR (ob, ' ');
+      obuf_u32 (ob, p[0]);
+      OBUF_CHAR (ob, ':');
+      obuf_u32 (ob, p[1]);
+      OBUF_CHAR (ob, ':');
+      obuf_u32 (ob, p[2]);
+    }
+}
+
+void
+community_std_print (FILE *fp, uint32_t id)
+{
+  struct obuf *ob = obuf_get ();
+  community_std_format (ob, id);
+  obuf_write (ob, fp);
+}
+
+void
+community_ext_print (FILE *fp, uint32_t id)
+{
+  struct obuf *ob = obuf_get ();
+  community_ext_format (ob, id);
+  obuf_write (ob, fp);
+}
+
+void
+community_large_print (FILE *fp, uint32_t id)
+{
+  struct obuf *ob = obuf_get ();
+  community_large_format (ob, id);
+  obuf_write (ob, fp);
+}
@@ -0,0 +1,68 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BGPDUMP_COMMUNITY_H_
+#define _BGPDUMP_COMMUNITY_H_
+
+/* The communities of a route (RFC 1997 standard, RFC 4360 extended,
+   and RFC 8092 large communities) are interned in one pool, and the
+   route refers to them by the id (route->community). Routes with the
+   same set of communities share the same pool entry. */
+
+#define COMMUNITY_NONE 0
+
+struct community_entry
+{
+  uint32_t hash;
+  uint32_t offset;      /* in words in community_data[]. */
+  uint16_t std_size;    /* one word for each. */
+  uint16_t ext_size;    /* two words for each. */
+  uint16_t large_size;  /* three words for each. */
+};
+
+extern struct community_entry *community_table;
+extern uint32_t *community_data;
+extern uint32_t community_size;
+
+#define COMMUNITY_ENTRY(id) (&community_table[(id)])
+#define COMMUNITY_STD(e) (&community_data[(e)->offset])
+#define COMMUNITY_EXT(e) (&community_data[(e)->offset + (e)->std_size])
+#define COMMUNITY_LARGE(e) \
+  (&community_data[(e)->offset + (e)->std_size + 2 * (e)->ext_size])
+
+void community_init ();
+void community_finish ();
+
+uint32_t
+community_intern (char *std, int std_len, char *ext, int ext_len,
+                  char *large, int large_len);
+
+int community_has_std (uint32_t id, uint32_t value);
+int community_has_large (uint32_t id, uint32_t global, uint32_t local1,
+                         uint32_t local2);
+
+struct obuf;
+void community_std_format (struct obuf *ob, uint32_t id);
+void community_ext_format (struct obuf *ob, uint32_t id);
+void community_large_format (struct obuf *ob, uint32_t id);
+
+void community_std_print (FILE *fp, uint32_t id);
+void community_ext_print (FILE *fp, uint32_t id);
+void community_large_print (FILE *fp, uint32_t id);
+
+#endif /*_BGPDUMP_COMMUNITY_H_*/
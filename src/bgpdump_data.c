@@ -35,13 +35,15 @@
 #include "bgpdump_peer.h"
 #include "bgpdump_route.h"
 #include "bgpdump_peerstat.h"
-#include "bgpdump_udiff.h"
+#include "bgpdump_community.h"
+#include "bgpdump_filter.h"
+#include "bgpdump_sink.h"
+#include "bgpdump_sample.h"
+#include "bgpdump_mrt.h"
 
 #include "queue.h"
 #include "ptree.h"
 
-extern struct bgp_route *diff_table[];
-extern struct ptree *diff_ptree[];
 
 void
 bgpdump_debug_break ()
@@ -198,7 +200,7 @@ bgpdump_table_v2_peer_entry (int index, char *p, char *data_end, int *retsize)
               (int) (asn4byte ? peer_as_4byte : peer_as_2byte), buf2);
     }
 
-  if (index < PEER_MAX)
+  if (index < peer_limit)
     {
       struct peer new;
       memset (&new, 0, sizeof (new));
@@ -206,6 +208,7 @@ bgpdump_table_v2_peer_entry (int index, char *p, char *data_end, int *retsize)
       new.ipv6_addr = ipv6_addr;
       new.ipv4_addr = ipv4_addr;
       new.asnumber = (asn4byte ? peer_as_4byte : peer_as_2byte);
+      new.type = peer_type;
 
       if (verbose || peer_table_only ||
           (memcmp (&peer_table[index], &peer_null, sizeof (struct peer)) &&
@@ -218,26 +221,23 @@ bgpdump_table_v2_peer_entry (int index, char *p, char *data_end, int *retsize)
          }
 
       peer_table[index] = new;
+      memset (&peer_count[index], 0, sizeof (struct peer_count));
       peer_size = index + 1;
     }
   else
     printf ("peer_table overflow.\n");
 
-  if (autsiz)
+  if (autsiz && index < peer_limit)
     {
       int i;
       for (i = 0; i < autsiz; i++)
         {
           if (peer_table[index].asnumber == autnums[i] &&
-              peer_spec_size < PEER_INDEX_MAX)
+              ! PEER_SPEC_MATCH (index))
             {
               printf ("peer_spec_index[%d]: register peer %d, asn %d\n",
                        peer_spec_size, index, peer_table[index].asnumber);
-              peer_spec_index[peer_spec_size] = index;
-              peer_route_table[peer_spec_size] = route_table_create ();
-              peer_route_size[peer_spec_size] = 0;
-              peer_ptree[peer_spec_size] = ptree_create ();
-              peer_spec_size++;
+              peer_spec_add (index);
             }
         }
     }
@@ -294,14 +294,19 @@ bgpdump_process_table_v2_peer_index_table (struct mrt_header *h,
       printf ("Peer Count: %d\n", (int) peer_count);
     }
 
+  peer_table_resize (peer_count);
   for (i = 0; i < peer_count; i++)
     {
       bgpdump_table_v2_peer_entry (i, p, data_end, &size);
       p += size;
     }
 
-  if (peer_table_only)
-    exit (0);
+  if (mrt_file)
+    mrt_peer_index_table (h, data_end);
+
+  /* nothing to do with the ribs after the peer table. */
+  if (! sink_rib && ! index_build)
+    file_done++;
 }
 
 void
@@ -320,6 +325,9 @@ bgpdump_process_bgp_attributes (struct bgp_route *route, char *start, char *end)
   char *r;
   int i;
 
+  char *community = NULL, *ext_community = NULL, *large_community = NULL;
+  int community_len = 0, ext_community_len = 0, large_community_len = 0;
+
 #define OPTIONAL         0x8000
 #define TRANSITIVE       0x4000
 #define PARTIAL          0x2000
@@ -337,6 +345,7 @@ bgpdump_process_bgp_attributes (struct bgp_route *route, char *start, char *end)
 #define MP_REACH_NLRI    14
 #define MP_UNREACH_NLRI  15
 #define EXTENDED_COMMUNITY 16
+#define LARGE_COMMUNITY  32
 
 /* The path segment type. */
 #define AS_SET           1
@@ -390,6 +399,9 @@ bgpdump_process_bgp_attributes (struct bgp_route *route, char *start, char *end)
         case EXTENDED_COMMUNITY:
           attr_name = "extended-community";
           break;
+        case LARGE_COMMUNITY:
+          attr_name = "large-community";
+          break;
         default:
           snprintf (unknown_buf, sizeof (unknown_buf),
                     "unknown (%d)", attribute_type & TYPE_CODE);
@@ -534,9 +546,18 @@ bgpdump_process_bgp_attributes (struct bgp_route *route, char *start, char *end)
           break;
 
         case COMMUNITY:
+          community = p;
+          community_len = attribute_length;
           break;
 
         case EXTENDED_COMMUNITY:
+          ext_community = p;
+          ext_community_len = attribute_length;
+          break;
+
+        case LARGE_COMMUNITY:
+          large_community = p;
+          large_community_len = attribute_length;
           break;
 
         case MP_REACH_NLRI:
@@ -600,6 +621,31 @@ bgpdump_process_bgp_attributes (struct bgp_route *route, char *start, char *end)
       p += attribute_length;
     }
 
+  route->community = community_intern (community, community_len,
+                                       ext_community, ext_community_len,
+                                       large_community, large_community_len);
+  if (show && detail && route->community != COMMUNITY_NONE)
+    {
+      struct community_entry *e = COMMUNITY_ENTRY (route->community);
+      if (e->std_size)
+        {
+          printf ("  community: ");
+          community_std_print (stdout, route->community);
+          printf ("\n");
+        }
+      if (e->ext_size)
+        {
+          printf ("  extended-community: ");
+          community_ext_print (stdout, route->community);
+          printf ("\n");
+        }
+      if (e->large_size)
+        {
+          printf ("  large-community: ");
+          community_large_print (stdout, route->community);
+          printf ("\n");
+        }
+    }
 }
 
 void
@@ -613,7 +659,7 @@ bgpdump_process_table_v2_rib_entry (int index, char **q,
   uint32_t originated_time;
   uint16_t attribute_length;
 
-  int peer_match, i;
+  int peer_match;
 
   if (debug >= 3)
     {
@@ -669,13 +715,10 @@ bgpdump_process_table_v2_rib_entry (int index, char **q,
 
   int peer_spec_i = 0;
   peer_match = 0;
-  for (i = 0; i < MIN(peer_spec_size, PEER_INDEX_MAX); i++)
+  if (PEER_SPEC_MATCH (peer_index))
     {
-      if (peer_index == peer_spec_index[i])
-        {
-          peer_spec_i = i;
-          peer_match++;
-        }
+      peer_spec_i = PEER_SPEC_SLOT (peer_index);
+      peer_match++;
     }
 
 #if 0
@@ -683,28 +726,14 @@ bgpdump_process_table_v2_rib_entry (int index, char **q,
     printf ("peer_index: %d, peer_match: %d\n", peer_index, peer_match);
 #endif
 
-  if (! peer_spec_size || peer_match)
+  if ((! peer_spec_size || peer_match) &&
+      (! filter || filter_entry (peer_index, p, p + attribute_length)))
     {
       if (show && (debug || detail))
         printf ("rib[%d]: peer[%d] originated_time: %lu attribute_length: %d\n",
                 index, peer_index, (unsigned long) originated_time,
                 attribute_length);
 
-      if (peer_index < PEER_MAX)
-        {
-          //if (route_count || route_count_peers)
-            {
-              peer_table[peer_index].route_count++;
-              if (af == AF_INET)
-                peer_table[peer_index].route_count_ipv4++;
-              if (af == AF_INET6)
-                peer_table[peer_index].route_count_ipv6++;
-            }
-
-          if (plen_dist)
-            peer_table[peer_index].route_count_by_plen[prefix_length]++;
-        }
-
       struct bgp_route route;
 
       memset (&route, 0, sizeof (route));
@@ -712,132 +741,13 @@ bgpdump_process_table_v2_rib_entry (int index, char **q,
       memcpy (route.prefix, prefix, (prefix_length + 7) / 8);
       route.prefix_length = prefix_length;
 
-      if (brief || show || lookup || udiff || stat ||
-          compat_mode || autsiz || heatmap)
+      if (sink_decode)
         bgpdump_process_bgp_attributes (&route, p, p + attribute_length);
 
       /* Now all the BGP attributes for this rib_entry are processed. */
 
-      if (stat)
-        {
-          int i, peer_match = 0;
-
-          if (peer_spec_size == 0)
-            peer_match++;
-          else
-            {
-              for (i = 0; i < peer_spec_size; i++)
-                if (peer_index == peer_spec_index[i])
-                  peer_match++;
-            }
-
-          if (peer_match)
-            {
-              //printf ("peer_stat_save: peer: %d\n", peer_index);
-              peer_stat_save (peer_index, &route);
-            }
-        }
-
-      /* lookup only works for the specified peer */
-      if (peer_spec_size)
-        {
-          struct bgp_route *rp;
-          int *route_size = &peer_route_size[peer_spec_i];
-          if (*route_size >= nroutes)
-            {
-              printf ("route table overflow: route_size: %'d.\n",
-                      *route_size);
-              //*route_size = nroutes - 1;
-              printf ("try to increase the route_table size: "
-                      "e.g., -M 2000000\n");
-              exit (-1);
-            }
-
-          struct bgp_route *rpp;
-          rpp = peer_route_table[peer_spec_i];
-          //rp = &rpp[sequence_number];
-          rp = &rpp[(*route_size)];
-          (*route_size)++;
-
-          //route_print (&route);
-          memcpy (rp, &route, sizeof (struct bgp_route));
-
-          //if (af == AF_INET)
-            ptree_add ((char *)&rp->prefix, rp->prefix_length,
-                       (void *)rp, peer_ptree[peer_spec_i]);
-        }
-
-      if (unified)
-        {
-          struct bgp_route *rp;
-          int *route_size = &peer_route_size[0];
-          if (*route_size >= nroutes)
-            {
-              printf ("route table overflow: route_size: %'d.\n",
-                      *route_size);
-              printf ("try to increase the route_table size: "
-                      "e.g., -M 2000000\n");
-              exit (-1);
-            }
-
-          struct bgp_route *rpp;
-          rpp = peer_route_table[0];
-          rp = &rpp[(*route_size)];
-          (*route_size)++;
-
-          memcpy (rp, &route, sizeof (struct bgp_route));
-          ptree_add ((char *)&rp->prefix, rp->prefix_length,
-                     (void *)rp, peer_ptree[0]);
-        }
-
-      if (udiff)
-        {
-          for (i = 0; i < MIN (peer_spec_size, 2); i++)
-            {
-              if (peer_spec_index[i] == peer_index)
-                {
-                  diff_table[i][sequence_number] = route;
-                  if (udiff_lookup)
-                    ptree_add ((char *)&route.prefix, route.prefix_length,
-                               (void *)&diff_table[i][sequence_number],
-                               diff_ptree[i]);
-                }
-            }
-        }
-
-      FILE *fp;
-      if (extract)
-        {
-          if (! peer_table[peer_index].fp)
-            {
-              char fpname[128];
-              snprintf (fpname, sizeof (fpname),
-                        "%s-p%d.txt", filename, peer_index);
-              fp = fopen (fpname, "w");
-              if (! fp)
-                {
-                  fprintf (stderr, "can't open file: %s: %s\n",
-                           fpname, strerror (errno));
-                  fprintf (stderr, "discarding info for file: %s peer: %d\n",
-                           filename, peer_index);
-                  fp = fopen ("/dev/null", "w");
-                }
-              peer_table[peer_index].fp = fp;
-            }
-          fp = peer_table[peer_index].fp;
-        }
-      else
-        fp = stdout;
-
-      if (! unified)
-        {
-          if (brief)
-            route_print_brief (fp, peer_index, &route);
-          else if (show)
-            route_print (fp, peer_index, &route);
-          else if (compat_mode)
-            route_print_compat (fp, peer_index, &route);
-        }
+      sink_route (peer_index, (peer_match ? peer_spec_i : -1), &route,
+                  p, attribute_length);
     }
 
   BUFFER_OVERRUN_CHECK(p, attribute_length, data_end)
@@ -895,6 +805,14 @@ bgpdump_process_table_v2_rib_unicast (struct mrt_header *h,
               pbuf, prefix_length, entry_count);
     }
 
+  /* skip the entire record if its prefix is not in the sample. */
+  if (sample_rate && ! sample_record (af, prefix, prefix_length))
+    return;
+
+  /* skip the entire record if its prefix does not match. */
+  if (filter && filter_record (af, prefix, prefix_length) == FILTER_FALSE)
+    return;
+
   for (i = 0; i < entry_count && p < data_end; i++)
     {
       bgpdump_process_table_v2_rib_entry (i, &p, info, data_end, af);
@@ -903,10 +821,7 @@ bgpdump_process_table_v2_rib_unicast (struct mrt_header *h,
         break;
     }
 
-  if (udiff)
-    {
-      bgpdump_udiff_compare (sequence_number);
-    }
+  sink_record_end (sequence_number);
 }
 
 void
@@ -919,13 +834,13 @@ bgpdump_process_table_dump_v2 (struct mrt_header *h, struct mrt_info *info,
       bgpdump_process_table_v2_peer_index_table (h, info, data_end);
       break;
     case BGPDUMP_TABLE_V2_RIB_IPV4_UNICAST:
-      if (! peer_table_only && (! qafi || qafi == AF_INET))
+      if (sink_rib && (! qafi || qafi == AF_INET))
         {
           bgpdump_process_table_v2_rib_unicast (h, info, data_end, AF_INET);
         }
       break;
     case BGPDUMP_TABLE_V2_RIB_IPV6_UNICAST:
-      if (! peer_table_only && (! qafi || qafi == AF_INET6))
+      if (sink_rib && (! qafi || qafi == AF_INET6))
         {
           bgpdump_process_table_v2_rib_unicast (h, info, data_end, AF_INET6);
         }
@@ -65,6 +65,7 @@ struct mrt_info
 };
 
 extern uint32_t timestamp;
+extern uint32_t sequence_number;
 extern uint16_t mrt_type;
 extern uint16_t mrt_subtype;
 extern uint32_t mrt_length;
@@ -72,6 +73,12 @@ extern uint32_t mrt_length;
 void
 bgpdump_process_mrt_header (struct mrt_header *h, struct mrt_info *info);
 
+struct bgp_route;
+
+void
+bgpdump_process_bgp_attributes (struct bgp_route *route,
+                                char *start, char *end);
+
 void
 bgpdump_process_table_dump_v2 (struct mrt_header *h, struct mrt_info *info,
                                char *data_end);
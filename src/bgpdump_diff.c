@@ -0,0 +1,530 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <assert.h>
+
+#include "bgpdump.h"
+#include "bgpdump_option.h"
+#include "bgpdump_route.h"
+#include "bgpdump_peer.h"
+#include "bgpdump_obuf.h"
+#include "bgpdump_output.h"
+#include "bgpdump_diff.h"
+
+#define DIFF_STDIO_SIZE (1024 * 1024)
+
+/* the routes of a prefix from a file. */
+struct diff_route
+{
+  struct diff_entry entry;
+  uint32_t path[ROUTE_PATH_LIMIT];
+  uint64_t text_offset;
+  int id;                   /* the peer, in the numbering of the merge. */
+};
+
+/* the stream of a file, in the parent. */
+struct diff_stream
+{
+  char *path;
+  FILE *fp;
+  pid_t pid;
+
+  struct diff_peer *peers;
+  uint32_t npeers;
+
+  /* the next entry. */
+  struct diff_entry entry;
+  uint32_t entry_path[ROUTE_PATH_LIMIT];
+  char *text;
+  uint32_t text_size;
+
+  /* the routes of the current prefix. */
+  struct diff_route *group;
+  int group_size;
+  int group_limit;
+  char *group_text;
+  uint64_t group_text_length;
+  uint64_t group_text_size;
+};
+
+static struct diff_stream diff_stream[2];
+static int diff_peer_spec = 0;  /* the peers are specified by -p. */
+static int *diff_map = NULL;    /* the peer index of the second to id. */
+static int *diff_slot = NULL;   /* the id to the route in the group. */
+
+static uint64_t diff_removed = 0;
+static uint64_t diff_added = 0;
+static uint64_t diff_changed = 0;
+static uint64_t diff_unchanged = 0;
+
+/* in the child. */
+static FILE *diff_out = NULL;
+static int diff_header_done = 0;
+static struct diff_entry diff_prev;
+
+/* diff_start() forks the two children. It returns the index of the
+   file to read in the child, or DIFF_MERGE in the parent. */
+int
+diff_start (int argc, char **argv)
+{
+  int fd[2];
+  pid_t pid;
+  int i, j;
+
+  if (argc != 2)
+    {
+      printf ("the diff (-D) needs two rib files.\n");
+      exit (-1);
+    }
+
+  diff_peer_spec = peer_spec_size;
+
+  /* not to write out the buffer in both processes. */
+  fflush (stdout);
+
+  for (i = 0; i < 2; i++)
+    {
+      diff_stream[i].path = argv[i];
+      if (pipe (fd) < 0)
+        {
+          fprintf (stderr, "diff: can't create the pipe: %s\n",
+                   strerror (errno));
+          exit (-1);
+        }
+
+      pid = fork ();
+      if (pid < 0)
+        {
+          fprintf (stderr, "diff: can't fork: %s\n", strerror (errno));
+          exit (-1);
+        }
+
+      if (pid == 0)
+        {
+          close (fd[0]);
+          for (j = 0; j < i; j++)
+            fclose (diff_stream[j].fp);
+          output_detach ();
+
+          /* the peer indexes (-p) are of the first file. the second
+             gives all the peers, and the parent selects them. */
+          if (i == 1 && peer_spec_size)
+            peer_spec_finish ();
+
+          diff_out = fdopen (fd[1], "w");
+          assert (diff_out);
+          setvbuf (diff_out, NULL, _IOFBF, DIFF_STDIO_SIZE);
+          return i;
+        }
+
+      close (fd[1]);
+      diff_stream[i].pid = pid;
+      diff_stream[i].fp = fdopen (fd[0], "r");
+      assert (diff_stream[i].fp);
+      setvbuf (diff_stream[i].fp, NULL, _IOFBF, DIFF_STDIO_SIZE);
+    }
+
+  return DIFF_MERGE;
+}
+
+static int
+diff_cmp (struct diff_entry *a, struct diff_entry *b)
+{
+  int ret;
+
+  if (a->af != b->af)
+    return (a->af < b->af ? -1 : 1);
+  ret = memcmp (a->prefix, b->prefix, MAX_ADDR_LENGTH);
+  if (ret)
+    return ret;
+  if (a->prefix_length != b->prefix_length)
+    return (a->prefix_length < b->prefix_length ? -1 : 1);
+  return 0;
+}
+
+static void
+diff_write (const void *data, size_t len)
+{
+  if (len && fwrite (data, 1, len, diff_out) != len)
+    {
+      fprintf (stderr, "diff: can't write to the parent: %s\n",
+               strerror (errno));
+      exit (-1);
+    }
+}
+
+/* the peer table, before the first route. */
+static void
+diff_header ()
+{
+  struct diff_peer peer;
+  uint32_t npeers = peer_size;
+  int i;
+
+  diff_header_done++;
+  diff_write (&npeers, sizeof (npeers));
+  for (i = 0; i < peer_size; i++)
+    {
+      memset (&peer, 0, sizeof (peer));
+      peer.ipv4_addr = peer_table[i].ipv4_addr;
+      peer.ipv6_addr = peer_table[i].ipv6_addr;
+      peer.asnumber = peer_table[i].asnumber;
+      peer.selected = (! peer_spec_size || PEER_SPEC_MATCH (i));
+      diff_write (&peer, sizeof (peer));
+    }
+}
+
+void
+diff_route (int peer_index, struct bgp_route *route,
+            char *text, int text_length)
+{
+  struct diff_entry entry;
+  char buf[64];
+
+  if (! diff_header_done)
+    diff_header ();
+
+  memset (&entry, 0, sizeof (entry));
+  entry.af = route->af;
+  entry.prefix_length = route->prefix_length;
+  entry.origin = route->origin;
+  entry.path_count = MIN (route->path_size, ROUTE_PATH_LIMIT);
+  entry.peer_index = peer_index;
+  entry.text_length = text_length;
+  memcpy (entry.prefix, route->prefix, MAX_ADDR_LENGTH);
+  memcpy (entry.nexthop, route->nexthop, MAX_ADDR_LENGTH);
+
+  /* the merge needs the prefixes in order. */
+  if (diff_prev.af && diff_cmp (&entry, &diff_prev) < 0)
+    {
+      inet_ntop (entry.af, entry.prefix, buf, sizeof (buf));
+      fprintf (stderr, "diff: the rib is not in the order of the "
+               "prefixes at %s/%d.\n", buf, entry.prefix_length);
+      exit (-1);
+    }
+  diff_prev = entry;
+
+  diff_write (&entry, sizeof (entry));
+  diff_write (route->path_list, entry.path_count * sizeof (uint32_t));
+  diff_write (text, text_length);
+}
+
+/* diff_file_error() is called in the child when its file is not
+   read through: it ends without the end of the stream, so that the
+   merge fails instead of reporting all the routes of the other file. */
+void
+diff_file_error (char *path)
+{
+  if (! diff_out)
+    return;
+  fprintf (stderr, "diff: can't read %s.\n", path);
+  exit (-1);
+}
+
+void
+diff_file_end ()
+{
+  if (diff_out)
+    fflush (diff_out);
+}
+
+/* the parent reads the next entry of the stream. */
+static void
+diff_read (struct diff_stream *s, void *data, size_t len)
+{
+  if (len && fread (data, 1, len, s->fp) != len)
+    {
+      fprintf (stderr, "diff: the routes of %s ended unexpectedly.\n",
+               s->path);
+      exit (-1);
+    }
+}
+
+static void
+diff_next (struct diff_stream *s)
+{
+  diff_read (s, &s->entry, sizeof (s->entry));
+  if (! s->entry.af)
+    return;
+  if (s->entry.path_count > ROUTE_PATH_LIMIT)
+    {
+      fprintf (stderr, "diff: malformed route from %s.\n", s->path);
+      exit (-1);
+    }
+  diff_read (s, s->entry_path, s->entry.path_count * sizeof (uint32_t));
+  if (s->entry.text_length > s->text_size)
+    {
+      s->text_size = s->entry.text_length;
+      s->text = realloc (s->text, s->text_size);
+      assert (s->text);
+    }
+  diff_read (s, s->text, s->entry.text_length);
+}
+
+static void
+diff_peers (struct diff_stream *s)
+{
+  diff_read (s, &s->npeers, sizeof (s->npeers));
+  s->peers = malloc ((s->npeers + 1) * sizeof (struct diff_peer));
+  assert (s->peers);
+  diff_read (s, s->peers, s->npeers * sizeof (struct diff_peer));
+}
+
+/* the peers of the second file are numbered after the first, and
+   the same peers (by the address and the AS number) share it. */
+static void
+diff_map_peers ()
+{
+  struct diff_stream *a = &diff_stream[0], *b = &diff_stream[1];
+  uint32_t i, j;
+
+  diff_map = malloc ((b->npeers + 1) * sizeof (int));
+  diff_slot = malloc ((a->npeers + b->npeers + 1) * sizeof (int));
+  assert (diff_map && diff_slot);
+
+  for (j = 0; j < b->npeers; j++)
+    {
+      diff_map[j] = (diff_peer_spec ? -1 : (int) (a->npeers + j));
+      for (i = 0; i < a->npeers; i++)
+        {
+          if (a->peers[i].asnumber == b->peers[j].asnumber &&
+              ! memcmp (&a->peers[i].ipv4_addr, &b->peers[j].ipv4_addr,
+                        sizeof (struct in_addr)) &&
+              ! memcmp (&a->peers[i].ipv6_addr, &b->peers[j].ipv6_addr,
+                        sizeof (struct in6_addr)))
+            {
+              diff_map[j] = (a->peers[i].selected ? (int) i : -1);
+              break;
+            }
+        }
+      if (verbose && diff_map[j] >= 0 && diff_map[j] < a->npeers)
+        printf ("diff: peer %u in %s is peer %d in %s.\n",
+                j, b->path, diff_map[j], a->path);
+    }
+
+  for (i = 0; i < a->npeers + b->npeers; i++)
+    diff_slot[i] = -1;
+}
+
+/* take the routes of the prefix from the stream. */
+static void
+diff_group (struct diff_stream *s, int second, struct diff_entry *key)
+{
+  struct diff_route *r;
+  int id;
+
+  s->group_size = 0;
+  s->group_text_length = 0;
+  while (s->entry.af && ! diff_cmp (&s->entry, key))
+    {
+      if (second)
+        id = (s->entry.peer_index < s->npeers ?
+              diff_map[s->entry.peer_index] : -1);
+      else
+        id = (s->entry.peer_index < s->npeers ? s->entry.peer_index : -1);
+
+      if (id >= 0)
+        {
+          if (s->group_size >= s->group_limit)
+            {
+              s->group_limit = (s->group_limit ? s->group_limit * 2 : 16);
+              s->group = realloc (s->group, s->group_limit *
+                                  sizeof (struct diff_route));
+              assert (s->group);
+            }
+          if (s->group_text_length + s->entry.text_length >
+              s->group_text_size)
+            {
+              s->group_text_size = (s->group_text_size ?
+                                    s->group_text_size * 2 : 4096);
+              while (s->group_text_length + s->entry.text_length >
+                     s->group_text_size)
+                s->group_text_size *= 2;
+              s->group_text = realloc (s->group_text, s->group_text_size);
+              assert (s->group_text);
+            }
+
+          r = &s->group[s->group_size++];
+          r->entry = s->entry;
+          memcpy (r->path, s->entry_path,
+                  s->entry.path_count * sizeof (uint32_t));
+          r->text_offset = s->group_text_length;
+          r->id = id;
+          memcpy (s->group_text + s->group_text_length, s->text,
+                  s->entry.text_length);
+          s->group_text_length += s->entry.text_length;
+        }
+
+      diff_next (s);
+    }
+}
+
+static void
+diff_print (struct obuf *ob, char flag, struct diff_stream *s,
+            struct diff_route *r)
+{
+  OBUF_CHAR (ob, flag);
+  obuf_mem (ob, s->group_text + r->text_offset, r->entry.text_length);
+  obuf_write (ob, stdout);
+}
+
+static int
+diff_changed_route (struct diff_route *a, struct diff_route *b)
+{
+  return (memcmp (a->entry.nexthop, b->entry.nexthop, MAX_ADDR_LENGTH) ||
+          a->entry.origin != b->entry.origin ||
+          a->entry.path_count != b->entry.path_count ||
+          memcmp (a->path, b->path, a->entry.path_count * sizeof (uint32_t)));
+}
+
+/* compare the routes of the prefix by the peers. */
+static void
+diff_compare ()
+{
+  struct diff_stream *a = &diff_stream[0], *b = &diff_stream[1];
+  struct obuf *ob = obuf_get ();
+  struct diff_route *r, *other;
+  int i;
+
+  for (i = 0; i < b->group_size; i++)
+    diff_slot[b->group[i].id] = i;
+
+  for (i = 0; i < a->group_size; i++)
+    {
+      r = &a->group[i];
+      if (diff_slot[r->id] < 0)
+        {
+          diff_print (ob, '-', a, r);
+          diff_removed++;
+          continue;
+        }
+
+      other = &b->group[diff_slot[r->id]];
+      if (diff_changed_route (r, other))
+        {
+          diff_print (ob, '<', a, r);
+          diff_print (ob, '>', b, other);
+          diff_changed++;
+        }
+      else
+        diff_unchanged++;
+      other->id = -1;
+    }
+
+  for (i = 0; i < b->group_size; i++)
+    {
+      r = &b->group[i];
+      if (r->id < 0)
+        continue;
+      diff_slot[r->id] = -1;
+      diff_print (ob, '+', b, r);
+      diff_added++;
+    }
+
+  /* the matched ones. */
+  for (i = 0; i < a->group_size; i++)
+    diff_slot[a->group[i].id] = -1;
+}
+
+static void
+diff_merge ()
+{
+  struct diff_stream *a = &diff_stream[0], *b = &diff_stream[1];
+  struct diff_entry key;
+  int i, status;
+
+  diff_peers (a);
+  diff_peers (b);
+  diff_map_peers ();
+
+  diff_next (a);
+  diff_next (b);
+  while (a->entry.af || b->entry.af)
+    {
+      if (! b->entry.af ||
+          (a->entry.af && diff_cmp (&a->entry, &b->entry) <= 0))
+        key = a->entry;
+      else
+        key = b->entry;
+
+      diff_group (a, 0, &key);
+      diff_group (b, 1, &key);
+      diff_compare ();
+    }
+
+  if (verbose)
+    printf ("diff: %'llu removed, %'llu added, %'llu changed, "
+            "%'llu unchanged.\n",
+            (unsigned long long) diff_removed,
+            (unsigned long long) diff_added,
+            (unsigned long long) diff_changed,
+            (unsigned long long) diff_unchanged);
+
+  for (i = 0; i < 2; i++)
+    {
+      struct diff_stream *s = &diff_stream[i];
+      fclose (s->fp);
+      if (waitpid (s->pid, &status, 0) < 0 ||
+          ! WIFEXITED (status) || WEXITSTATUS (status))
+        {
+          fprintf (stderr, "diff: reading %s failed.\n", s->path);
+          exit (-1);
+        }
+      free (s->peers);
+      free (s->text);
+      free (s->group);
+      free (s->group_text);
+    }
+  free (diff_map);
+  free (diff_slot);
+}
+
+void
+diff_finish ()
+{
+  struct diff_entry end;
+
+  if (! diff_out)
+    {
+      diff_merge ();
+      return;
+    }
+
+  if (! diff_header_done)
+    diff_header ();
+  memset (&end, 0, sizeof (end));
+  diff_write (&end, sizeof (end));
+  if (fclose (diff_out) != 0)
+    {
+      fprintf (stderr, "diff: can't write to the parent: %s\n",
+               strerror (errno));
+      exit (-1);
+    }
+  diff_out = NULL;
+}
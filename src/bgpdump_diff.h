@@ -0,0 +1,78 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BGPDUMP_DIFF_H_
+#define _BGPDUMP_DIFF_H_
+
+/* The diff of two files (-D) compares the routes of the same peers
+   between two rib files (e.g., the consecutive dumps). Each file is
+   read by a child process, which writes its routes to a pipe in the
+   order of the prefixes (as in the TABLE_DUMP_V2 records); the parent
+   merges the two streams, and prints the routes of each prefix:
+
+   -: the route is only in the first file (removed).
+   +: the route is only in the second file (added).
+   <, >: the route in the first and in the second file, with
+      the different nexthop, as-path, or origin (changed).
+
+   The memory is for the routes of one prefix, not for the tables.
+   The peers are matched by their address and AS number, so that the
+   peer index (-p, of the first file) may differ in the second file.
+
+   The stream of a child begins with the peer table:
+
+     uint32_t npeers; struct diff_peer [npeers];
+
+   followed by the routes, each of which is:
+
+     struct diff_entry; uint32_t path[path_count]; char text[text_length];
+
+   and ends with a struct diff_entry of af 0. */
+
+struct diff_peer
+{
+  struct in_addr ipv4_addr;
+  struct in6_addr ipv6_addr;
+  uint32_t asnumber;
+  uint32_t selected;        /* by the peer spec (-p, -a) of the file. */
+};
+
+struct diff_entry
+{
+  uint8_t af;
+  uint8_t prefix_length;
+  uint8_t origin;
+  uint8_t path_count;       /* in the path[] that follows. */
+  uint16_t peer_index;
+  uint16_t reserved;
+  uint32_t text_length;     /* of the formatted route that follows. */
+  char prefix[MAX_ADDR_LENGTH];
+  char nexthop[MAX_ADDR_LENGTH];
+};
+
+#define DIFF_MERGE -1
+
+int diff_start (int argc, char **argv);
+
+void diff_route (int peer_index, struct bgp_route *route,
+                 char *text, int text_length);
+void diff_file_error (char *path);
+void diff_file_end ();
+void diff_finish ();
+
+#endif /*_BGPDUMP_DIFF_H_*/
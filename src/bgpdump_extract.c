@@ -0,0 +1,517 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#include <zlib.h>
+#if defined (HAVE_LIBZSTD) && defined (HAVE_ZSTD_H)
+#define EXTRACT_ZSTD 1
+#include <zstd.h>
+#endif
+
+#include "bgpdump.h"
+#include "bgpdump_output.h"
+#include "bgpdump_extract.h"
+
+struct extract_file
+{
+  /* the parser's side. */
+  char *path;
+  char *buf;
+  size_t len;
+
+  /* the flush thread's side. */
+  int peer_index;
+  int fd;
+  int created;
+  int failed;
+  struct extract_file *prev;   /* the LRU list of the open files. */
+  struct extract_file *next;
+};
+
+struct extract_job
+{
+  struct extract_file *ef;
+  char *buf;
+  size_t len;
+};
+
+int extract_fd_max = 0;
+int extract_compress = OUTPUT_COMPRESS_NONE;
+
+static struct extract_file **extract_table = NULL;
+static int extract_table_size = 0;
+static int extract_method = OUTPUT_COMPRESS_NONE;
+
+static struct extract_job extract_queue[EXTRACT_QUEUE_SIZE];
+static unsigned int extract_head = 0;
+static unsigned int extract_tail = 0;
+static int extract_busy = 0;
+static int extract_done = 0;
+static pthread_mutex_t extract_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t extract_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t extract_thread;
+static int extract_running = 0;
+
+/* the buffers returned by the flush thread. */
+static char **extract_pool = NULL;
+static int extract_pool_size = 0;
+static int extract_pool_limit = 0;
+
+static struct extract_file *extract_lru_head = NULL;
+static struct extract_file *extract_lru_tail = NULL;
+static int extract_nopen = 0;
+
+static z_stream extract_zs;
+static char *extract_zbuf = NULL;
+static size_t extract_zbuf_size = 0;
+
+static char *
+extract_buf_get ()
+{
+  char *buf = NULL;
+
+  pthread_mutex_lock (&extract_mutex);
+  if (extract_pool_size)
+    buf = extract_pool[--extract_pool_size];
+  pthread_mutex_unlock (&extract_mutex);
+
+  if (! buf)
+    {
+      buf = malloc (EXTRACT_BUFSIZ);
+      assert (buf);
+    }
+  return buf;
+}
+
+/* called with the mutex held. */
+static void
+extract_buf_put (char *buf)
+{
+  if (extract_pool_size >= extract_pool_limit)
+    {
+      extract_pool_limit = (extract_pool_limit ?
+                            extract_pool_limit * 2 : EXTRACT_QUEUE_SIZE);
+      extract_pool = realloc (extract_pool,
+                              extract_pool_limit * sizeof (char *));
+      assert (extract_pool);
+    }
+  extract_pool[extract_pool_size++] = buf;
+}
+
+static void
+extract_lru_unlink (struct extract_file *ef)
+{
+  if (ef->prev)
+    ef->prev->next = ef->next;
+  else
+    extract_lru_head = ef->next;
+  if (ef->next)
+    ef->next->prev = ef->prev;
+  else
+    extract_lru_tail = ef->prev;
+  ef->prev = ef->next = NULL;
+}
+
+static void
+extract_lru_push (struct extract_file *ef)
+{
+  ef->prev = NULL;
+  ef->next = extract_lru_head;
+  if (extract_lru_head)
+    extract_lru_head->prev = ef;
+  extract_lru_head = ef;
+  if (! extract_lru_tail)
+    extract_lru_tail = ef;
+}
+
+static void
+extract_fd_close (struct extract_file *ef)
+{
+  extract_lru_unlink (ef);
+  close (ef->fd);
+  ef->fd = -1;
+  extract_nopen--;
+}
+
+/* the file is truncated when first opened, and appended
+   when reopened after it was closed by the LRU. */
+static int
+extract_fd_open (struct extract_file *ef)
+{
+  int flags;
+
+  if (ef->fd >= 0)
+    {
+      if (extract_lru_head != ef)
+        {
+          extract_lru_unlink (ef);
+          extract_lru_push (ef);
+        }
+      return 0;
+    }
+  if (ef->failed)
+    return -1;
+
+  if (extract_nopen >= extract_fd_max)
+    extract_fd_close (extract_lru_tail);
+
+  flags = O_WRONLY | O_CREAT | (ef->created ? O_APPEND : O_TRUNC);
+  ef->fd = open (ef->path, flags, 0644);
+  if (ef->fd < 0)
+    {
+      fprintf (stderr, "can't open file: %s: %s\n",
+               ef->path, strerror (errno));
+      fprintf (stderr, "discarding info for file: %s peer: %d\n",
+               filename, ef->peer_index);
+      ef->failed++;
+      return -1;
+    }
+  ef->created++;
+  extract_lru_push (ef);
+  extract_nopen++;
+  return 0;
+}
+
+static void
+extract_fd_write (struct extract_file *ef, char *buf, size_t len)
+{
+  ssize_t ret;
+
+  while (len)
+    {
+      ret = write (ef->fd, buf, len);
+      if (ret < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          fprintf (stderr, "extract: write failed: %s: %s\n",
+                   ef->path, strerror (errno));
+          return;
+        }
+      buf += ret;
+      len -= ret;
+    }
+}
+
+/* each buffer becomes one gzip member (or zstd frame). */
+static void
+extract_flush (struct extract_job *job)
+{
+  char *buf = job->buf;
+  size_t len = job->len;
+
+  if (extract_fd_open (job->ef) < 0)
+    return;
+
+  switch (extract_method)
+    {
+    case OUTPUT_COMPRESS_GZIP:
+      deflateReset (&extract_zs);
+      extract_zs.next_in = (Bytef *) job->buf;
+      extract_zs.avail_in = job->len;
+      extract_zs.next_out = (Bytef *) extract_zbuf;
+      extract_zs.avail_out = extract_zbuf_size;
+      if (deflate (&extract_zs, Z_FINISH) != Z_STREAM_END)
+        {
+          fprintf (stderr, "extract: deflate failed: %s\n", job->ef->path);
+          return;
+        }
+      buf = extract_zbuf;
+      len = extract_zbuf_size - extract_zs.avail_out;
+      break;
+
+#ifdef EXTRACT_ZSTD
+    case OUTPUT_COMPRESS_ZSTD:
+      len = ZSTD_compress (extract_zbuf, extract_zbuf_size,
+                           job->buf, job->len, 1);
+      if (ZSTD_isError (len))
+        {
+          fprintf (stderr, "extract: zstd: %s\n", ZSTD_getErrorName (len));
+          return;
+        }
+      buf = extract_zbuf;
+      break;
+#endif
+
+    default:
+      break;
+    }
+
+  extract_fd_write (job->ef, buf, len);
+}
+
+static void *
+extract_flusher (void *arg)
+{
+  struct extract_job *job;
+
+  while (1)
+    {
+      pthread_mutex_lock (&extract_mutex);
+      while (extract_head == extract_tail && ! extract_done)
+        pthread_cond_wait (&extract_cond, &extract_mutex);
+      if (extract_head == extract_tail && extract_done)
+        {
+          pthread_mutex_unlock (&extract_mutex);
+          break;
+        }
+      extract_busy++;
+      pthread_mutex_unlock (&extract_mutex);
+
+      job = &extract_queue[extract_tail % EXTRACT_QUEUE_SIZE];
+      extract_flush (job);
+
+      pthread_mutex_lock (&extract_mutex);
+      extract_buf_put (job->buf);
+      extract_tail++;
+      extract_busy = 0;
+      pthread_cond_broadcast (&extract_cond);
+      pthread_mutex_unlock (&extract_mutex);
+    }
+
+  return NULL;
+}
+
+/* hand the peer's buffer to the flush thread. */
+static void
+extract_enqueue (struct extract_file *ef)
+{
+  struct extract_job *job;
+
+  pthread_mutex_lock (&extract_mutex);
+  while (extract_head - extract_tail == EXTRACT_QUEUE_SIZE)
+    pthread_cond_wait (&extract_cond, &extract_mutex);
+  job = &extract_queue[extract_head % EXTRACT_QUEUE_SIZE];
+  job->ef = ef;
+  job->buf = ef->buf;
+  job->len = ef->len;
+  extract_head++;
+  pthread_cond_broadcast (&extract_cond);
+  pthread_mutex_unlock (&extract_mutex);
+
+  ef->buf = NULL;
+  ef->len = 0;
+}
+
+void
+extract_init ()
+{
+  struct rlimit rl;
+  int compress = extract_compress;
+  int i;
+
+  extract_method = compress;
+
+#ifndef EXTRACT_ZSTD
+  if (compress == OUTPUT_COMPRESS_ZSTD)
+    {
+      fprintf (stderr, "extract: zstd is not supported in this build.\n");
+      exit (-1);
+    }
+#endif
+
+  /* leave the half of the descriptors to the others. */
+  if (extract_fd_max <= 0)
+    {
+      extract_fd_max = 256;
+      if (getrlimit (RLIMIT_NOFILE, &rl) == 0 &&
+          rl.rlim_cur != RLIM_INFINITY)
+        extract_fd_max = rl.rlim_cur / 2;
+      if (extract_fd_max > 1024)
+        extract_fd_max = 1024;
+      if (extract_fd_max < 1)
+        extract_fd_max = 1;
+    }
+
+  if (compress == OUTPUT_COMPRESS_GZIP)
+    {
+      memset (&extract_zs, 0, sizeof (extract_zs));
+      i = deflateInit2 (&extract_zs, 1, Z_DEFLATED, 15 + 16, 8,
+                        Z_DEFAULT_STRATEGY);
+      assert (i == Z_OK);
+      extract_zbuf_size = deflateBound (&extract_zs, EXTRACT_BUFSIZ);
+    }
+#ifdef EXTRACT_ZSTD
+  if (compress == OUTPUT_COMPRESS_ZSTD)
+    extract_zbuf_size = ZSTD_compressBound (EXTRACT_BUFSIZ);
+#endif
+  if (extract_zbuf_size)
+    {
+      extract_zbuf = malloc (extract_zbuf_size);
+      assert (extract_zbuf);
+    }
+
+  if (pthread_create (&extract_thread, NULL, extract_flusher, NULL))
+    {
+      fprintf (stderr, "extract: can't create the flush thread.\n");
+      exit (-1);
+    }
+  extract_running++;
+}
+
+static struct extract_file *
+extract_file_get (int peer_index)
+{
+  struct extract_file *ef;
+  char path[128];
+  int size;
+
+  if (peer_index >= extract_table_size)
+    {
+      size = (extract_table_size ? extract_table_size : 64);
+      while (peer_index >= size)
+        size *= 2;
+      extract_table = realloc (extract_table,
+                               size * sizeof (struct extract_file *));
+      assert (extract_table);
+      memset (&extract_table[extract_table_size], 0,
+              (size - extract_table_size) * sizeof (struct extract_file *));
+      extract_table_size = size;
+    }
+
+  /* allocated one by one, as the queued jobs point to them. */
+  ef = extract_table[peer_index];
+  if (! ef)
+    {
+      ef = malloc (sizeof (struct extract_file));
+      assert (ef);
+      memset (ef, 0, sizeof (struct extract_file));
+      snprintf (path, sizeof (path), "%s-p%d.txt%s", filename, peer_index,
+                (extract_method == OUTPUT_COMPRESS_GZIP ? ".gz" :
+                 extract_method == OUTPUT_COMPRESS_ZSTD ? ".zst" : ""));
+      ef->path = strdup (path);
+      assert (ef->path);
+      ef->peer_index = peer_index;
+      ef->fd = -1;
+      extract_table[peer_index] = ef;
+    }
+  return ef;
+}
+
+void
+extract_write (int peer_index, const char *data, size_t len)
+{
+  struct extract_file *ef = extract_file_get (peer_index);
+  size_t n;
+
+  while (len)
+    {
+      if (! ef->buf)
+        ef->buf = extract_buf_get ();
+      n = EXTRACT_BUFSIZ - ef->len;
+      if (n > len)
+        n = len;
+      memcpy (ef->buf + ef->len, data, n);
+      ef->len += n;
+      data += n;
+      len -= n;
+      if (ef->len == EXTRACT_BUFSIZ)
+        extract_enqueue (ef);
+    }
+}
+
+/* flush all the buffers, and wait for the flush thread to finish
+   them before closing the files of this input file. */
+void
+extract_file_end ()
+{
+  struct extract_file *ef;
+  int i;
+
+  if (! extract_running)
+    return;
+
+  for (i = 0; i < extract_table_size; i++)
+    {
+      ef = extract_table[i];
+      if (ef && ef->len)
+        extract_enqueue (ef);
+    }
+
+  pthread_mutex_lock (&extract_mutex);
+  while (extract_head != extract_tail || extract_busy)
+    pthread_cond_wait (&extract_cond, &extract_mutex);
+  pthread_mutex_unlock (&extract_mutex);
+
+  /* the flush thread is idle now. */
+  while (extract_lru_head)
+    extract_fd_close (extract_lru_head);
+
+  for (i = 0; i < extract_table_size; i++)
+    {
+      ef = extract_table[i];
+      if (! ef)
+        continue;
+      if (ef->buf)
+        {
+          pthread_mutex_lock (&extract_mutex);
+          extract_buf_put (ef->buf);
+          pthread_mutex_unlock (&extract_mutex);
+        }
+      free (ef->path);
+      free (ef);
+      extract_table[i] = NULL;
+    }
+}
+
+void
+extract_finish ()
+{
+  int i;
+
+  if (! extract_running)
+    return;
+
+  extract_file_end ();
+
+  pthread_mutex_lock (&extract_mutex);
+  extract_done++;
+  pthread_cond_broadcast (&extract_cond);
+  pthread_mutex_unlock (&extract_mutex);
+  pthread_join (extract_thread, NULL);
+  extract_running = 0;
+
+  if (extract_method == OUTPUT_COMPRESS_GZIP)
+    deflateEnd (&extract_zs);
+  free (extract_zbuf);
+  extract_zbuf = NULL;
+
+  for (i = 0; i < extract_pool_size; i++)
+    free (extract_pool[i]);
+  free (extract_pool);
+  extract_pool = NULL;
+  extract_pool_size = extract_pool_limit = 0;
+
+  free (extract_table);
+  extract_table = NULL;
+  extract_table_size = 0;
+}
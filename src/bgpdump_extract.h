@@ -0,0 +1,42 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BGPDUMP_EXTRACT_H_
+#define _BGPDUMP_EXTRACT_H_
+
+/* The extract writer (-x) keeps a large buffer for each peer instead
+   of a stdio FILE. A full buffer is queued to a flush thread, which
+   (optionally compresses it and) writes it to the peer's file. The
+   flush thread keeps at most extract_fd_max files open, closing the
+   least recently used one and reopening it later in append mode, so
+   that thousands of peers do not run out of the descriptors.
+   A compressed file is a series of gzip members (or zstd frames), one
+   for each buffer, which zcat (zstdcat) reads as one stream. */
+
+#define EXTRACT_BUFSIZ (64 * 1024)
+#define EXTRACT_QUEUE_SIZE 64
+
+extern int extract_fd_max;
+extern int extract_compress;
+
+void extract_init ();
+void extract_write (int peer_index, const char *data, size_t len);
+void extract_file_end ();
+void extract_finish ();
+
+#endif /*_BGPDUMP_EXTRACT_H_*/
@@ -21,6 +21,9 @@
 #include <strings.h>
 #include <stdint.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <errno.h>
 
 #include <bzlib.h>
@@ -166,6 +169,8 @@ get_file_format (char *filename)
     }
   if (! strcmp (p, ".gz"))
     return FORMAT_GZIP;
+  if (! strcmp (p, ".zst"))
+    return FORMAT_ZSTD;
   return FORMAT_RAW;
 }
 
@@ -206,3 +211,21 @@ get_file_filename (char *filepath)
 }
 
 
+
+/* by fstat(), as stat is also the name of a global variable. */
+int
+get_file_stat (char *filepath, uint64_t *size, int64_t *mtime)
+{
+  struct stat st;
+  int fd, ret;
+  fd = open (filepath, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  ret = fstat (fd, &st);
+  close (fd);
+  if (ret < 0)
+    return -1;
+  *size = st.st_size;
+  *mtime = st.st_mtime;
+  return 0;
+}
@@ -24,6 +24,7 @@ typedef enum
   FORMAT_RAW,
   FORMAT_BZIP2,
   FORMAT_GZIP,
+  FORMAT_ZSTD,
   FORMAT_UNKNOWN
 } file_format_t;
 
@@ -64,6 +65,7 @@ int gclose (void *file);
 file_format_t get_file_format (char *filename);
 struct access_method *get_access_method (file_format_t format);
 char *get_file_filename (char *filepath);
+int get_file_stat (char *filepath, uint64_t *size, int64_t *mtime);
 
 #endif /*_BGPDUMP_FILE_H_*/
 
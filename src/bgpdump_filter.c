@@ -0,0 +1,1018 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Filter expression:
+ *
+ *   expr      := term [ "or" term ]...
+ *   term      := factor [ "and" factor ]...
+ *   factor    := "not" factor | "(" expr ")" | predicate
+ *   predicate := "prefix" <prefix>/<plen> [ "exact" | "longer" | "orlonger"
+ *                                          | "ge" <n> | "le" <n> ]...
+ *              | "peer" <peer_index>
+ *              | "peer-as" <asn>
+ *              | "origin-as" <asn>
+ *              | "path-contains" <asn>
+ *              | "path-len" [ "=" | "!=" | "<" | "<=" | ">" | ">=" ] <n>
+ *              | "nexthop" <addr>
+ *              | "community" <asn>:<val> | <global>:<local1>:<local2>
+ *              | "aspath-regex" "<regex>"
+ *
+ * e.g., "prefix 10.0.0.0/8 le 24 and not path-contains 3356"
+ *
+ * The patterns given by -R are or'ed, and and'ed with the expression.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <assert.h>
+
+#include "ptree.h"
+
+#include "bgpdump_option.h"
+#include "bgpdump_peer.h"
+#include "bgpdump_route.h"
+#include "bgpdump_aspath_regex.h"
+#include "bgpdump_filter.h"
+
+#define FILTER_TOKEN_MAX 512
+
+#define FILTER_STAGE_RECORD 0
+#define FILTER_STAGE_ENTRY  1
+#define FILTER_STAGE_ATTR   2
+
+struct filter_insn filter_program[FILTER_PROGRAM_MAX];
+int filter_program_size = 0;
+
+/* the earliest stage in which the whole program can be decided. */
+int filter_stage_max = FILTER_STAGE_RECORD;
+
+/* the state of the current RIB record. */
+int filter_af;
+char filter_prefix[16];
+int filter_plen;
+int filter_record_result = FILTER_UNKNOWN;
+
+char *filter_tokens[FILTER_TOKEN_MAX];
+int filter_ntokens;
+int filter_pos;
+char *filter_strbuf = NULL;
+
+/* the attribute values in the raw RIB entry. */
+struct filter_attr
+{
+  char *as_path;
+  int as_path_len;
+  char *nexthop;
+  int nexthop_len;
+  char *mp_reach;
+  int mp_reach_len;
+  char *community;
+  int community_len;
+  char *large_community;
+  int large_community_len;
+  int aspath_regex_done;
+  uint64_t aspath_regex_mask;
+};
+
+static int filter_parse_expr ();
+
+static int
+filter_emit (struct filter_insn *insn)
+{
+  if (filter_program_size >= FILTER_PROGRAM_MAX)
+    {
+      printf ("filter: expression too long.\n");
+      return -1;
+    }
+  filter_program[filter_program_size++] = *insn;
+  return 0;
+}
+
+static int
+filter_emit_op (enum filter_op op)
+{
+  struct filter_insn insn;
+  memset (&insn, 0, sizeof (insn));
+  insn.op = op;
+  return filter_emit (&insn);
+}
+
+static char *
+filter_token ()
+{
+  if (filter_pos < filter_ntokens)
+    return filter_tokens[filter_pos];
+  return NULL;
+}
+
+static char *
+filter_next ()
+{
+  if (filter_pos < filter_ntokens)
+    return filter_tokens[filter_pos++];
+  return NULL;
+}
+
+static int
+filter_parse_number (char *s, uint32_t *val)
+{
+  char *endptr;
+  unsigned long v;
+
+  if (! s || ! *s)
+    return -1;
+  if (! strncasecmp (s, "AS", 2))
+    s += 2;
+  v = strtoul (s, &endptr, 10);
+  if (*endptr != '\0' || v > 0xffffffffUL)
+    return -1;
+  *val = (uint32_t) v;
+  return 0;
+}
+
+static int
+filter_parse_prefix (struct filter_insn *insn)
+{
+  char buf[64], *p, *s, *arg, *endptr;
+  unsigned long plen;
+  int maxlen;
+  int ge = -1, le = -1;
+
+  s = filter_next ();
+  if (! s)
+    {
+      printf ("filter: prefix: missing argument.\n");
+      return -1;
+    }
+  arg = s;
+  snprintf (buf, sizeof (buf), "%s", arg);
+
+  p = index (buf, '/');
+  if (! p)
+    {
+      printf ("filter: prefix: missing prefixlen: %s\n", s);
+      return -1;
+    }
+  *p++ = '\0';
+
+  insn->af = (index (buf, ':') ? AF_INET6 : AF_INET);
+  maxlen = (insn->af == AF_INET ? 32 : 128);
+  if (inet_pton (insn->af, buf, insn->addr) != 1)
+    {
+      printf ("filter: prefix: malformed address: %s\n", s);
+      return -1;
+    }
+  plen = strtoul (p, &endptr, 10);
+  if (*endptr != '\0' || plen > maxlen)
+    {
+      printf ("filter: prefix: malformed prefixlen: %s\n", s);
+      return -1;
+    }
+  insn->plen = plen;
+
+  /* the range modifiers. */
+  while ((s = filter_token ()) != NULL)
+    {
+      uint32_t val;
+      if (! strcmp (s, "exact"))
+        ge = le = plen;
+      else if (! strcmp (s, "orlonger"))
+        {
+          ge = plen;
+          le = maxlen;
+        }
+      else if (! strcmp (s, "longer"))
+        {
+          ge = plen + 1;
+          le = maxlen;
+        }
+      else if (! strcmp (s, "ge") || ! strcmp (s, "le"))
+        {
+          filter_next ();
+          if (filter_parse_number (filter_token (), &val) < 0 ||
+              val > maxlen)
+            {
+              printf ("filter: prefix: malformed %s value.\n", s);
+              return -1;
+            }
+          if (! strcmp (s, "ge"))
+            ge = val;
+          else
+            le = val;
+        }
+      else
+        break;
+      filter_next ();
+    }
+
+  /* like the prefix-list: "ge" only means up to the maximum,
+     and "le" only means from the prefixlen. */
+  if (ge < 0 && le < 0)
+    ge = le = plen;
+  else if (ge < 0)
+    ge = plen;
+  else if (le < 0)
+    le = maxlen;
+
+  if (ge < plen || le < ge)
+    {
+      printf ("filter: prefix: wrong range: %s ge %d le %d\n",
+              arg, ge, le);
+      return -1;
+    }
+
+  insn->ge = ge;
+  insn->le = le;
+  return 0;
+}
+
+static int
+filter_parse_community (struct filter_insn *insn)
+{
+  char buf[64], *s, *p, *q;
+  uint32_t v1, v2, v3;
+
+  s = filter_next ();
+  if (! s)
+    {
+      printf ("filter: community: missing argument.\n");
+      return -1;
+    }
+
+  insn->op = FILTER_OP_COMMUNITY;
+  if (! strcmp (s, "no-export"))
+    insn->val[0] = 0xffffff01;
+  else if (! strcmp (s, "no-advertise"))
+    insn->val[0] = 0xffffff02;
+  else if (! strcmp (s, "no-export-subconfed"))
+    insn->val[0] = 0xffffff03;
+  else if (! strcmp (s, "blackhole"))
+    insn->val[0] = 0xffff029a;
+  else
+    {
+      snprintf (buf, sizeof (buf), "%s", s);
+      p = index (buf, ':');
+      if (! p)
+        goto malformed;
+      *p++ = '\0';
+      q = index (p, ':');
+      if (q)
+        *q++ = '\0';
+
+      if (filter_parse_number (buf, &v1) < 0 ||
+          filter_parse_number (p, &v2) < 0)
+        goto malformed;
+
+      if (q)
+        {
+          if (filter_parse_number (q, &v3) < 0)
+            goto malformed;
+          insn->op = FILTER_OP_LARGE_COMMUNITY;
+          insn->val[0] = v1;
+          insn->val[1] = v2;
+          insn->val[2] = v3;
+        }
+      else
+        {
+          if (v1 > 0xffff || v2 > 0xffff)
+            goto malformed;
+          insn->val[0] = (v1 << 16) | v2;
+        }
+    }
+  return 0;
+
+malformed:
+  printf ("filter: community: malformed: %s\n", s);
+  return -1;
+}
+
+static int
+filter_parse_predicate ()
+{
+  struct filter_insn insn;
+  char *s, *arg;
+  int ret;
+
+  memset (&insn, 0, sizeof (insn));
+  s = filter_next ();
+  if (! s)
+    {
+      printf ("filter: unexpected end of the expression.\n");
+      return -1;
+    }
+
+  if (! strcmp (s, "prefix"))
+    {
+      insn.op = FILTER_OP_PREFIX;
+      if (filter_parse_prefix (&insn) < 0)
+        return -1;
+    }
+  else if (! strcmp (s, "peer") || ! strcmp (s, "peer-as") ||
+           ! strcmp (s, "origin-as") || ! strcmp (s, "path-contains"))
+    {
+      if (! strcmp (s, "peer"))
+        insn.op = FILTER_OP_PEER;
+      else if (! strcmp (s, "peer-as"))
+        insn.op = FILTER_OP_PEER_AS;
+      else if (! strcmp (s, "origin-as"))
+        insn.op = FILTER_OP_ORIGIN_AS;
+      else
+        insn.op = FILTER_OP_PATH_CONTAINS;
+      arg = filter_next ();
+      if (filter_parse_number (arg, &insn.val[0]) < 0)
+        {
+          printf ("filter: %s: malformed number: %s\n", s,
+                  (arg ? arg : ""));
+          return -1;
+        }
+    }
+  else if (! strcmp (s, "path-len"))
+    {
+      insn.op = FILTER_OP_PATH_LEN;
+      insn.cmp = FILTER_CMP_EQ;
+      arg = filter_token ();
+      if (arg && (! strcmp (arg, "=") || ! strcmp (arg, "==")))
+        insn.cmp = FILTER_CMP_EQ;
+      else if (arg && ! strcmp (arg, "!="))
+        insn.cmp = FILTER_CMP_NE;
+      else if (arg && ! strcmp (arg, "<"))
+        insn.cmp = FILTER_CMP_LT;
+      else if (arg && ! strcmp (arg, "<="))
+        insn.cmp = FILTER_CMP_LE;
+      else if (arg && ! strcmp (arg, ">"))
+        insn.cmp = FILTER_CMP_GT;
+      else if (arg && ! strcmp (arg, ">="))
+        insn.cmp = FILTER_CMP_GE;
+      else
+        arg = NULL;
+      if (arg)
+        filter_next ();
+      arg = filter_next ();
+      if (filter_parse_number (arg, &insn.val[0]) < 0)
+        {
+          printf ("filter: %s: malformed number: %s\n", s,
+                  (arg ? arg : ""));
+          return -1;
+        }
+    }
+  else if (! strcmp (s, "nexthop"))
+    {
+      insn.op = FILTER_OP_NEXTHOP;
+      arg = filter_next ();
+      if (! arg)
+        {
+          printf ("filter: nexthop: missing argument.\n");
+          return -1;
+        }
+      insn.af = (index (arg, ':') ? AF_INET6 : AF_INET);
+      if (inet_pton (insn.af, arg, insn.addr) != 1)
+        {
+          printf ("filter: nexthop: malformed address: %s\n", arg);
+          return -1;
+        }
+    }
+  else if (! strcmp (s, "community"))
+    {
+      if (filter_parse_community (&insn) < 0)
+        return -1;
+    }
+  else if (! strcmp (s, "aspath-regex"))
+    {
+      insn.op = FILTER_OP_ASPATH_REGEX;
+      arg = filter_next ();
+      if (! arg)
+        {
+          printf ("filter: aspath-regex: missing argument.\n");
+          return -1;
+        }
+      /* the pattern outlives the token buffer. */
+      arg = strdup (arg);
+      assert (arg);
+      ret = aspath_regex_add (arg);
+      if (ret < 0)
+        return -1;
+      insn.val[0] = ret;
+    }
+  else
+    {
+      printf ("filter: unknown predicate: %s\n", s);
+      return -1;
+    }
+
+  return filter_emit (&insn);
+}
+
+static int
+filter_parse_factor ()
+{
+  char *s = filter_token ();
+
+  if (s && ! strcmp (s, "not"))
+    {
+      filter_next ();
+      if (filter_parse_factor () < 0)
+        return -1;
+      return filter_emit_op (FILTER_OP_NOT);
+    }
+
+  if (s && ! strcmp (s, "("))
+    {
+      filter_next ();
+      if (filter_parse_expr () < 0)
+        return -1;
+      s = filter_next ();
+      if (! s || strcmp (s, ")"))
+        {
+          printf ("filter: missing ')'.\n");
+          return -1;
+        }
+      return 0;
+    }
+
+  return filter_parse_predicate ();
+}
+
+static int
+filter_parse_term ()
+{
+  char *s;
+
+  if (filter_parse_factor () < 0)
+    return -1;
+  while ((s = filter_token ()) != NULL && ! strcmp (s, "and"))
+    {
+      filter_next ();
+      if (filter_parse_factor () < 0)
+        return -1;
+      if (filter_emit_op (FILTER_OP_AND) < 0)
+        return -1;
+    }
+  return 0;
+}
+
+static int
+filter_parse_expr ()
+{
+  char *s;
+
+  if (filter_parse_term () < 0)
+    return -1;
+  while ((s = filter_token ()) != NULL && ! strcmp (s, "or"))
+    {
+      filter_next ();
+      if (filter_parse_term () < 0)
+        return -1;
+      if (filter_emit_op (FILTER_OP_OR) < 0)
+        return -1;
+    }
+  return 0;
+}
+
+static int
+filter_tokenize (char *expr)
+{
+  char *p, *q;
+  char quote = '\0';
+
+  /* put spaces around the parentheses, and turn the spaces
+     in the quoted string into '\1' so as to keep it one token. */
+  filter_strbuf = malloc (strlen (expr) * 3 + 1);
+  assert (filter_strbuf);
+  for (p = expr, q = filter_strbuf; *p; p++)
+    {
+      if (quote)
+        {
+          if (*p == quote)
+            quote = '\0';
+          else
+            *q++ = (*p == ' ' || *p == '\t' ? '\1' : *p);
+        }
+      else if (*p == '"' || *p == '\'')
+        quote = *p;
+      else if (*p == '(' || *p == ')')
+        {
+          *q++ = ' ';
+          *q++ = *p;
+          *q++ = ' ';
+        }
+      else
+        *q++ = *p;
+    }
+  *q = '\0';
+
+  if (quote)
+    {
+      printf ("filter: unterminated quote.\n");
+      return -1;
+    }
+
+  filter_ntokens = 0;
+  p = filter_strbuf;
+  while ((q = strsep (&p, " \t\n")) != NULL)
+    {
+      if (*q == '\0')
+        continue;
+      if (filter_ntokens >= FILTER_TOKEN_MAX)
+        {
+          printf ("filter: too many tokens.\n");
+          return -1;
+        }
+      filter_tokens[filter_ntokens++] = q;
+      for (; *q; q++)
+        if (*q == '\1')
+          *q = ' ';
+    }
+  return 0;
+}
+
+static int
+filter_insn_stage (struct filter_insn *insn)
+{
+  switch (insn->op)
+    {
+    case FILTER_OP_PREFIX:
+      return FILTER_STAGE_RECORD;
+    case FILTER_OP_PEER:
+    case FILTER_OP_PEER_AS:
+      return FILTER_STAGE_ENTRY;
+    case FILTER_OP_AND:
+    case FILTER_OP_OR:
+    case FILTER_OP_NOT:
+      return FILTER_STAGE_RECORD;
+    default:
+      return FILTER_STAGE_ATTR;
+    }
+}
+
+/* the patterns by -R: or'ed together, and and'ed to the expression. */
+static int
+filter_compile_aspath_regex (int and)
+{
+  struct filter_insn insn;
+  int i, ret;
+
+  for (i = 0; i < aspath_regex_argc; i++)
+    {
+      ret = aspath_regex_add (aspath_regex_arg[i]);
+      if (ret < 0)
+        return -1;
+      memset (&insn, 0, sizeof (insn));
+      insn.op = FILTER_OP_ASPATH_REGEX;
+      insn.val[0] = ret;
+      if (filter_emit (&insn) < 0)
+        return -1;
+      if (i > 0 && filter_emit_op (FILTER_OP_OR) < 0)
+        return -1;
+    }
+  if (and && aspath_regex_argc && filter_emit_op (FILTER_OP_AND) < 0)
+    return -1;
+  return 0;
+}
+
+int
+filter_compile (char *expr)
+{
+  int i, ret = 0;
+
+  filter_program_size = 0;
+  filter_pos = 0;
+  filter_ntokens = 0;
+
+  if (expr)
+    {
+      ret = filter_tokenize (expr);
+      if (ret == 0)
+        ret = filter_parse_expr ();
+      if (ret == 0 && filter_pos < filter_ntokens)
+        {
+          printf ("filter: unexpected token: %s\n",
+                  filter_tokens[filter_pos]);
+          ret = -1;
+        }
+    }
+  if (ret == 0)
+    ret = filter_compile_aspath_regex (expr != NULL);
+  if (ret == 0 && filter_program_size == 0)
+    {
+      printf ("filter: empty expression.\n");
+      ret = -1;
+    }
+  if (ret == 0)
+    ret = aspath_regex_compile ();
+
+  filter_stage_max = FILTER_STAGE_RECORD;
+  for (i = 0; i < filter_program_size; i++)
+    if (filter_stage_max < filter_insn_stage (&filter_program[i]))
+      filter_stage_max = filter_insn_stage (&filter_program[i]);
+
+  free (filter_strbuf);
+  filter_strbuf = NULL;
+  return ret;
+}
+
+void
+filter_program_print ()
+{
+  int i;
+  char buf[64];
+  struct filter_insn *insn;
+  char *opname[] = { "prefix", "peer", "peer-as", "origin-as",
+                     "path-contains", "path-len", "nexthop", "community",
+                     "large-community", "aspath-regex", "and", "or",
+                     "not" };
+  char *cmpname[] = { "=", "!=", "<", "<=", ">", ">=" };
+
+  for (i = 0; i < filter_program_size; i++)
+    {
+      insn = &filter_program[i];
+      printf ("filter[%d]: %s", i, opname[insn->op]);
+      switch (insn->op)
+        {
+        case FILTER_OP_PREFIX:
+          inet_ntop (insn->af, insn->addr, buf, sizeof (buf));
+          printf (" %s/%d ge %d le %d", buf, insn->plen, insn->ge, insn->le);
+          break;
+        case FILTER_OP_NEXTHOP:
+          inet_ntop (insn->af, insn->addr, buf, sizeof (buf));
+          printf (" %s", buf);
+          break;
+        case FILTER_OP_PATH_LEN:
+          printf (" %s %u", cmpname[insn->cmp], insn->val[0]);
+          break;
+        case FILTER_OP_COMMUNITY:
+          printf (" %u:%u", insn->val[0] >> 16, insn->val[0] & 0xffff);
+          break;
+        case FILTER_OP_LARGE_COMMUNITY:
+          printf (" %u:%u:%u", insn->val[0], insn->val[1], insn->val[2]);
+          break;
+        case FILTER_OP_ASPATH_REGEX:
+          printf (" \"%s\"", aspath_regex_pattern[insn->val[0]]);
+          break;
+        case FILTER_OP_AND:
+        case FILTER_OP_OR:
+        case FILTER_OP_NOT:
+          break;
+        default:
+          printf (" %u", insn->val[0]);
+          break;
+        }
+      printf ("\n");
+    }
+}
+
+static void
+filter_attr_scan (struct filter_attr *fa, char *p, char *end)
+{
+  uint16_t attribute_type;
+  uint16_t attribute_length;
+
+  memset (fa, 0, sizeof (struct filter_attr));
+  while (p + 3 <= end)
+    {
+      attribute_type = ntohs (*(uint16_t *)p);
+      p += 2;
+      if (attribute_type & 0x1000)
+        {
+          if (p + 2 > end)
+            return;
+          attribute_length = ntohs (*(uint16_t *)p);
+          p += 2;
+        }
+      else
+        {
+          attribute_length = *(uint8_t *)p;
+          p += 1;
+        }
+      if (p + attribute_length > end)
+        return;
+
+      switch (attribute_type & 0xff)
+        {
+        case 2: /* AS_PATH */
+          fa->as_path = p;
+          fa->as_path_len = attribute_length;
+          break;
+        case 3: /* NEXT_HOP */
+          fa->nexthop = p;
+          fa->nexthop_len = attribute_length;
+          break;
+        case 8: /* COMMUNITY */
+          fa->community = p;
+          fa->community_len = attribute_length;
+          break;
+        case 14: /* MP_REACH_NLRI */
+          fa->mp_reach = p;
+          fa->mp_reach_len = attribute_length;
+          break;
+        case 32: /* LARGE_COMMUNITY */
+          fa->large_community = p;
+          fa->large_community_len = attribute_length;
+          break;
+        default:
+          break;
+        }
+      p += attribute_length;
+    }
+}
+
+static int
+filter_path_match (struct filter_insn *insn, struct filter_attr *fa)
+{
+  char *p = fa->as_path;
+  char *end = fa->as_path + fa->as_path_len;
+  uint8_t type, size;
+  uint32_t asn, origin_as = 0, path_len = 0;
+  int i;
+
+  while (p && p + 2 <= end)
+    {
+      type = (uint8_t) p[0];
+      size = (uint8_t) p[1];
+      p += 2;
+      if (p + size * 4 > end)
+        break;
+
+      /* an AS_SET counts as one in the path length. */
+      path_len += (type == 1 ? 1 : size);
+
+      for (i = 0; i < size; i++)
+        {
+          asn = ntohl (*(uint32_t *)p);
+          p += 4;
+          if (insn->op == FILTER_OP_PATH_CONTAINS && asn == insn->val[0])
+            return FILTER_TRUE;
+          if (type != 1)
+            origin_as = asn;
+        }
+    }
+
+  switch (insn->op)
+    {
+    case FILTER_OP_ORIGIN_AS:
+      return (origin_as == insn->val[0]);
+    case FILTER_OP_PATH_LEN:
+      switch (insn->cmp)
+        {
+        case FILTER_CMP_EQ:
+          return (path_len == insn->val[0]);
+        case FILTER_CMP_NE:
+          return (path_len != insn->val[0]);
+        case FILTER_CMP_LT:
+          return (path_len < insn->val[0]);
+        case FILTER_CMP_LE:
+          return (path_len <= insn->val[0]);
+        case FILTER_CMP_GT:
+          return (path_len > insn->val[0]);
+        case FILTER_CMP_GE:
+          return (path_len >= insn->val[0]);
+        }
+      break;
+    default:
+      break;
+    }
+  return FILTER_FALSE;
+}
+
+static int
+filter_nexthop_match (struct filter_insn *insn, struct filter_attr *fa)
+{
+  int len = (insn->af == AF_INET ? 4 : 16);
+
+  if (insn->af == AF_INET && fa->nexthop && fa->nexthop_len >= 4 &&
+      ! memcmp (fa->nexthop, insn->addr, 4))
+    return FILTER_TRUE;
+
+  /* MP_REACH_NLRI: afi(2) safi(1) nexthop-len(1) nexthop. */
+  if (fa->mp_reach && fa->mp_reach_len >= 4 + len &&
+      (uint8_t) fa->mp_reach[3] >= len &&
+      ! memcmp (&fa->mp_reach[4], insn->addr, len))
+    return FILTER_TRUE;
+
+  return FILTER_FALSE;
+}
+
+static int
+filter_community_match (struct filter_insn *insn, struct filter_attr *fa)
+{
+  char *p, *end;
+
+  if (insn->op == FILTER_OP_COMMUNITY)
+    {
+      end = fa->community + fa->community_len;
+      for (p = fa->community; p && p + 4 <= end; p += 4)
+        if (ntohl (*(uint32_t *)p) == insn->val[0])
+          return FILTER_TRUE;
+    }
+  else
+    {
+      end = fa->large_community + fa->large_community_len;
+      for (p = fa->large_community; p && p + 12 <= end; p += 12)
+        if (ntohl (*(uint32_t *)p) == insn->val[0] &&
+            ntohl (*(uint32_t *)(p + 4)) == insn->val[1] &&
+            ntohl (*(uint32_t *)(p + 8)) == insn->val[2])
+          return FILTER_TRUE;
+    }
+  return FILTER_FALSE;
+}
+
+/* the AS_PATH is decoded once for all the patterns in the program.
+   The AS_SET is taken as the last position of the path. */
+static int
+filter_aspath_regex_match (struct filter_insn *insn, struct filter_attr *fa)
+{
+  uint32_t path[ROUTE_PATH_LIMIT], set[ROUTE_SET_LIMIT];
+  int path_size = 0, set_size = 0;
+  char *p = fa->as_path;
+  char *end = fa->as_path + fa->as_path_len;
+  uint8_t type, size;
+  int i;
+
+  if (! fa->aspath_regex_done)
+    {
+      while (p && p + 2 <= end)
+        {
+          type = (uint8_t) p[0];
+          size = (uint8_t) p[1];
+          p += 2;
+          if (p + size * 4 > end)
+            break;
+          for (i = 0; i < size; i++, p += 4)
+            {
+              if (type == 1)
+                {
+                  if (set_size < ROUTE_SET_LIMIT)
+                    set[set_size++] = ntohl (*(uint32_t *)p);
+                }
+              else if (path_size < ROUTE_PATH_LIMIT)
+                path[path_size++] = ntohl (*(uint32_t *)p);
+            }
+        }
+      fa->aspath_regex_mask =
+        aspath_regex_match (path, path_size, set, set_size);
+      fa->aspath_regex_done++;
+    }
+
+  return ((fa->aspath_regex_mask & (1ULL << insn->val[0])) ?
+          FILTER_TRUE : FILTER_FALSE);
+}
+
+static int
+filter_eval (int stage, int peer_index, struct filter_attr *fa)
+{
+  uint8_t stack[FILTER_PROGRAM_MAX];
+  int sp = 0;
+  int i, a, b, val;
+  struct filter_insn *insn;
+
+  for (i = 0; i < filter_program_size; i++)
+    {
+      insn = &filter_program[i];
+      switch (insn->op)
+        {
+        case FILTER_OP_AND:
+          b = stack[--sp];
+          a = stack[--sp];
+          if (a == FILTER_FALSE || b == FILTER_FALSE)
+            val = FILTER_FALSE;
+          else if (a == FILTER_TRUE && b == FILTER_TRUE)
+            val = FILTER_TRUE;
+          else
+            val = FILTER_UNKNOWN;
+          break;
+        case FILTER_OP_OR:
+          b = stack[--sp];
+          a = stack[--sp];
+          if (a == FILTER_TRUE || b == FILTER_TRUE)
+            val = FILTER_TRUE;
+          else if (a == FILTER_FALSE && b == FILTER_FALSE)
+            val = FILTER_FALSE;
+          else
+            val = FILTER_UNKNOWN;
+          break;
+        case FILTER_OP_NOT:
+          a = stack[--sp];
+          if (a == FILTER_UNKNOWN)
+            val = FILTER_UNKNOWN;
+          else
+            val = (a == FILTER_TRUE ? FILTER_FALSE : FILTER_TRUE);
+          break;
+
+        case FILTER_OP_PREFIX:
+          val = (filter_af == insn->af &&
+                 insn->ge <= filter_plen && filter_plen <= insn->le &&
+                 ptree_match (filter_prefix, insn->addr, insn->plen));
+          break;
+
+        case FILTER_OP_PEER:
+          if (stage < FILTER_STAGE_ENTRY)
+            val = FILTER_UNKNOWN;
+          else
+            val = (peer_index == insn->val[0]);
+          break;
+        case FILTER_OP_PEER_AS:
+          if (stage < FILTER_STAGE_ENTRY)
+            val = FILTER_UNKNOWN;
+          else
+            val = (peer_index < peer_size &&
+                   peer_table[peer_index].asnumber == insn->val[0]);
+          break;
+
+        case FILTER_OP_ORIGIN_AS:
+        case FILTER_OP_PATH_CONTAINS:
+        case FILTER_OP_PATH_LEN:
+          if (stage < FILTER_STAGE_ATTR)
+            val = FILTER_UNKNOWN;
+          else
+            val = filter_path_match (insn, fa);
+          break;
+        case FILTER_OP_NEXTHOP:
+          if (stage < FILTER_STAGE_ATTR)
+            val = FILTER_UNKNOWN;
+          else
+            val = filter_nexthop_match (insn, fa);
+          break;
+        case FILTER_OP_COMMUNITY:
+        case FILTER_OP_LARGE_COMMUNITY:
+          if (stage < FILTER_STAGE_ATTR)
+            val = FILTER_UNKNOWN;
+          else
+            val = filter_community_match (insn, fa);
+          break;
+        case FILTER_OP_ASPATH_REGEX:
+          if (stage < FILTER_STAGE_ATTR)
+            val = FILTER_UNKNOWN;
+          else
+            val = filter_aspath_regex_match (insn, fa);
+          break;
+
+        default:
+          val = FILTER_UNKNOWN;
+          break;
+        }
+      stack[sp++] = val;
+    }
+
+  assert (sp == 1);
+  return stack[0];
+}
+
+/* filter_record() is called with the prefix of the RIB record,
+   before the entry loop. It returns FILTER_FALSE if the whole
+   record can be skipped. */
+int
+filter_record (int af, char *prefix, int plen)
+{
+  filter_af = af;
+  memset (filter_prefix, 0, sizeof (filter_prefix));
+  memcpy (filter_prefix, prefix, (plen + 7) / 8);
+  filter_plen = plen;
+
+  filter_record_result = filter_eval (FILTER_STAGE_RECORD, 0, NULL);
+  return filter_record_result;
+}
+
+/* filter_entry() returns FILTER_TRUE if the RIB entry matches.
+   The attributes are looked into only if the peer is not enough
+   to decide. */
+int
+filter_entry (int peer_index, char *attr, char *attr_end)
+{
+  struct filter_attr fa;
+  int ret;
+
+  if (filter_record_result != FILTER_UNKNOWN)
+    return filter_record_result;
+
+  if (filter_stage_max >= FILTER_STAGE_ENTRY)
+    {
+      ret = filter_eval (FILTER_STAGE_ENTRY, peer_index, NULL);
+      if (ret != FILTER_UNKNOWN)
+        return ret;
+    }
+
+  filter_attr_scan (&fa, attr, attr_end);
+  return filter_eval (FILTER_STAGE_ATTR, peer_index, &fa);
+}
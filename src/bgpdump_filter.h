@@ -0,0 +1,85 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BGPDUMP_FILTER_H_
+#define _BGPDUMP_FILTER_H_
+
+/* The filter expression is compiled into a small postfix program.
+   It is evaluated in three stages as early as possible: with the
+   prefix of the RIB record (before the entry loop), with the peer
+   of the RIB entry (before the attributes), and with the raw
+   attribute bytes (without decoding them into a bgp_route).
+   The predicates that can not be decided yet at a stage evaluate
+   to FILTER_UNKNOWN, so that only a definite FILTER_FALSE drops
+   the record or the entry. */
+
+#define FILTER_FALSE   0
+#define FILTER_TRUE    1
+#define FILTER_UNKNOWN 2
+
+#define FILTER_PROGRAM_MAX 256
+
+enum filter_op
+{
+  FILTER_OP_PREFIX,
+  FILTER_OP_PEER,
+  FILTER_OP_PEER_AS,
+  FILTER_OP_ORIGIN_AS,
+  FILTER_OP_PATH_CONTAINS,
+  FILTER_OP_PATH_LEN,
+  FILTER_OP_NEXTHOP,
+  FILTER_OP_COMMUNITY,
+  FILTER_OP_LARGE_COMMUNITY,
+  FILTER_OP_ASPATH_REGEX,
+  FILTER_OP_AND,
+  FILTER_OP_OR,
+  FILTER_OP_NOT,
+};
+
+enum filter_cmp
+{
+  FILTER_CMP_EQ,
+  FILTER_CMP_NE,
+  FILTER_CMP_LT,
+  FILTER_CMP_LE,
+  FILTER_CMP_GT,
+  FILTER_CMP_GE,
+};
+
+struct filter_insn
+{
+  enum filter_op op;
+  enum filter_cmp cmp;
+  int af;
+  char addr[16];
+  uint8_t plen;
+  uint8_t ge;
+  uint8_t le;
+  uint32_t val[3];
+};
+
+extern struct filter_insn filter_program[];
+extern int filter_program_size;
+
+int filter_compile (char *expr);
+void filter_program_print ();
+
+int filter_record (int af, char *prefix, int plen);
+int filter_entry (int peer_index, char *attr, char *attr_end);
+
+#endif /*_BGPDUMP_FILTER_H_*/
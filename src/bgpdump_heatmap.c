@@ -151,7 +151,7 @@ heatmap_image_hilbert_gplot (int peer_index)
   inet_ntop (AF_INET, &peer_table[peer_index].ipv4_addr,
              bgpaddr, sizeof (bgpaddr));
   unsigned long route_count4 = 0;
-  route_count4 = peer_table[peer_index].route_count_ipv4;
+  route_count4 = peer_count[peer_index].route_count_ipv4;
 
   char *p, titlename[64];
   p = rindex (heatmap_prefix, '/');
@@ -305,7 +305,7 @@ heatmap_image_hilbert_data_aspath_max_distance (int peer_index, struct ptree *pt
               node = ptree_search ((char *)&addr, 24, ptree);
               if (node)
                 {
-                  struct bgp_route *route = node->data;
+                  struct bgp_route *route = route_get (node->data);
                   //route_print (route);
                   //count++;
                   if (max < route->path_size)
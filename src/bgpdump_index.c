@@ -0,0 +1,816 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <assert.h>
+
+#include <zlib.h>
+
+#include "bgpdump.h"
+#include "bgpdump_option.h"
+#include "bgpdump_file.h"
+#include "bgpdump_data.h"
+#include "bgpdump_peer.h"
+#include "bgpdump_filter.h"
+#include "bgpdump_sample.h"
+#include "bgpdump_route.h"
+#include "bgpdump_query.h"
+#include "bgpdump_sink.h"
+#include "bgpdump_index.h"
+
+#define INDEX_CHUNK (64 * 1024)
+
+/* the index in progress (-X). */
+static char *index_source = NULL;
+static struct index_record *index_records = NULL;
+static uint64_t index_nrecords = 0;
+static uint64_t index_limit = 0;
+static struct index_checkpoint *index_checkpoints = NULL;
+static uint64_t index_ncheckpoints = 0;
+
+static void
+index_checkpoint_add (uint64_t out, uint64_t in, int bits,
+                      uint8_t *window, size_t left)
+{
+  struct index_checkpoint *cp;
+
+  index_checkpoints = realloc (index_checkpoints,
+                               (index_ncheckpoints + 1) *
+                               sizeof (struct index_checkpoint));
+  assert (index_checkpoints);
+  cp = &index_checkpoints[index_ncheckpoints++];
+  memset (cp, 0, sizeof (struct index_checkpoint));
+  cp->out = out;
+  cp->in = in;
+  cp->bits = bits;
+
+  /* the last 32KiB of the output in the circular window. */
+  if (left)
+    memcpy (cp->window, window + INDEX_WINDOW_SIZE - left, left);
+  if (left < INDEX_WINDOW_SIZE)
+    memcpy (cp->window + left, window, INDEX_WINDOW_SIZE - left);
+}
+
+/* a pass over the gzip file to find the deflate block boundaries
+   (the same as zran.c in the zlib examples). */
+static int
+index_gzip_build (char *path)
+{
+  FILE *fp;
+  z_stream zs;
+  uint8_t *input, *window;
+  uint64_t totin = 0, totout = 0, last = 0;
+  int ret = Z_OK;
+
+  fp = fopen (path, "r");
+  if (! fp)
+    return -1;
+  input = malloc (INDEX_CHUNK);
+  window = malloc (INDEX_WINDOW_SIZE);
+  assert (input && window);
+
+  memset (&zs, 0, sizeof (zs));
+  ret = inflateInit2 (&zs, 15 + 32);
+  assert (ret == Z_OK);
+
+  while (1)
+    {
+      if (zs.avail_in == 0)
+        {
+          zs.avail_in = fread (input, 1, INDEX_CHUNK, fp);
+          zs.next_in = input;
+          if (zs.avail_in == 0)
+            break;
+        }
+      if (zs.avail_out == 0)
+        {
+          zs.avail_out = INDEX_WINDOW_SIZE;
+          zs.next_out = window;
+        }
+
+      totin += zs.avail_in;
+      totout += zs.avail_out;
+      ret = inflate (&zs, Z_BLOCK);
+      totin -= zs.avail_in;
+      totout -= zs.avail_out;
+
+      if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR)
+        break;
+
+      /* the next gzip member. */
+      if (ret == Z_STREAM_END)
+        {
+          inflateReset (&zs);
+          continue;
+        }
+
+      if ((zs.data_type & 128) && ! (zs.data_type & 64) &&
+          (totout == 0 || totout - last > INDEX_SPAN))
+        {
+          index_checkpoint_add (totout, totin, zs.data_type & 7,
+                                window, zs.avail_out);
+          last = totout;
+        }
+    }
+
+  inflateEnd (&zs);
+  free (input);
+  free (window);
+  fclose (fp);
+
+  if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR)
+    {
+      fprintf (stderr, "index: inflate failed: %s\n", path);
+      return -1;
+    }
+  return 0;
+}
+
+void
+index_file_start (char *path)
+{
+  index_source = path;
+  index_nrecords = 0;
+  index_ncheckpoints = 0;
+}
+
+/* called for each MRT message, at processed_bytes. */
+void
+index_message (struct mrt_header *h, char *data_end)
+{
+  struct index_record *r;
+  char *p = (char *) h + sizeof (struct mrt_header);
+  uint16_t subtype = ntohs (h->subtype);
+  int i, size;
+
+  if (! index_source || ntohs (h->type) != BGPDUMP_TYPE_TABLE_DUMP_V2)
+    return;
+  if (subtype != BGPDUMP_TABLE_V2_PEER_INDEX_TABLE &&
+      subtype != BGPDUMP_TABLE_V2_RIB_IPV4_UNICAST &&
+      subtype != BGPDUMP_TABLE_V2_RIB_IPV6_UNICAST)
+    return;
+
+  if (index_nrecords >= index_limit)
+    {
+      index_limit = (index_limit ? index_limit * 2 : 4096);
+      index_records = realloc (index_records,
+                               index_limit * sizeof (struct index_record));
+      assert (index_records);
+    }
+
+  r = &index_records[index_nrecords];
+  memset (r, 0, sizeof (struct index_record));
+  r->offset = processed_bytes;
+  r->length = data_end - (char *) h;
+  r->subtype = subtype;
+
+  if (subtype != BGPDUMP_TABLE_V2_PEER_INDEX_TABLE)
+    {
+      if (p + 5 > data_end)
+        return;
+      r->sequence_number = ntohl (*(uint32_t *)p);
+      p += 4;
+      r->prefix_length = *(uint8_t *)p;
+      p += 1;
+      size = (r->prefix_length + 7) / 8;
+      if (size > sizeof (r->prefix) || p + size + 2 > data_end)
+        return;
+      memcpy (r->prefix, p, size);
+      p += size;
+      r->entry_count = ntohs (*(uint16_t *)p);
+      p += 2;
+
+      for (i = 0; i < r->entry_count && p + 8 <= data_end; i++)
+        {
+          r->peer_bits |= 1ULL << (ntohs (*(uint16_t *)p) % 64);
+          p += 8 + ntohs (*(uint16_t *)(p + 6));
+        }
+    }
+
+  index_nrecords++;
+}
+
+void
+index_file_end ()
+{
+  struct index_header header;
+  uint64_t source_size;
+  int64_t source_mtime;
+  char path[1024];
+  FILE *fp;
+
+  if (! index_source)
+    return;
+
+  if (get_file_stat (index_source, &source_size, &source_mtime) < 0)
+    {
+      fprintf (stderr, "index: can't stat %s: %s\n",
+               index_source, strerror (errno));
+      index_source = NULL;
+      return;
+    }
+
+  if (get_file_format (index_source) == FORMAT_GZIP &&
+      index_gzip_build (index_source) < 0)
+    index_ncheckpoints = 0;
+
+  snprintf (path, sizeof (path), "%s.idx", index_source);
+  fp = fopen (path, "w");
+  if (! fp)
+    {
+      fprintf (stderr, "index: can't open %s: %s\n", path, strerror (errno));
+      index_source = NULL;
+      return;
+    }
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, INDEX_MAGIC, sizeof (header.magic));
+  header.version = INDEX_VERSION;
+  header.byte_order = INDEX_BYTE_ORDER;
+  header.source_size = source_size;
+  header.source_mtime = source_mtime;
+  header.nrecords = index_nrecords;
+  header.ncheckpoints = index_ncheckpoints;
+
+  if (fwrite (&header, sizeof (header), 1, fp) != 1 ||
+      fwrite (index_records, sizeof (struct index_record),
+              index_nrecords, fp) != index_nrecords ||
+      fwrite (index_checkpoints, sizeof (struct index_checkpoint),
+              index_ncheckpoints, fp) != index_ncheckpoints)
+    fprintf (stderr, "index: write failed: %s: %s\n",
+             path, strerror (errno));
+  fclose (fp);
+
+  if (verbose)
+    printf ("index: %s: %'llu records, %'llu checkpoints.\n", path,
+            (unsigned long long) index_nrecords,
+            (unsigned long long) index_ncheckpoints);
+
+  free (index_checkpoints);
+  index_checkpoints = NULL;
+  index_ncheckpoints = 0;
+  index_source = NULL;
+}
+
+static int
+index_load (char *path)
+{
+  struct index_header header;
+  uint64_t source_size;
+  int64_t source_mtime;
+  char ipath[1024];
+  off_t size;
+  FILE *fp;
+
+  snprintf (ipath, sizeof (ipath), "%s.idx", path);
+  fp = fopen (ipath, "r");
+  if (! fp)
+    return -1;
+
+  if (fread (&header, sizeof (header), 1, fp) != 1 ||
+      memcmp (header.magic, INDEX_MAGIC, sizeof (header.magic)) ||
+      header.version != INDEX_VERSION ||
+      header.byte_order != INDEX_BYTE_ORDER)
+    {
+      fprintf (stderr, "index: not an index: %s\n", ipath);
+      fclose (fp);
+      return -1;
+    }
+
+  if (get_file_stat (path, &source_size, &source_mtime) < 0 ||
+      header.source_size != source_size ||
+      header.source_mtime != source_mtime)
+    {
+      fprintf (stderr, "index: stale index: %s\n", ipath);
+      fclose (fp);
+      return -1;
+    }
+
+  /* the counts are bound by the size of the index, before they are
+     allocated. */
+  if (fseeko (fp, 0, SEEK_END) < 0 || (size = ftello (fp)) < 0 ||
+      fseeko (fp, sizeof (header), SEEK_SET) < 0)
+    {
+      fprintf (stderr, "index: can't seek %s: %s\n", ipath, strerror (errno));
+      fclose (fp);
+      return -1;
+    }
+  size -= sizeof (header);
+  if (header.nrecords > size / sizeof (struct index_record) ||
+      header.ncheckpoints > size / sizeof (struct index_checkpoint) ||
+      header.nrecords * sizeof (struct index_record) +
+      header.ncheckpoints * sizeof (struct index_checkpoint) != size)
+    {
+      fprintf (stderr, "index: malformed index: %s\n", ipath);
+      fclose (fp);
+      return -1;
+    }
+
+  index_nrecords = header.nrecords;
+  index_ncheckpoints = header.ncheckpoints;
+  index_records = realloc (index_records, (index_nrecords + 1) *
+                           sizeof (struct index_record));
+  index_checkpoints = malloc ((index_ncheckpoints + 1) *
+                              sizeof (struct index_checkpoint));
+  assert (index_records && index_checkpoints);
+  index_limit = index_nrecords + 1;
+
+  if (fread (index_records, sizeof (struct index_record),
+             index_nrecords, fp) != index_nrecords ||
+      fread (index_checkpoints, sizeof (struct index_checkpoint),
+             index_ncheckpoints, fp) != index_ncheckpoints)
+    {
+      fprintf (stderr, "index: truncated index: %s\n", ipath);
+      fclose (fp);
+      return -1;
+    }
+
+  fclose (fp);
+  return 0;
+}
+
+/* the reader of the records in the uncompressed data. */
+struct index_reader
+{
+  file_format_t format;
+  struct access_method *method;
+  char *path;
+  void *file;               /* by the access method. */
+  FILE *fp;                 /* the raw file, or the gzip file. */
+  z_stream zs;
+  int raw;                  /* inflating from a checkpoint. */
+  int trailer;              /* the bytes of the gzip trailer to skip. */
+  uint8_t *input;
+  uint64_t pos;
+};
+
+static struct index_reader reader;
+
+static int
+index_reader_open (char *path, struct access_method *method)
+{
+  struct index_reader *r = &reader;
+
+  memset (r, 0, sizeof (struct index_reader));
+  r->path = path;
+  r->method = method;
+  r->format = get_file_format (path);
+  if (r->format == FORMAT_GZIP && ! index_ncheckpoints)
+    r->format = FORMAT_UNKNOWN;
+
+  switch (r->format)
+    {
+    case FORMAT_RAW:
+      r->fp = fopen (path, "r");
+      return (r->fp ? 0 : -1);
+
+    case FORMAT_GZIP:
+      r->fp = fopen (path, "r");
+      if (! r->fp)
+        return -1;
+      r->input = malloc (INDEX_CHUNK);
+      assert (r->input);
+      if (inflateInit2 (&r->zs, 15 + 32) != Z_OK)
+        return -1;
+      return 0;
+
+    default:
+      r->file = method->fopen (path, "r");
+      return (r->file ? 0 : -1);
+    }
+}
+
+static void
+index_reader_close ()
+{
+  struct index_reader *r = &reader;
+
+  if (r->fp)
+    fclose (r->fp);
+  if (r->file)
+    r->method->fclose (r->file);
+  if (r->input)
+    {
+      inflateEnd (&r->zs);
+      free (r->input);
+    }
+  memset (r, 0, sizeof (struct index_reader));
+}
+
+/* start inflating at the checkpoint, or at the beginning. */
+static int
+index_gzip_start (struct index_checkpoint *cp)
+{
+  struct index_reader *r = &reader;
+  int c;
+
+  r->zs.avail_in = 0;
+  r->trailer = 0;
+  if (! cp)
+    {
+      fseeko (r->fp, 0, SEEK_SET);
+      inflateReset2 (&r->zs, 15 + 32);
+      r->raw = 0;
+      r->pos = 0;
+      return 0;
+    }
+
+  fseeko (r->fp, cp->in - (cp->bits ? 1 : 0), SEEK_SET);
+  inflateReset2 (&r->zs, -15);
+  if (cp->bits)
+    {
+      c = getc (r->fp);
+      if (c == EOF)
+        return -1;
+      inflatePrime (&r->zs, cp->bits, c >> (8 - cp->bits));
+    }
+  inflateSetDictionary (&r->zs, cp->window, INDEX_WINDOW_SIZE);
+  r->raw = 1;
+  r->pos = cp->out;
+  return 0;
+}
+
+static size_t
+index_gzip_read (char *buf, size_t len)
+{
+  struct index_reader *r = &reader;
+  size_t n;
+  int ret;
+
+  r->zs.next_out = (Bytef *) buf;
+  r->zs.avail_out = len;
+  while (r->zs.avail_out)
+    {
+      if (r->zs.avail_in == 0)
+        {
+          r->zs.avail_in = fread (r->input, 1, INDEX_CHUNK, r->fp);
+          r->zs.next_in = r->input;
+          if (r->zs.avail_in == 0)
+            break;
+        }
+
+      if (r->trailer)
+        {
+          n = MIN (r->trailer, r->zs.avail_in);
+          r->zs.next_in += n;
+          r->zs.avail_in -= n;
+          r->trailer -= n;
+          continue;
+        }
+
+      ret = inflate (&r->zs, Z_NO_FLUSH);
+      if (ret == Z_STREAM_END)
+        {
+          /* the raw deflate data is followed by the gzip trailer,
+             and then by the next gzip member if any. */
+          if (r->raw)
+            r->trailer = 8;
+          inflateReset2 (&r->zs, 15 + 32);
+          r->raw = 0;
+          continue;
+        }
+      if (ret != Z_OK && ret != Z_BUF_ERROR)
+        break;
+    }
+
+  n = len - r->zs.avail_out;
+  r->pos += n;
+  return n;
+}
+
+static size_t
+index_reader_fill (char *buf, size_t len)
+{
+  struct index_reader *r = &reader;
+  size_t ret, done = 0;
+
+  while (done < len)
+    {
+      if (r->format == FORMAT_RAW)
+        ret = fread (buf + done, 1, len - done, r->fp);
+      else if (r->format == FORMAT_GZIP)
+        ret = index_gzip_read (buf + done, len - done);
+      else
+        ret = r->method->fread (buf + done, len - done, 1, r->file);
+      if (ret == 0 || ret == (size_t) -1)
+        break;
+      done += ret;
+    }
+  if (r->format != FORMAT_GZIP)
+    r->pos += done;
+  return done;
+}
+
+static struct index_checkpoint *
+index_checkpoint_find (uint64_t offset)
+{
+  uint64_t lo = 0, hi = index_ncheckpoints, mid;
+
+  /* the last checkpoint at or before the offset. */
+  while (lo < hi)
+    {
+      mid = (lo + hi) / 2;
+      if (index_checkpoints[mid].out <= offset)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  return (lo ? &index_checkpoints[lo - 1] : NULL);
+}
+
+/* read the record at the offset. the offsets are mostly increasing,
+   so the compressed data is decompressed forward from where it is. */
+static int
+index_reader_read (uint64_t offset, char *buf, size_t len)
+{
+  struct index_reader *r = &reader;
+  struct index_checkpoint *cp;
+  size_t skip;
+
+  switch (r->format)
+    {
+    case FORMAT_RAW:
+      if (fseeko (r->fp, offset, SEEK_SET) < 0)
+        return -1;
+      r->pos = offset;
+      break;
+
+    case FORMAT_GZIP:
+      cp = index_checkpoint_find (offset);
+      if (offset < r->pos || (cp && cp->out > r->pos))
+        if (index_gzip_start (cp) < 0)
+          return -1;
+      break;
+
+    default:
+      if (offset < r->pos)
+        {
+          r->method->fclose (r->file);
+          r->file = r->method->fopen (r->path, "r");
+          if (! r->file)
+            return -1;
+          r->pos = 0;
+        }
+      break;
+    }
+
+  /* skip to the offset through the buffer. */
+  while (r->pos < offset)
+    {
+      skip = MIN (offset - r->pos, len);
+      if (index_reader_fill (buf, skip) != skip)
+        return -1;
+    }
+
+  if (index_reader_fill (buf, len) != len)
+    return -1;
+  return 0;
+}
+
+/* the ranges of the lookup addresses (or prefixes), sorted by the
+   low end, if only the lookup uses the routes. the high end is made
+   the maximum so far, so that a binary search finds the overlap. */
+static uint8_t (*index_query)[2][16] = NULL;
+static uint64_t index_query_size = 0;
+static int index_query_af = 0;
+static int index_query_loaded = 0;
+static uint64_t index_spec_bits = 0;
+
+static int
+index_query_cmp (const void *a, const void *b)
+{
+  return memcmp (a, b, 16);
+}
+
+/* the range of the addresses in the prefix. */
+static void
+index_range (int af, uint8_t *prefix, int plen, uint8_t *lo, uint8_t *hi)
+{
+  int i;
+
+  memset (lo, 0, 16);
+  memset (hi, 0, 16);
+  for (i = 0; i < (af == AF_INET6 ? 16 : 4); i++)
+    {
+      int bits = plen - i * 8;
+      uint8_t mask = (bits >= 8 ? 0xff : bits <= 0 ? 0 :
+                      (uint8_t) (0xff << (8 - bits)));
+      lo[i] = prefix[i] & mask;
+      hi[i] = lo[i] | ~mask;
+    }
+}
+
+static void
+index_query_add (char *addr)
+{
+  uint8_t prefix[16];
+  int plen;
+
+  memset (prefix, 0, sizeof (prefix));
+  if (query_parse (index_query_af, addr, (char *) prefix, &plen) < 0)
+    return;
+  if (plen < 0)
+    plen = (index_query_af == AF_INET6 ? 128 : 32);
+
+  index_query = realloc (index_query, (index_query_size + 1) * 32);
+  assert (index_query);
+  index_range (index_query_af, prefix, plen,
+               index_query[index_query_size][0],
+               index_query[index_query_size][1]);
+  index_query_size++;
+}
+
+static void
+index_query_load ()
+{
+  struct in6_addr tmp;
+  char *p, buf[64];
+  FILE *fp;
+  uint64_t i;
+
+  index_query_loaded++;
+
+  if (! lookup || sink_size != 1 ||
+      (sink_list[0] != &sink_table && sink_list[0] != &sink_join))
+    return;
+
+  /* the same address family as the lookup. */
+  index_query_af = qafi;
+  if (! index_query_af && lookup_addr)
+    {
+      snprintf (buf, sizeof (buf), "%s", lookup_addr);
+      p = index (buf, '/');
+      if (p)
+        *p = '\0';
+      index_query_af = (inet_pton (AF_INET6, buf, &tmp) == 1 ?
+                        AF_INET6 : AF_INET);
+    }
+  if (! index_query_af)
+    index_query_af = AF_INET;
+
+  if (lookup_addr)
+    index_query_add (lookup_addr);
+  if (lookup_file && (fp = fopen (lookup_file, "r")) != NULL)
+    {
+      while (fgets (buf, sizeof (buf), fp))
+        {
+          p = index (buf, '\n');
+          if (p)
+            *p = '\0';
+          index_query_add (buf);
+        }
+      fclose (fp);
+    }
+
+  qsort (index_query, index_query_size, 32, index_query_cmp);
+  for (i = 1; i < index_query_size; i++)
+    if (memcmp (index_query[i][1], index_query[i - 1][1], 16) < 0)
+      memcpy (index_query[i][1], index_query[i - 1][1], 16);
+}
+
+/* whether any lookup address (or prefix) overlaps the prefix. */
+static int
+index_query_match (int af, uint8_t *prefix, int plen)
+{
+  uint8_t lo[16], hi[16];
+  uint64_t low = 0, high = index_query_size, mid;
+
+  if (af != index_query_af)
+    return 0;
+
+  index_range (af, prefix, plen, lo, hi);
+
+  /* the first range that begins after the prefix. */
+  while (low < high)
+    {
+      mid = (low + high) / 2;
+      if (memcmp (index_query[mid][0], hi, 16) <= 0)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+  return (low > 0 && memcmp (index_query[low - 1][1], lo, 16) >= 0);
+}
+
+/* the same selection as bgpdump_process_table_v2_rib_unicast()
+   and the rib entries would make, on the record. */
+static int
+index_select (struct index_record *r)
+{
+  int af;
+
+  if (r->subtype == BGPDUMP_TABLE_V2_PEER_INDEX_TABLE)
+    return 1;
+  if (! sink_rib)
+    return 0;
+
+  af = (r->subtype == BGPDUMP_TABLE_V2_RIB_IPV6_UNICAST ?
+        AF_INET6 : AF_INET);
+  if (qafi && qafi != af)
+    return 0;
+  if (peer_spec_size && ! (r->peer_bits & index_spec_bits))
+    return 0;
+  if (sample_rate && ! sample_record (af, (char *) r->prefix,
+                                      r->prefix_length))
+    return 0;
+  if (filter && filter_record (af, (char *) r->prefix, r->prefix_length)
+                == FILTER_FALSE)
+    return 0;
+  if (index_query_af && ! index_query_match (af, r->prefix,
+                                             r->prefix_length))
+    return 0;
+  return 1;
+}
+
+/* process the records selected by the index (-I). returns -1 if the
+   file has no index to use, to read the whole file instead, and
+   INDEX_FAILED if the reading failed in the middle of the file. */
+int
+index_process (char *path, struct access_method *method,
+               char *buf, size_t size)
+{
+  struct index_record *r;
+  uint64_t i, nselected = 0;
+  size_t datalen;
+  int j, ret = 0;
+
+  if (index_load (path) < 0)
+    return -1;
+  if (index_reader_open (path, method) < 0)
+    {
+      fprintf (stderr, "index: can't open %s\n", path);
+      index_reader_close ();
+      return -1;
+    }
+  if (! index_query_loaded)
+    index_query_load ();
+
+  for (i = 0; i < index_nrecords && ! file_done; i++)
+    {
+      r = &index_records[i];
+      if (! index_select (r))
+        continue;
+
+      if (r->length > size)
+        {
+          fprintf (stderr, "index: record too large: %'u bytes "
+                   "(see -N): %s\n", r->length, path);
+          continue;
+        }
+      if (index_reader_read (r->offset, buf, r->length) < 0)
+        {
+          fprintf (stderr, "index: read failed at %'llu: %s\n",
+                   (unsigned long long) r->offset, path);
+          ret = INDEX_FAILED;
+          break;
+        }
+
+      processed_bytes = r->offset;
+      datalen = r->length;
+      bgpdump_process (buf, &datalen);
+      nselected++;
+
+      /* the peers specified by -a are known after the peer table. */
+      if (r->subtype == BGPDUMP_TABLE_V2_PEER_INDEX_TABLE)
+        {
+          index_spec_bits = 0;
+          for (j = 0; j < peer_spec_size; j++)
+            index_spec_bits |= 1ULL << (peer_spec_index[j] % 64);
+        }
+    }
+
+  if (verbose)
+    printf ("index: %s: read %'llu of %'llu records.\n", path,
+            (unsigned long long) nselected,
+            (unsigned long long) index_nrecords);
+
+  index_reader_close ();
+  free (index_checkpoints);
+  index_checkpoints = NULL;
+  index_ncheckpoints = 0;
+  return ret;
+}
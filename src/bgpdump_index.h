@@ -0,0 +1,89 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BGPDUMP_INDEX_H_
+#define _BGPDUMP_INDEX_H_
+
+/* The sidecar index (<file>.idx, built by -X) lists the MRT records
+   of a file with their offsets in the uncompressed data, so that a
+   later run with -I reads only the records that it needs: those of
+   the prefixes that the filter (-f), the sample (-s), the address
+   family (-4, -6), the peer spec (-p), and the lookup addresses (-l,
+   -L, when only looked up) can select. The PEER_INDEX_TABLE records
+   are always read.
+
+   For a gzip file, the index also keeps the inflate checkpoints (the
+   bit position in the compressed data and the 32KiB window), one at
+   a deflate block boundary every INDEX_SPAN bytes of the output, so
+   that a record is reached by inflating at most INDEX_SPAN bytes.
+   The other compressed files are decompressed up to the records, but
+   still without the parsing. All the numbers are in the host byte
+   order (byte_order in the header tells it). */
+
+#define INDEX_MAGIC "BGPDIDX1"
+#define INDEX_VERSION 1
+#define INDEX_BYTE_ORDER 0x01020304
+#define INDEX_SPAN (4 * 1024 * 1024)
+#define INDEX_WINDOW_SIZE 32768
+
+#define INDEX_FAILED -2
+
+struct index_header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t source_size;     /* the size and the mtime of the file, */
+  int64_t source_mtime;     /* to detect a stale index. */
+  uint64_t nrecords;
+  uint64_t ncheckpoints;
+};
+
+struct index_record
+{
+  uint64_t offset;          /* of the MRT header. */
+  uint32_t length;          /* including the MRT header. */
+  uint32_t sequence_number;
+  uint16_t subtype;
+  uint16_t entry_count;
+  uint8_t prefix_length;
+  uint8_t reserved[3];
+  uint8_t prefix[16];
+  uint64_t peer_bits;       /* bit (peer_index % 64) for each entry. */
+};
+
+struct index_checkpoint
+{
+  uint64_t out;             /* the offset in the uncompressed data. */
+  uint64_t in;              /* the offset in the compressed file. */
+  uint32_t bits;            /* the bits of the byte before in. */
+  uint32_t reserved;
+  uint8_t window[INDEX_WINDOW_SIZE];
+};
+
+struct mrt_header;
+struct access_method;
+
+void index_file_start (char *path);
+void index_message (struct mrt_header *h, char *data_end);
+void index_file_end ();
+
+int index_process (char *path, struct access_method *method,
+                   char *buf, size_t size);
+
+#endif /*_BGPDUMP_INDEX_H_*/
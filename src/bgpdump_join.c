@@ -0,0 +1,394 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <assert.h>
+
+#include "benchmark.h"
+
+#include "bgpdump.h"
+#include "bgpdump_option.h"
+#include "bgpdump_route.h"
+#include "bgpdump_peer.h"
+#include "bgpdump_query.h"
+#include "bgpdump_ptree.h"
+#include "bgpdump_join.h"
+
+/* the merge state of each specified peer. */
+struct join_slot
+{
+  struct join_entry *stack;
+  int depth;
+  int stack_limit;
+  char *attr;                 /* the attributes of the stacked entries. */
+  uint64_t attr_size;
+  uint64_t attr_limit;
+  uint64_t pos;               /* the next query to answer, in the order. */
+  char last[MAX_ADDR_LENGTH]; /* the last prefix merged. */
+  int last_length;
+  int32_t *answer;            /* the view for each query, or -1. */
+};
+
+static struct join_slot *join_slot = NULL;
+static uint64_t *join_order = NULL;   /* the queries sorted by address. */
+static int join_af = 0;
+static int join_addrlen = 0;
+
+/* the answers: the views of the matched routes, with their
+   attributes in the arena, saved once for each route. */
+static struct route_view *join_views = NULL;
+static uint64_t join_view_size = 0;
+static uint64_t join_view_limit = 0;
+static char *join_arena = NULL;
+static uint64_t join_arena_size = 0;
+static uint64_t join_arena_limit = 0;
+
+static uint64_t join_unordered = 0;
+
+/* the decoded answers, for the queries to the same route. */
+#define JOIN_DECODE_CACHE 4096
+static struct bgp_route *join_decoded = NULL;
+static int64_t *join_decoded_view = NULL;
+
+static int
+join_cmp (const void *a, const void *b)
+{
+  const uint64_t *x = a, *y = b;
+  int ret;
+
+  ret = memcmp (query_table[*x].destination, query_table[*y].destination,
+                join_addrlen);
+  if (ret)
+    return ret;
+  return (*x < *y ? -1 : *x > *y);
+}
+
+#define JOIN_QUERY(pos) (query_table[join_order[pos]].destination)
+
+static void
+join_grow (char **buf, uint64_t *limit, uint64_t size)
+{
+  if (size <= *limit)
+    return;
+  *limit = (*limit ? *limit : 4096);
+  while (size > *limit)
+    *limit *= 2;
+  *buf = realloc (*buf, *limit);
+  assert (*buf);
+}
+
+void
+join_init ()
+{
+  uint64_t i;
+  int j, af;
+
+  /* the query afi is not to select the routes of the other sinks
+     while reading (e.g., -m), as in the table. */
+  af = qafi;
+  query_load ();
+  join_af = qafi;
+  qafi = af;
+  if (query_prefix_any ())
+    {
+      printf ("the lookup join (-J) looks up the addresses, "
+              "not the prefixes (-Y).\n");
+      exit (-1);
+    }
+  join_addrlen = (join_af == AF_INET ? 4 : 16);
+
+  if (benchmark)
+    benchmark_start ();
+
+  join_order = malloc ((query_size + 1) * sizeof (uint64_t));
+  assert (join_order);
+  for (i = 0; i < query_size; i++)
+    join_order[i] = i;
+  qsort (join_order, query_size, sizeof (uint64_t), join_cmp);
+
+  join_slot = malloc ((peer_spec_size + 1) * sizeof (struct join_slot));
+  assert (join_slot);
+  memset (join_slot, 0, (peer_spec_size + 1) * sizeof (struct join_slot));
+  for (j = 0; j < peer_spec_size; j++)
+    {
+      join_slot[j].answer = malloc ((query_size + 1) * sizeof (int32_t));
+      assert (join_slot[j].answer);
+      for (i = 0; i < query_size; i++)
+        join_slot[j].answer[i] = -1;
+      join_slot[j].last_length = -1;
+    }
+}
+
+/* save the route as an answer, once. */
+static int64_t
+join_view (int peer_index, char *prefix, int prefix_length,
+           char *attr, uint32_t attr_length)
+{
+  struct route_view *view;
+
+  if (join_view_size == join_view_limit)
+    {
+      join_view_limit = (join_view_limit ? join_view_limit * 2 : 1024);
+      join_views = realloc (join_views,
+                            join_view_limit * sizeof (struct route_view));
+      assert (join_views);
+    }
+
+  join_grow (&join_arena, &join_arena_limit, join_arena_size + attr_length);
+  memcpy (join_arena + join_arena_size, attr, attr_length);
+
+  view = &join_views[join_view_size];
+  memset (view, 0, sizeof (struct route_view));
+  memcpy (view->prefix, prefix, MAX_ADDR_LENGTH);
+  view->af = join_af;
+  view->prefix_length = prefix_length;
+  view->peer_index = peer_index;
+  view->attr_length = attr_length;
+  view->attr_offset = join_arena_size;
+  join_arena_size += attr_length;
+
+  return join_view_size++;
+}
+
+/* the longer match wins, and the later one for the same length
+   (as the later file replaces the route in the table). */
+static void
+join_answer (struct join_slot *s, uint64_t pos, int peer_index,
+             struct join_entry *e, char *attr)
+{
+  int32_t *answer = &s->answer[join_order[pos]];
+
+  if (*answer >= 0 &&
+      join_views[*answer].prefix_length > e->prefix_length)
+    return;
+  if (e->view < 0)
+    e->view = join_view (peer_index, e->prefix, e->prefix_length,
+                         attr, e->attr_length);
+  *answer = e->view;
+}
+
+/* answer the queries before the address (to the end if NULL)
+   by the stack. */
+static void
+join_advance (struct join_slot *s, int peer_index, char *addr)
+{
+  struct join_entry *top;
+  char *query;
+
+  while (s->pos < query_size)
+    {
+      query = JOIN_QUERY (s->pos);
+      if (addr && memcmp (query, addr, join_addrlen) >= 0)
+        break;
+
+      /* the prefixes ending before the query cover no more queries. */
+      while (s->depth &&
+             memcmp (s->stack[s->depth - 1].end, query, join_addrlen) < 0)
+        {
+          s->depth--;
+          s->attr_size = s->stack[s->depth].attr_offset;
+        }
+
+      if (s->depth)
+        {
+          top = &s->stack[s->depth - 1];
+          join_answer (s, s->pos, peer_index, top,
+                       s->attr + top->attr_offset);
+        }
+      s->pos++;
+    }
+}
+
+static uint64_t
+join_lower_bound (char *addr)
+{
+  uint64_t lo = 0, hi = query_size, mid;
+
+  while (lo < hi)
+    {
+      mid = lo + (hi - lo) / 2;
+      if (memcmp (JOIN_QUERY (mid), addr, join_addrlen) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  return lo;
+}
+
+void
+join_route (int peer_index, int slot, struct bgp_route *route,
+            char *attr, int attr_length)
+{
+  struct join_slot *s;
+  struct join_entry e, *top;
+  uint64_t pos;
+  int i, cmp;
+
+  if (slot < 0 || route->af != join_af)
+    return;
+  s = &join_slot[slot];
+
+  memset (&e, 0, sizeof (e));
+  memcpy (e.prefix, route->prefix, MAX_ADDR_LENGTH);
+  memcpy (e.end, route->prefix, MAX_ADDR_LENGTH);
+  e.prefix_length = route->prefix_length;
+  for (i = route->prefix_length; i < join_addrlen * 8; i++)
+    e.end[i / 8] |= (0x80 >> (i % 8));
+  e.attr_length = attr_length;
+  e.view = -1;
+
+  /* out of the order of the prefixes: answer by the binary search
+     over the sorted queries in the prefix. */
+  cmp = memcmp (e.prefix, s->last, join_addrlen);
+  if (s->last_length >= 0 &&
+      (cmp < 0 || (cmp == 0 && e.prefix_length <= s->last_length)))
+    {
+      join_unordered++;
+      for (pos = join_lower_bound (e.prefix);
+           pos < query_size &&
+           memcmp (JOIN_QUERY (pos), e.end, join_addrlen) <= 0; pos++)
+        join_answer (s, pos, peer_index, &e, attr);
+      return;
+    }
+  memcpy (s->last, e.prefix, MAX_ADDR_LENGTH);
+  s->last_length = e.prefix_length;
+
+  join_advance (s, peer_index, e.prefix);
+
+  /* the stack keeps only the prefixes covering this one. */
+  while (s->depth &&
+         memcmp (s->stack[s->depth - 1].end, e.prefix, join_addrlen) < 0)
+    {
+      s->depth--;
+      s->attr_size = s->stack[s->depth].attr_offset;
+    }
+
+  if (s->depth == s->stack_limit)
+    {
+      s->stack_limit = (s->stack_limit ? s->stack_limit * 2 : 64);
+      s->stack = realloc (s->stack,
+                          s->stack_limit * sizeof (struct join_entry));
+      assert (s->stack);
+    }
+  join_grow (&s->attr, &s->attr_limit, s->attr_size + attr_length);
+  memcpy (s->attr + s->attr_size, attr, attr_length);
+  e.attr_offset = s->attr_size;
+  s->attr_size += attr_length;
+
+  top = &s->stack[s->depth++];
+  memcpy (top, &e, sizeof (e));
+}
+
+/* the next file starts over from the first query. */
+void
+join_file_end ()
+{
+  struct join_slot *s;
+  int j;
+
+  for (j = 0; j < peer_spec_size; j++)
+    {
+      s = &join_slot[j];
+      join_advance (s, peer_spec_index[j], NULL);
+      s->depth = 0;
+      s->attr_size = 0;
+      s->pos = 0;
+      s->last_length = -1;
+    }
+}
+
+static struct bgp_route *
+join_decode (int64_t view)
+{
+  int index = view % JOIN_DECODE_CACHE;
+
+  if (join_decoded_view[index] != view)
+    {
+      route_decode (&join_decoded[index], &join_views[view], join_arena);
+      join_decoded_view[index] = view;
+    }
+  return &join_decoded[index];
+}
+
+void
+join_finish ()
+{
+  struct join_slot *s;
+  uint64_t i;
+  int j;
+
+  join_decoded = malloc (JOIN_DECODE_CACHE * sizeof (struct bgp_route));
+  join_decoded_view = malloc (JOIN_DECODE_CACHE * sizeof (int64_t));
+  assert (join_decoded && join_decoded_view);
+  for (i = 0; i < JOIN_DECODE_CACHE; i++)
+    join_decoded_view[i] = -1;
+
+  qafi = join_af;
+  query_print ();
+  if (! peer_spec_size)
+    printf ("warning: no peer spec. lookup needs a specified peer.\n");
+  for (j = 0; j < peer_spec_size; j++)
+    {
+      s = &join_slot[j];
+      printf ("peer %d:\n", peer_spec_index[j]);
+      for (i = 0; i < query_size; i++)
+        {
+          ptree_query_answer_route (peer_spec_index[j], &query_table[i],
+                                    (s->answer[i] < 0 ? NULL :
+                                     join_decode (s->answer[i])));
+        }
+      free (s->answer);
+      free (s->stack);
+      free (s->attr);
+    }
+
+  if (benchmark)
+    {
+      benchmark_stop ();
+      benchmark_print (query_size);
+    }
+
+  if (verbose)
+    printf ("join: %'llu queries, %'llu answers saved (%'lluB), "
+            "%'llu entries out of the order.\n",
+            (unsigned long long) query_size,
+            (unsigned long long) join_view_size,
+            (unsigned long long) join_arena_size,
+            (unsigned long long) join_unordered);
+
+  free (join_decoded);
+  free (join_decoded_view);
+  free (join_slot);
+  free (join_order);
+  free (join_views);
+  free (join_arena);
+  free (query_table);
+  join_slot = NULL;
+  join_order = NULL;
+  join_views = NULL;
+  join_arena = NULL;
+  join_decoded = NULL;
+  join_decoded_view = NULL;
+}
@@ -0,0 +1,48 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BGPDUMP_JOIN_H_
+#define _BGPDUMP_JOIN_H_
+
+/* The lookup join (-J) answers the lookups (-l, -L) without the route
+   tables: the queries are sorted, and merged with the rib entries in
+   the order of the prefixes (as in the TABLE_DUMP_V2 records), with
+   only the stack of the prefixes covering the current position. The
+   memory is for the queries and the depth of the nesting, instead of
+   for the routes.
+
+   The entries out of the order (e.g., the second file) are still
+   answered correctly, by a binary search over the sorted queries. */
+
+struct join_entry
+{
+  char prefix[MAX_ADDR_LENGTH];
+  char end[MAX_ADDR_LENGTH];  /* the last address in the prefix. */
+  uint8_t prefix_length;
+  uint64_t attr_offset;       /* in the stack buffer of the slot. */
+  uint32_t attr_length;
+  int64_t view;               /* the saved answer, or -1. */
+};
+
+void join_init ();
+void join_route (int peer_index, int slot, struct bgp_route *route,
+                 char *attr, int attr_length);
+void join_file_end ();
+void join_finish ();
+
+#endif /*_BGPDUMP_JOIN_H_*/
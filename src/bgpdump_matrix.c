@@ -0,0 +1,307 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <assert.h>
+
+#include "bgpdump.h"
+#include "bgpdump_option.h"
+#include "bgpdump_route.h"
+#include "bgpdump_peer.h"
+#include "bgpdump_sample.h"
+#include "bgpdump_matrix.h"
+
+struct matrix_entry
+{
+  int id;
+  uint64_t path_hash;
+  char nexthop[MAX_ADDR_LENGTH];
+};
+
+/* the as-path (with the AS_SET) of the entry, by the peer. The hash
+   only buckets the paths, and the paths of the same hash are
+   compared by these. */
+struct matrix_path
+{
+  uint8_t path_size;
+  uint8_t set_size;
+  uint32_t path_list[ROUTE_PATH_LIMIT];
+  uint32_t set_list[ROUTE_SET_LIMIT];
+};
+
+/* the peers are the slots of the peer spec, or the peer indexes. */
+static int matrix_size = 0;
+
+/* by the pair (a, b), a < b, at [a * matrix_size + b]. */
+static uint64_t *matrix_shared;       /* in the sparse records. */
+static uint64_t *matrix_absent;       /* in the dense records. */
+static uint64_t *matrix_same_nexthop;
+static uint64_t *matrix_same_path;
+
+/* by the peer. */
+static uint64_t *matrix_routes;
+static uint64_t *matrix_absent_count; /* in the dense records. */
+static uint8_t *matrix_present;
+static int *matrix_list;
+static struct matrix_path *matrix_path;
+
+static uint64_t matrix_records = 0;
+static uint64_t matrix_dense = 0;
+
+/* the entries of the current record. */
+static struct matrix_entry *matrix_entry;
+static int matrix_entry_size = 0;
+
+#define MATRIX_PAIR(a, b) \
+  ((a) < (b) ? (a) * matrix_size + (b) : (b) * matrix_size + (a))
+
+static void
+matrix_init ()
+{
+  size_t pairs;
+
+  matrix_size = (peer_spec_size ? peer_spec_size : peer_size);
+  if (! matrix_size)
+    return;
+
+  pairs = (size_t) matrix_size * matrix_size;
+  matrix_shared = calloc (pairs, sizeof (uint64_t));
+  matrix_absent = calloc (pairs, sizeof (uint64_t));
+  matrix_same_nexthop = calloc (pairs, sizeof (uint64_t));
+  matrix_same_path = calloc (pairs, sizeof (uint64_t));
+  matrix_routes = calloc (matrix_size, sizeof (uint64_t));
+  matrix_absent_count = calloc (matrix_size, sizeof (uint64_t));
+  matrix_present = calloc (matrix_size, sizeof (uint8_t));
+  matrix_list = calloc (matrix_size, sizeof (int));
+  matrix_entry = calloc (matrix_size, sizeof (struct matrix_entry));
+  matrix_path = calloc (matrix_size, sizeof (struct matrix_path));
+  assert (matrix_shared && matrix_absent && matrix_same_nexthop &&
+          matrix_same_path && matrix_routes && matrix_absent_count &&
+          matrix_present && matrix_list && matrix_entry && matrix_path);
+}
+
+static void
+matrix_free ()
+{
+  free (matrix_shared);
+  free (matrix_absent);
+  free (matrix_same_nexthop);
+  free (matrix_same_path);
+  free (matrix_routes);
+  free (matrix_absent_count);
+  free (matrix_present);
+  free (matrix_list);
+  free (matrix_entry);
+  free (matrix_path);
+  matrix_size = 0;
+  matrix_records = matrix_dense = 0;
+  matrix_entry_size = 0;
+}
+
+/* FNV-1a over the as-path and the AS_SET. */
+static uint64_t
+matrix_path_hash (struct matrix_path *path)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  int i;
+
+  hash = (hash ^ path->path_size) * 0x100000001b3ULL;
+  for (i = 0; i < path->path_size; i++)
+    hash = (hash ^ path->path_list[i]) * 0x100000001b3ULL;
+  hash = (hash ^ path->set_size) * 0x100000001b3ULL;
+  for (i = 0; i < path->set_size; i++)
+    hash = (hash ^ path->set_list[i]) * 0x100000001b3ULL;
+  return hash;
+}
+
+void
+matrix_route (int peer_index, int slot, struct bgp_route *route,
+              char *attr, int attr_length)
+{
+  struct matrix_entry *e;
+  struct matrix_path *path;
+  int id;
+
+  if (! matrix_size)
+    matrix_init ();
+
+  id = (peer_spec_size ? slot : peer_index);
+  if (id < 0 || id >= matrix_size || matrix_present[id])
+    return;
+
+  matrix_present[id] = 1;
+  path = &matrix_path[id];
+  path->path_size = MIN (route->path_size, ROUTE_PATH_LIMIT);
+  path->set_size = MIN (route->set_size, ROUTE_SET_LIMIT);
+  memcpy (path->path_list, route->path_list,
+          path->path_size * sizeof (uint32_t));
+  memcpy (path->set_list, route->set_list,
+          path->set_size * sizeof (uint32_t));
+
+  e = &matrix_entry[matrix_entry_size++];
+  e->id = id;
+  e->path_hash = matrix_path_hash (path);
+  memcpy (e->nexthop, route->nexthop, MAX_ADDR_LENGTH);
+}
+
+static int
+matrix_nexthop_cmp (const void *a, const void *b)
+{
+  const struct matrix_entry *ea = a, *eb = b;
+  return memcmp (ea->nexthop, eb->nexthop, MAX_ADDR_LENGTH);
+}
+
+static int
+matrix_path_cmp (const void *a, const void *b)
+{
+  const struct matrix_entry *ea = a, *eb = b;
+  struct matrix_path *pa, *pb;
+  int ret;
+
+  if (ea->path_hash != eb->path_hash)
+    return (ea->path_hash < eb->path_hash ? -1 : 1);
+
+  pa = &matrix_path[ea->id];
+  pb = &matrix_path[eb->id];
+  if (pa->path_size != pb->path_size)
+    return (pa->path_size < pb->path_size ? -1 : 1);
+  if (pa->set_size != pb->set_size)
+    return (pa->set_size < pb->set_size ? -1 : 1);
+  ret = memcmp (pa->path_list, pb->path_list,
+                pa->path_size * sizeof (uint32_t));
+  if (ret)
+    return ret;
+  return memcmp (pa->set_list, pb->set_list,
+                 pa->set_size * sizeof (uint32_t));
+}
+
+/* count the pairs in each group of the same entries. */
+static void
+matrix_same (uint64_t *matrix, int (*cmp) (const void *, const void *))
+{
+  int i, j, start;
+
+  qsort (matrix_entry, matrix_entry_size, sizeof (struct matrix_entry), cmp);
+  for (start = 0; start < matrix_entry_size; start = i)
+    {
+      for (i = start + 1; i < matrix_entry_size &&
+           ! (*cmp) (&matrix_entry[start], &matrix_entry[i]); i++)
+        ;
+      for (j = start; j < i; j++)
+        {
+          int k;
+          for (k = j + 1; k < i; k++)
+            matrix[MATRIX_PAIR (matrix_entry[j].id, matrix_entry[k].id)]++;
+        }
+    }
+}
+
+void
+matrix_record_end (uint32_t sequence_number)
+{
+  int i, j, n = matrix_entry_size;
+
+  if (! n)
+    return;
+
+  matrix_records++;
+  for (i = 0; i < n; i++)
+    matrix_routes[matrix_entry[i].id]++;
+
+  if (2 * n <= matrix_size)
+    {
+      for (i = 0; i < n; i++)
+        for (j = i + 1; j < n; j++)
+          matrix_shared[MATRIX_PAIR (matrix_entry[i].id,
+                                     matrix_entry[j].id)]++;
+    }
+  else
+    {
+      int nabsent = 0;
+
+      matrix_dense++;
+      for (i = 0; i < matrix_size; i++)
+        if (! matrix_present[i])
+          {
+            matrix_list[nabsent++] = i;
+            matrix_absent_count[i]++;
+          }
+      for (i = 0; i < nabsent; i++)
+        for (j = i + 1; j < nabsent; j++)
+          matrix_absent[MATRIX_PAIR (matrix_list[i], matrix_list[j])]++;
+    }
+
+  matrix_same (matrix_same_nexthop, matrix_nexthop_cmp);
+  matrix_same (matrix_same_path, matrix_path_cmp);
+
+  for (i = 0; i < n; i++)
+    matrix_present[matrix_entry[i].id] = 0;
+  matrix_entry_size = 0;
+}
+
+static int
+matrix_peer (int id)
+{
+  return (peer_spec_size ? peer_spec_index[id] : id);
+}
+
+void
+matrix_file_end ()
+{
+  uint64_t shared;
+  int a, b, p;
+
+  if (! matrix_size)
+    return;
+
+  printf ("#peer1,peer2,shared,only1,only2,nexthop-diff,path-diff\n");
+  for (a = 0; a < matrix_size; a++)
+    for (b = a + 1; b < matrix_size; b++)
+      {
+        if (! matrix_routes[a] && ! matrix_routes[b])
+          continue;
+        p = a * matrix_size + b;
+        shared = matrix_shared[p] + matrix_dense - matrix_absent_count[a] -
+                 matrix_absent_count[b] + matrix_absent[p];
+        printf ("%d,%d,%llu,%llu,%llu,%llu,%llu\n",
+                matrix_peer (a), matrix_peer (b),
+                (unsigned long long) sample_estimate (shared),
+                (unsigned long long)
+                sample_estimate (matrix_routes[a] - shared),
+                (unsigned long long)
+                sample_estimate (matrix_routes[b] - shared),
+                (unsigned long long)
+                sample_estimate (shared - matrix_same_nexthop[p]),
+                (unsigned long long)
+                sample_estimate (shared - matrix_same_path[p]));
+      }
+  if (verbose)
+    printf ("peer-matrix: %'llu prefixes, %d peers, %'llu dense.\n",
+            (unsigned long long) matrix_records, matrix_size,
+            (unsigned long long) matrix_dense);
+  fflush (stdout);
+
+  matrix_free ();
+}
@@ -0,0 +1,40 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BGPDUMP_MATRIX_H_
+#define _BGPDUMP_MATRIX_H_
+
+/* The peer matrix (-T) compares every pair of the peers (-p, or all)
+   in one pass over the file: the prefixes shared by the pair, only in
+   each of them, and the shared ones with the different nexthops or
+   as-paths. A TABLE_DUMP_V2 record has all the entries of a prefix,
+   so that each record updates the matrix from its entry list.
+
+   A record with most of the peers is counted by the pairs of the
+   absent peers instead (shared = records - absent(a) - absent(b) +
+   absent(a, b)), and the same nexthops (as-paths) by the groups of
+   the sorted entries, so that a record costs little more than the
+   sort of its entries for the full-table peers. The as-paths are
+   compared by their hash. */
+
+void matrix_route (int peer_index, int slot, struct bgp_route *route,
+                   char *attr, int attr_length);
+void matrix_record_end (uint32_t sequence_number);
+void matrix_file_end ();
+
+#endif /*_BGPDUMP_MATRIX_H_*/
@@ -0,0 +1,260 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <assert.h>
+
+#include <zlib.h>
+
+#include "bgpdump.h"
+#include "bgpdump_file.h"
+#include "bgpdump_data.h"
+#include "bgpdump_route.h"
+#include "bgpdump_peer.h"
+#include "bgpdump_mrt.h"
+
+/* the size of the peer_index, the originated_time, and
+   the attribute_length in front of the attributes. */
+#define MRT_RIB_ENTRY_HEADER_SIZE 8
+
+static gzFile mrt_gz = NULL;
+static char *mrt_path = NULL;
+
+/* the new peer index for each peer, or -1 if not written. */
+static int *mrt_peer_map = NULL;
+static int mrt_peer_map_size = 0;
+
+/* the rib record in progress. */
+static char *mrt_buf = NULL;
+static size_t mrt_len = 0;
+static size_t mrt_size = 0;
+static size_t mrt_count_offset = 0;
+static uint16_t mrt_entry_count = 0;
+static int mrt_af = AF_INET;
+static uint32_t mrt_sequence = 0;
+
+static void
+mrt_reserve (size_t len)
+{
+  if (mrt_len + len <= mrt_size)
+    return;
+  mrt_size = (mrt_size ? mrt_size : 4096);
+  while (mrt_len + len > mrt_size)
+    mrt_size *= 2;
+  mrt_buf = realloc (mrt_buf, mrt_size);
+  assert (mrt_buf);
+}
+
+static void
+mrt_append (const void *data, size_t len)
+{
+  mrt_reserve (len);
+  memcpy (mrt_buf + mrt_len, data, len);
+  mrt_len += len;
+}
+
+static void
+mrt_write (uint16_t subtype)
+{
+  struct mrt_header *h = (struct mrt_header *) mrt_buf;
+
+  h->timestamp = htonl (timestamp);
+  h->type = htons (BGPDUMP_TYPE_TABLE_DUMP_V2);
+  h->subtype = htons (subtype);
+  h->length = htonl (mrt_len - sizeof (struct mrt_header));
+
+  if (gzwrite (mrt_gz, mrt_buf, mrt_len) != (int) mrt_len)
+    {
+      fprintf (stderr, "mrt: write failed: %s\n", mrt_path);
+      exit (-1);
+    }
+  mrt_len = 0;
+}
+
+int
+mrt_open (char *path)
+{
+  /* "T" writes without the compression. Only gzip is written, so
+     the other compressed names are rejected rather than written raw. */
+  switch (get_file_format (path))
+    {
+    case FORMAT_GZIP:
+      mrt_gz = gzopen (path, "wb1");
+      break;
+    case FORMAT_RAW:
+      mrt_gz = gzopen (path, "wbT");
+      break;
+    default:
+      fprintf (stderr, "mrt: unsupported compression: %s "
+               "(only .gz is written)\n", path);
+      return -1;
+    }
+  if (! mrt_gz)
+    {
+      fprintf (stderr, "mrt: can't open %s: %s\n", path, strerror (errno));
+      return -1;
+    }
+  mrt_path = path;
+  return 0;
+}
+
+static int
+mrt_peer_entry_size (uint8_t peer_type)
+{
+  return 1 + 4 + (peer_type & 0x01 ? 16 : 4) + (peer_type & 0x02 ? 4 : 2);
+}
+
+/* called after the PEER_INDEX_TABLE is processed, so that the peers
+   specified by their AS numbers (-a) are already registered. */
+void
+mrt_peer_index_table (struct mrt_header *h, char *data_end)
+{
+  char *p, *start;
+  uint16_t view_name_length, peer_count, count, val;
+  size_t count_offset;
+  int i, size;
+
+  if (! mrt_gz)
+    return;
+
+  start = p = (char *) h + sizeof (struct mrt_header);
+  if (p + 6 > data_end)
+    return;
+  view_name_length = ntohs (*(uint16_t *) (p + 4));
+  p += 6 + view_name_length;
+  if (p + 2 > data_end)
+    return;
+  peer_count = ntohs (*(uint16_t *) p);
+
+  if (peer_count > mrt_peer_map_size)
+    {
+      mrt_peer_map = realloc (mrt_peer_map, peer_count * sizeof (int));
+      assert (mrt_peer_map);
+      mrt_peer_map_size = peer_count;
+    }
+
+  /* the collector bgp id and the view name are kept as is. */
+  mrt_len = 0;
+  mrt_reserve (sizeof (struct mrt_header));
+  mrt_len = sizeof (struct mrt_header);
+  mrt_append (start, p - start);
+  count_offset = mrt_len;
+  mrt_append (&peer_count, sizeof (peer_count));
+  p += 2;
+
+  count = 0;
+  for (i = 0; i < peer_count && p < data_end; i++)
+    {
+      size = mrt_peer_entry_size (*(uint8_t *) p);
+      if (p + size > data_end)
+        break;
+      if (! peer_spec_size || PEER_SPEC_MATCH (i))
+        {
+          mrt_peer_map[i] = count++;
+          mrt_append (p, size);
+        }
+      else
+        mrt_peer_map[i] = -1;
+      p += size;
+    }
+  for (; i < mrt_peer_map_size; i++)
+    mrt_peer_map[i] = -1;
+
+  val = htons (count);
+  memcpy (mrt_buf + count_offset, &val, sizeof (val));
+  mrt_write (BGPDUMP_TABLE_V2_PEER_INDEX_TABLE);
+
+  mrt_sequence = 0;
+}
+
+/* attr points to the attributes in the raw rib entry. */
+void
+mrt_entry (int peer_index, struct bgp_route *route,
+           char *attr, int attr_length)
+{
+  uint32_t val;
+  uint16_t index;
+  int size;
+
+  if (peer_index >= mrt_peer_map_size || mrt_peer_map[peer_index] < 0)
+    return;
+
+  /* the record header: sequence_number, prefix, and entry_count. */
+  if (! mrt_entry_count)
+    {
+      mrt_len = 0;
+      mrt_reserve (sizeof (struct mrt_header));
+      mrt_len = sizeof (struct mrt_header);
+      val = htonl (mrt_sequence);
+      mrt_append (&val, sizeof (val));
+      mrt_append (&route->prefix_length, 1);
+      size = (route->prefix_length + 7) / 8;
+      mrt_append (route->prefix, size);
+      mrt_count_offset = mrt_len;
+      mrt_append (&mrt_entry_count, sizeof (mrt_entry_count));
+    }
+
+  index = htons (mrt_peer_map[peer_index]);
+  mrt_append (&index, sizeof (index));
+  mrt_append (attr - MRT_RIB_ENTRY_HEADER_SIZE + sizeof (index),
+              MRT_RIB_ENTRY_HEADER_SIZE - sizeof (index) + attr_length);
+  mrt_entry_count++;
+  mrt_af = route->af;
+}
+
+/* write the record if any of its entries is selected. */
+void
+mrt_record_end ()
+{
+  uint16_t val;
+
+  if (! mrt_entry_count)
+    return;
+
+  val = htons (mrt_entry_count);
+  memcpy (mrt_buf + mrt_count_offset, &val, sizeof (val));
+  mrt_write (mrt_af == AF_INET6 ? BGPDUMP_TABLE_V2_RIB_IPV6_UNICAST :
+                                  BGPDUMP_TABLE_V2_RIB_IPV4_UNICAST);
+  mrt_entry_count = 0;
+  mrt_sequence++;
+}
+
+void
+mrt_close ()
+{
+  if (! mrt_gz)
+    return;
+  if (gzclose (mrt_gz) != Z_OK)
+    fprintf (stderr, "mrt: close failed: %s\n", mrt_path);
+  mrt_gz = NULL;
+
+  free (mrt_buf);
+  mrt_buf = NULL;
+  mrt_len = mrt_size = 0;
+  free (mrt_peer_map);
+  mrt_peer_map = NULL;
+  mrt_peer_map_size = 0;
+}
@@ -0,0 +1,37 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BGPDUMP_MRT_H_
+#define _BGPDUMP_MRT_H_
+
+/* The MRT writer (-W) writes the selected routes as a TABLE_DUMP_V2
+   file, which bgpdump2 itself (and the other MRT readers) can read.
+   The PEER_INDEX_TABLE is rewritten to contain only the specified
+   peers (-p, -a), renumbered in their original order. The selected
+   rib entries are copied in their raw bytes, except the peer index,
+   and the entry count, the record length, and the sequence number
+   are fixed up for each RIB record. No attribute is decoded. */
+
+int mrt_open (char *path);
+void mrt_peer_index_table (struct mrt_header *h, char *data_end);
+void mrt_entry (int peer_index, struct bgp_route *route,
+                char *attr, int attr_length);
+void mrt_record_end ();
+void mrt_close ();
+
+#endif /*_BGPDUMP_MRT_H_*/
@@ -0,0 +1,228 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <assert.h>
+
+#include "bgpdump_obuf.h"
+
+static __thread struct obuf obuf_thread;
+
+static const char obuf_digits[] = "0123456789abcdef";
+
+/* the stdout to a file or a pipe is written in large chunks.
+   (the terminal stays line-buffered, and the stream of the output
+   stage has no fd and its own buffer.) */
+void
+obuf_setup ()
+{
+  if (fileno (stdout) >= 0 && ! isatty (fileno (stdout)))
+    setvbuf (stdout, NULL, _IOFBF, OBUF_STDIO_SIZE);
+}
+
+struct obuf *
+obuf_get ()
+{
+  struct obuf *ob = &obuf_thread;
+  if (! ob->buf)
+    {
+      ob->buf = malloc (OBUF_SIZE_DEFAULT);
+      assert (ob->buf);
+      ob->p = ob->buf;
+      ob->end = ob->buf + OBUF_SIZE_DEFAULT;
+    }
+  return ob;
+}
+
+void
+obuf_grow (struct obuf *ob, size_t len)
+{
+  size_t used = OBUF_LEN (ob);
+  size_t size = ob->end - ob->buf;
+
+  while (used + len > size)
+    size *= 2;
+  ob->buf = realloc (ob->buf, size);
+  assert (ob->buf);
+  ob->p = ob->buf + used;
+  ob->end = ob->buf + size;
+}
+
+void
+obuf_write (struct obuf *ob, FILE *fp)
+{
+  if (OBUF_LEN (ob))
+    fwrite (ob->buf, 1, OBUF_LEN (ob), fp);
+  ob->p = ob->buf;
+}
+
+void
+obuf_mem (struct obuf *ob, const char *s, size_t len)
+{
+  OBUF_RESERVE (ob, len);
+  memcpy (ob->p, s, len);
+  ob->p += len;
+}
+
+void
+obuf_str (struct obuf *ob, const char *s)
+{
+  obuf_mem (ob, s, strlen (s));
+}
+
+void
+obuf_u64 (struct obuf *ob, uint64_t val)
+{
+  char tmp[20];
+  char *t = tmp + sizeof (tmp);
+
+  do
+    {
+      *--t = '0' + val % 10;
+      val /= 10;
+    }
+  while (val);
+  obuf_mem (ob, t, tmp + sizeof (tmp) - t);
+}
+
+void
+obuf_u32 (struct obuf *ob, uint32_t val)
+{
+  char tmp[10];
+  char *t = tmp + sizeof (tmp);
+
+  do
+    {
+      *--t = '0' + val % 10;
+      val /= 10;
+    }
+  while (val);
+  obuf_mem (ob, t, tmp + sizeof (tmp) - t);
+}
+
+void
+obuf_int (struct obuf *ob, int val)
+{
+  if (val < 0)
+    {
+      OBUF_CHAR (ob, '-');
+      obuf_u32 (ob, - (uint32_t) val);
+    }
+  else
+    obuf_u32 (ob, val);
+}
+
+/* as "%08x". */
+void
+obuf_hex32 (struct obuf *ob, uint32_t val)
+{
+  int i;
+  OBUF_RESERVE (ob, 8);
+  for (i = 7; i >= 0; i--)
+    *ob->p++ = obuf_digits[(val >> (i * 4)) & 0xf];
+}
+
+void
+obuf_ipv4 (struct obuf *ob, const void *addr)
+{
+  const uint8_t *a = addr;
+  int i;
+
+  OBUF_RESERVE (ob, 15);
+  for (i = 0; i < 4; i++)
+    {
+      if (i)
+        *ob->p++ = '.';
+      if (a[i] >= 100)
+        *ob->p++ = '0' + a[i] / 100;
+      if (a[i] >= 10)
+        *ob->p++ = '0' + (a[i] / 10) % 10;
+      *ob->p++ = '0' + a[i] % 10;
+    }
+}
+
+/* the same text as inet_ntop(): the first longest run of two or
+   more zero words is "::", and the IPv4-compatible and the IPv4-
+   mapped addresses end with the dotted quad. */
+void
+obuf_ipv6 (struct obuf *ob, const void *addr)
+{
+  const uint8_t *a = addr;
+  uint16_t words[8];
+  int best = -1, best_len = 0;
+  int cur = -1, cur_len = 0;
+  int i, j;
+
+  for (i = 0; i < 8; i++)
+    {
+      words[i] = (a[i * 2] << 8) | a[i * 2 + 1];
+      if (words[i] == 0)
+        {
+          if (cur < 0)
+            cur = i, cur_len = 0;
+          cur_len++;
+          if (cur_len > best_len)
+            best = cur, best_len = cur_len;
+        }
+      else
+        cur = -1;
+    }
+  if (best_len < 2)
+    best = -1;
+
+  OBUF_RESERVE (ob, 46);
+  for (i = 0; i < 8; i++)
+    {
+      if (best >= 0 && i >= best && i < best + best_len)
+        {
+          if (i == best)
+            *ob->p++ = ':';
+          continue;
+        }
+      if (i)
+        *ob->p++ = ':';
+      if (i == 6 && best == 0 &&
+          (best_len == 6 || (best_len == 5 && words[5] == 0xffff)))
+        {
+          obuf_ipv4 (ob, &a[12]);
+          return;
+        }
+      for (j = 12; j > 0 && ! (words[i] >> j); j -= 4)
+        ;
+      for (; j >= 0; j -= 4)
+        *ob->p++ = obuf_digits[(words[i] >> j) & 0xf];
+    }
+  if (best >= 0 && best + best_len == 8)
+    *ob->p++ = ':';
+}
+
+void
+obuf_addr (struct obuf *ob, int af, const void *addr)
+{
+  if (af == AF_INET6)
+    obuf_ipv6 (ob, addr);
+  else
+    obuf_ipv4 (ob, addr);
+}
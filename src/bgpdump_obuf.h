@@ -0,0 +1,69 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BGPDUMP_OBUF_H_
+#define _BGPDUMP_OBUF_H_
+
+/* The output buffer formats a line (e.g., a route) with the hand-
+   written formatters instead of the printf family and inet_ntop(),
+   and passes it to the FILE with one fwrite(). The stdout is given
+   a large stdio buffer (obuf_setup()), so that the lines go out in
+   bulk write()s while keeping the order with the other stdio outputs.
+   Each thread has its own buffer (obuf_get()). */
+
+#define OBUF_SIZE_DEFAULT (64 * 1024)
+#define OBUF_STDIO_SIZE (1024 * 1024)
+
+struct obuf
+{
+  char *buf;
+  char *p;
+  char *end;
+};
+
+/* make sure that len bytes can be appended. */
+#define OBUF_RESERVE(ob, len) \
+  do { \
+    if ((ob)->p + (len) > (ob)->end) \
+      obuf_grow ((ob), (len)); \
+  } while (0)
+
+#define OBUF_CHAR(ob, c) \
+  do { \
+    OBUF_RESERVE ((ob), 1); \
+    *(ob)->p++ = (c); \
+  } while (0)
+
+#define OBUF_LEN(ob) ((size_t) ((ob)->p - (ob)->buf))
+
+void obuf_setup ();
+struct obuf *obuf_get ();
+void obuf_grow (struct obuf *ob, size_t len);
+void obuf_write (struct obuf *ob, FILE *fp);
+
+void obuf_str (struct obuf *ob, const char *s);
+void obuf_mem (struct obuf *ob, const char *s, size_t len);
+void obuf_u32 (struct obuf *ob, uint32_t val);
+void obuf_u64 (struct obuf *ob, uint64_t val);
+void obuf_int (struct obuf *ob, int val);
+void obuf_hex32 (struct obuf *ob, uint32_t val);
+void obuf_ipv4 (struct obuf *ob, const void *addr);
+void obuf_ipv6 (struct obuf *ob, const void *addr);
+void obuf_addr (struct obuf *ob, int af, const void *addr);
+
+#endif /*_BGPDUMP_OBUF_H_*/
@@ -18,6 +18,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <assert.h>
 #include <getopt.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -28,6 +29,11 @@
 #include "bgpdump_option.h"
 #include "bgpdump_peer.h"
 #include "bgpdump_route.h"
+#include "bgpdump_query.h"
+#include "bgpdump_aspath_regex.h"
+#include "bgpdump_sample.h"
+#include "bgpdump_output.h"
+#include "bgpdump_extract.h"
 
 extern char *optarg;
 extern int optind;
@@ -35,7 +41,7 @@ extern int optopt;
 extern int opterr;
 extern int optreset;
 
-const char *optstring = "hVvdmbxyPp:a:uUrcCjkN:M:gl:L:46H:";
+const char *optstring = "hVvdmbxyPp:a:uUrcCjkN:M:gl:L:46H:f:R:zs:o:Z:E:F:W:XIS:O:q:K:JQ:Y:DT";
 const struct option longopts[] =
 {
   { "help",         no_argument,       NULL, 'h' },
@@ -64,6 +70,26 @@ const struct option longopts[] =
   { "ipv4",         no_argument,       NULL, '4' },
   { "ipv6",         no_argument,       NULL, '6' },
   { "heatmap",      required_argument, NULL, 'H' },
+  { "filter",       required_argument, NULL, 'f' },
+  { "aspath-regex", required_argument, NULL, 'R' },
+  { "lazy",         no_argument,       NULL, 'z' },
+  { "sample",       required_argument, NULL, 's' },
+  { "output",       required_argument, NULL, 'o' },
+  { "compress",     required_argument, NULL, 'Z' },
+  { "export",       required_argument, NULL, 'E' },
+  { "extract-fds",  required_argument, NULL, 'F' },
+  { "write-mrt",    required_argument, NULL, 'W' },
+  { "index-build",  no_argument,       NULL, 'X' },
+  { "index",        no_argument,       NULL, 'I' },
+  { "save",         required_argument, NULL, 'S' },
+  { "load",         required_argument, NULL, 'O' },
+  { "serve",        required_argument, NULL, 'q' },
+  { "lookup-cache", required_argument, NULL, 'K' },
+  { "join",         no_argument,       NULL, 'J' },
+  { "publish",      required_argument, NULL, 'Q' },
+  { "prefix-match", required_argument, NULL, 'Y' },
+  { "diff-files",   no_argument,       NULL, 'D' },
+  { "peer-matrix",  no_argument,       NULL, 'T' },
   { NULL,           0,                 NULL, 0   }
 };
 
@@ -78,10 +104,11 @@ const char opthelp[] = "\
 -y, --unified             Display imaginary unified route table from all peers.\n\
 -P, --peer-table          Display the peer table and exit.\n\
 -p, --peer <peer_index>   Specify peers by peer_index.\n\
-                          At most %d peers can be specified.\n\
 -u, --diff                Shows unified diff. Specify two peers.\n\
 -U, --diff-verbose        Shows the detailed info of unified diff.\n\
--r, --diff-table          Specify to create diff route_table.\n\
+-r, --diff-table          Classify the diff by the reachability: only\n\
+                          the covering (same or shorter) routes in the\n\
+                          other peer count, not the more-specifics.\n\
 -c, --count               Count the route number.\n\
 -C, --count-peers         Count the route number per peer.\n\
 -j, --plen-dist           Count the route number by prefixlen.\n\
@@ -96,6 +123,62 @@ const char opthelp[] = "\
 -4, --ipv4                Specify that the query is IPv4. (default)\n\
 -6, --ipv6                Specify that the query is IPv6.\n\
 -H, --heatmap <file-prefix> Produces the heatmap.\n\
+-f, --filter <expr>       Select the routes by the filter expression.\n\
+                          e.g., \"prefix 10.0.0.0/8 le 24 and peer 1\"\n\
+                          predicates: prefix <prefix> [exact|longer|\n\
+                          orlonger|ge <n>|le <n>], peer <index>,\n\
+                          peer-as <asn>, origin-as <asn>,\n\
+                          path-contains <asn>, path-len [<op>] <n>,\n\
+                          nexthop <addr>, community <a:b|a:b:c>,\n\
+                          aspath-regex \"<regex>\",\n\
+                          combined with and, or, not, and ().\n\
+-R, --aspath-regex <regex> Select the routes by the AS-path regex.\n\
+                          e.g., \"^2914 .* 3356$\", \"_[64512-65534]_\"\n\
+                          Can be specified multiple times (or'ed).\n\
+-z, --lazy                Keep the raw attributes of the stored routes,\n\
+                          and decode them only when looked up.\n\
+-s, --sample <rate>       Process only the prefixes sampled by the hash\n\
+                          (e.g., 0.05 or 1/16), and show the estimated\n\
+                          counts with the 95%% error bounds (-c, -C, -j, -k).\n\
+-o, --output <file>       Write the output to the file (.gz and .zst are\n\
+                          compressed), from a writer thread.\n\
+-Z, --compress <method>   Compress the output by gzip or zstd.\n\
+                          With -x, compress the extracted files instead.\n\
+-E, --export <file>       Export the routes to the file in the columnar\n\
+                          binary format (see bgpdump_columnar.h).\n\
+-F, --extract-fds <n>     Keep at most n files open in -x (reopened in\n\
+                          append mode). (default: by the fd limit)\n\
+-W, --write-mrt <file>    Write the selected routes (-p, -a, -f, -R, -4,\n\
+                          -6) to the file in MRT (.gz is compressed;\n\
+                          .bz2 and .zst are not supported).\n\
+-X, --index-build         Build the index of the records in <file>.idx.\n\
+-I, --index               Read only the records selected by <file>.idx\n\
+                          (by -f, -s, -p, -4, -6, and -l, -L).\n\
+-S, --save <file>         Save the route tables of the peers (-p) to the\n\
+                          savefile (implies -z).\n\
+-O, --load <file>         Look up (-l, -L) on the savefile, instead of\n\
+                          reading the rib files.\n\
+-q, --serve <socket>      Serve the lookups of the peers (-p) over the\n\
+                          Unix socket, or the stdin/stdout for \"-\"\n\
+                          (see bgpdump_server.h for the protocol).\n\
+-K, --lookup-cache <n>    Cache the lookups (-l, -L, -q) by the /24 (/48)\n\
+                          blocks in n entries (e.g., 64k).\n\
+-J, --join                Look up (-l, -L) by merging the sorted queries\n\
+                          with the rib, without the route tables.\n\
+-Q, --publish </name>     Publish the route tables of the peers (-p) to\n\
+                          the POSIX shared memory, for the readers by\n\
+                          -O shm:</name> (see bgpdump_ribshm.h).\n\
+-Y, --prefix-match <match> Look up (-l, -L) the prefixes by the match:\n\
+                          exact, longer, orlonger, shorter, orshorter,\n\
+                          optionally with ge <n>, le <n>.\n\
+                          e.g., \"orlonger le 24\" (default: exact\n\
+                          for the <addr>/<plen>, longest for the <addr>)\n\
+-D, --diff-files          Shows the diff of the routes of the peers (-p,\n\
+                          of the first file) between two rib files, by\n\
+                          merging them in the order of the prefixes.\n\
+-T, --peer-matrix         Compare all the pairs of the peers (-p, or all)\n\
+                          in one pass: the shared prefixes, only in each,\n\
+                          and with the different nexthops or as-paths.\n\
 ";
 
 int longindex;
@@ -124,18 +207,38 @@ char *lookup_addr = NULL;
 char *lookup_file = NULL;
 int heatmap = 0;
 char *heatmap_prefix;
+int filter = 0;
+char *filter_expr = NULL;
+char *aspath_regex_arg[ASPATH_REGEX_MAX];
+int aspath_regex_argc = 0;
+int lazy = 0;
+char *output_file = NULL;
+int output_compress = -1;
+char *export_file = NULL;
+char *mrt_file = NULL;
+int index_build = 0;
+int index_use = 0;
+char *save_file = NULL;
+char *load_file = NULL;
+char *serve_path = NULL;
+unsigned long long lookup_cache = 0;
+int lookup_join = 0;
+char *publish_name = NULL;
+int diff_files = 0;
+int peer_matrix = 0;
 
 extern char *progname;
 extern int qafi;
 
-extern unsigned long autnums[];
+extern unsigned long *autnums;
 extern int autsiz;
+extern int autlim;
 
 void
 usage ()
 {
   printf ("Usage: %s [options] <file1> <file2> ...\n", progname);
-  printf (opthelp, PEER_INDEX_MAX, BGPDUMP_BUFSIZ_DEFAULT,
+  printf (opthelp, BGPDUMP_BUFSIZ_DEFAULT,
           ROUTE_LIMIT_DEFAULT);
 }
 
@@ -201,8 +304,11 @@ bgpdump_getopt (int argc, char **argv)
               printf ("malformed peer_index: %s\n", optarg);
               exit (-1);
             }
-          peer_spec_index[peer_spec_size % PEER_INDEX_MAX] = val;
-          peer_spec_size++;
+          if (peer_spec_add (val) < 0)
+            {
+              printf ("peer_index out of range: %s\n", optarg);
+              exit (-1);
+            }
           break;
         case 'a':
           val = strtoul (optarg, &endptr, 0);
@@ -211,8 +317,13 @@ bgpdump_getopt (int argc, char **argv)
               printf ("malformed autnum: %s\n", optarg);
               exit (-1);
             }
-          autnums[autsiz % AUTLIM] = val;
-          autsiz++;
+          if (autsiz >= autlim)
+            {
+              autlim = (autlim ? autlim * 2 : AUTLIM);
+              autnums = realloc (autnums, autlim * sizeof (unsigned long));
+              assert (autnums);
+            }
+          autnums[autsiz++] = val;
           break;
 
         case 'u':
@@ -255,6 +366,9 @@ bgpdump_getopt (int argc, char **argv)
             }
           break;
 
+        case 'g':
+          benchmark++;
+          break;
         case 'l':
           lookup++;
           lookup_addr = optarg;
@@ -275,6 +389,103 @@ bgpdump_getopt (int argc, char **argv)
           heatmap_prefix = optarg;
           break;
 
+        case 'f':
+          filter++;
+          filter_expr = optarg;
+          break;
+
+        case 'R':
+          if (aspath_regex_argc >= ASPATH_REGEX_MAX)
+            {
+              printf ("too many aspath-regex (max: %d).\n",
+                      ASPATH_REGEX_MAX);
+              exit (-1);
+            }
+          filter++;
+          aspath_regex_arg[aspath_regex_argc++] = optarg;
+          break;
+
+        case 'z':
+          lazy++;
+          break;
+
+        case 'o':
+          output_file = optarg;
+          break;
+        case 'Z':
+          output_compress = output_compress_parse (optarg);
+          if (output_compress < 0)
+            {
+              printf ("unknown compression: %s\n", optarg);
+              exit (-1);
+            }
+          break;
+
+        case 'E':
+          export_file = optarg;
+          break;
+        case 'W':
+          mrt_file = optarg;
+          break;
+        case 'X':
+          index_build++;
+          break;
+        case 'I':
+          index_use++;
+          break;
+        case 'S':
+          save_file = optarg;
+          break;
+        case 'O':
+          load_file = optarg;
+          break;
+        case 'q':
+          serve_path = optarg;
+          break;
+        case 'Q':
+          publish_name = optarg;
+          break;
+        case 'J':
+          lookup_join++;
+          break;
+        case 'D':
+          diff_files++;
+          break;
+        case 'T':
+          peer_matrix++;
+          break;
+        case 'Y':
+          if (query_match_parse (optarg) < 0)
+            {
+              printf ("malformed prefix match: %s\n", optarg);
+              exit (-1);
+            }
+          break;
+        case 'K':
+          lookup_cache = resolv_number (optarg, &endptr);
+          if (*endptr != '\0' || lookup_cache == 0)
+            {
+              printf ("malformed lookup cache size: %s\n", optarg);
+              exit (-1);
+            }
+          break;
+        case 'F':
+          extract_fd_max = strtol (optarg, NULL, 0);
+          if (extract_fd_max <= 0)
+            {
+              printf ("invalid number of files: %s\n", optarg);
+              exit (-1);
+            }
+          break;
+
+        case 's':
+          if (sample_parse (optarg) < 0)
+            {
+              printf ("malformed sample rate: %s\n", optarg);
+              exit (-1);
+            }
+          break;
+
         case 0:
           /* Process flag pointer. */
           break;
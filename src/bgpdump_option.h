@@ -41,6 +41,25 @@ extern char *lookup_file;
 extern int peer_table_only;
 extern int heatmap;
 extern char *heatmap_prefix;
+extern int filter;
+extern char *filter_expr;
+extern char *aspath_regex_arg[];
+extern int aspath_regex_argc;
+extern int lazy;
+extern char *output_file;
+extern int output_compress;
+extern char *export_file;
+extern char *mrt_file;
+extern int index_build;
+extern int index_use;
+extern char *save_file;
+extern char *load_file;
+extern char *serve_path;
+extern unsigned long long lookup_cache;
+extern int lookup_join;
+extern char *publish_name;
+extern int diff_files;
+extern int peer_matrix;
 
 extern unsigned long long bufsiz;
 extern unsigned long long nroutes;
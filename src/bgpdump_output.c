@@ -0,0 +1,327 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include <zlib.h>
+#if defined (HAVE_LIBZSTD) && defined (HAVE_ZSTD_H)
+#define OUTPUT_ZSTD 1
+#include <zstd.h>
+#endif
+
+#include "bgpdump_output.h"
+
+struct output_batch
+{
+  char *buf;
+  size_t len;
+};
+
+/* the queue: only the producer (the parser) advances the head,
+   and only the consumer (the writer thread) advances the tail. */
+static struct output_batch output_queue[OUTPUT_QUEUE_SIZE];
+static unsigned int output_head = 0;
+static unsigned int output_tail = 0;
+static int output_done = 0;
+static pthread_mutex_t output_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t output_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t output_thread;
+
+static FILE *output_stdout = NULL;   /* the original stdout. */
+static FILE *output_fp = NULL;       /* the stream given as the stdout. */
+static int output_fd = -1;
+static int output_method = OUTPUT_COMPRESS_NONE;
+
+static gzFile output_gz = NULL;
+#ifdef OUTPUT_ZSTD
+static ZSTD_CStream *output_zstd = NULL;
+static char *output_zbuf = NULL;
+static size_t output_zbuf_size = 0;
+#endif
+
+int
+output_compress_parse (char *name)
+{
+  if (! strcmp (name, "none"))
+    return OUTPUT_COMPRESS_NONE;
+  if (! strcmp (name, "gzip") || ! strcmp (name, "gz"))
+    return OUTPUT_COMPRESS_GZIP;
+  if (! strcmp (name, "zstd") || ! strcmp (name, "zst"))
+    return OUTPUT_COMPRESS_ZSTD;
+  return -1;
+}
+
+static void
+output_write_fd (char *buf, size_t len)
+{
+  ssize_t ret;
+
+  while (len)
+    {
+      ret = write (output_fd, buf, len);
+      if (ret < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          fprintf (stderr, "output: write failed: %s\n", strerror (errno));
+          return;
+        }
+      buf += ret;
+      len -= ret;
+    }
+}
+
+static void
+output_write (char *buf, size_t len, int end)
+{
+  switch (output_method)
+    {
+    case OUTPUT_COMPRESS_GZIP:
+      if (len && gzwrite (output_gz, buf, len) == 0)
+        fprintf (stderr, "output: gzwrite failed.\n");
+      break;
+
+#ifdef OUTPUT_ZSTD
+    case OUTPUT_COMPRESS_ZSTD:
+      {
+        ZSTD_inBuffer in = { buf, len, 0 };
+        size_t remain;
+        do
+          {
+            ZSTD_outBuffer out = { output_zbuf, output_zbuf_size, 0 };
+            remain = ZSTD_compressStream2 (output_zstd, &out, &in,
+                                           (end ? ZSTD_e_end :
+                                                  ZSTD_e_continue));
+            if (ZSTD_isError (remain))
+              {
+                fprintf (stderr, "output: zstd: %s\n",
+                         ZSTD_getErrorName (remain));
+                return;
+              }
+            output_write_fd (output_zbuf, out.pos);
+          }
+        while (in.pos < in.size || (end && remain));
+      }
+      break;
+#endif
+
+    default:
+      output_write_fd (buf, len);
+      break;
+    }
+}
+
+static void *
+output_writer (void *arg)
+{
+  struct output_batch *batch;
+
+  while (1)
+    {
+      pthread_mutex_lock (&output_mutex);
+      while (output_head == output_tail && ! output_done)
+        pthread_cond_wait (&output_cond, &output_mutex);
+      if (output_head == output_tail && output_done)
+        {
+          pthread_mutex_unlock (&output_mutex);
+          break;
+        }
+      pthread_mutex_unlock (&output_mutex);
+
+      /* the batch at the tail is not touched by the producer
+         until the tail passes it. */
+      batch = &output_queue[output_tail % OUTPUT_QUEUE_SIZE];
+      output_write (batch->buf, batch->len, 0);
+
+      pthread_mutex_lock (&output_mutex);
+      output_tail++;
+      pthread_cond_signal (&output_cond);
+      pthread_mutex_unlock (&output_mutex);
+    }
+
+  output_write (NULL, 0, 1);
+  return NULL;
+}
+
+/* the write function of the stdout stream: the stdio buffer is
+   copied into the batch at the head, and queued. */
+static ssize_t
+output_cookie_write (void *cookie, const char *buf, size_t size)
+{
+  struct output_batch *batch;
+  size_t len, done = 0;
+
+  while (done < size)
+    {
+      pthread_mutex_lock (&output_mutex);
+      while (output_head - output_tail == OUTPUT_QUEUE_SIZE)
+        pthread_cond_wait (&output_cond, &output_mutex);
+      pthread_mutex_unlock (&output_mutex);
+
+      batch = &output_queue[output_head % OUTPUT_QUEUE_SIZE];
+      len = size - done;
+      if (len > OUTPUT_BATCH_SIZE)
+        len = OUTPUT_BATCH_SIZE;
+      memcpy (batch->buf, buf + done, len);
+      batch->len = len;
+      done += len;
+
+      pthread_mutex_lock (&output_mutex);
+      output_head++;
+      pthread_cond_signal (&output_cond);
+      pthread_mutex_unlock (&output_mutex);
+    }
+
+  return size;
+}
+
+/* in a child process (e.g., of the diff, -D), the writer thread is
+   not there: the child writes to the original stdout. the parent has
+   flushed the stdout before the fork. */
+void
+output_detach ()
+{
+  if (! output_fp)
+    return;
+  stdout = output_stdout;
+  output_fp = NULL;
+}
+
+static void
+output_atexit ()
+{
+  output_close ();
+}
+
+int
+output_open (char *path, int compress)
+{
+  cookie_io_functions_t funcs = { NULL, output_cookie_write, NULL, NULL };
+  int i;
+
+  output_method = compress;
+
+#ifndef OUTPUT_ZSTD
+  if (compress == OUTPUT_COMPRESS_ZSTD)
+    {
+      fprintf (stderr, "output: zstd is not supported in this build.\n");
+      return -1;
+    }
+#endif
+
+  if (path)
+    output_fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  else
+    output_fd = dup (fileno (stdout));
+  if (output_fd < 0)
+    {
+      fprintf (stderr, "output: can't open %s: %s\n",
+               (path ? path : "stdout"), strerror (errno));
+      return -1;
+    }
+
+  if (compress == OUTPUT_COMPRESS_GZIP)
+    {
+      /* gzip keeps its own fd, as gzclose() closes it. The fast
+         level, as the writer should keep up with the parser. */
+      output_gz = gzdopen (dup (output_fd), "wb1");
+      assert (output_gz);
+    }
+#ifdef OUTPUT_ZSTD
+  if (compress == OUTPUT_COMPRESS_ZSTD)
+    {
+      output_zstd = ZSTD_createCStream ();
+      assert (output_zstd);
+      output_zbuf_size = ZSTD_CStreamOutSize ();
+      output_zbuf = malloc (output_zbuf_size);
+      assert (output_zbuf);
+    }
+#endif
+
+  for (i = 0; i < OUTPUT_QUEUE_SIZE; i++)
+    {
+      output_queue[i].buf = malloc (OUTPUT_BATCH_SIZE);
+      assert (output_queue[i].buf);
+    }
+
+  output_fp = fopencookie (NULL, "w", funcs);
+  assert (output_fp);
+  setvbuf (output_fp, NULL, _IOFBF, OUTPUT_BATCH_SIZE);
+
+  if (pthread_create (&output_thread, NULL, output_writer, NULL))
+    {
+      fprintf (stderr, "output: can't create the writer thread.\n");
+      return -1;
+    }
+
+  fflush (stdout);
+  output_stdout = stdout;
+  stdout = output_fp;
+
+  /* the exit() in the middle also writes out the queue. */
+  atexit (output_atexit);
+  return 0;
+}
+
+void
+output_close ()
+{
+  int i;
+
+  if (! output_fp)
+    return;
+
+  fclose (output_fp);
+  output_fp = NULL;
+  stdout = output_stdout;
+
+  pthread_mutex_lock (&output_mutex);
+  output_done++;
+  pthread_cond_signal (&output_cond);
+  pthread_mutex_unlock (&output_mutex);
+  pthread_join (output_thread, NULL);
+
+  if (output_gz)
+    gzclose (output_gz);
+  output_gz = NULL;
+#ifdef OUTPUT_ZSTD
+  if (output_zstd)
+    ZSTD_freeCStream (output_zstd);
+  output_zstd = NULL;
+  free (output_zbuf);
+#endif
+  close (output_fd);
+  output_fd = -1;
+
+  for (i = 0; i < OUTPUT_QUEUE_SIZE; i++)
+    free (output_queue[i].buf);
+}
@@ -0,0 +1,44 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BGPDUMP_OUTPUT_H_
+#define _BGPDUMP_OUTPUT_H_
+
+/* The output stage replaces the stdout with a stream whose stdio
+   buffer is handed, when it fills, to a writer thread over a bounded
+   single-producer/single-consumer queue. The writer thread writes
+   the batches to the output file (-o) or the original stdout, and
+   compresses them on the way if asked (-Z, or .gz/.zst in -o).
+   All the outputs to the stdout keep their order. */
+
+#define OUTPUT_QUEUE_SIZE 8
+#define OUTPUT_BATCH_SIZE (1024 * 1024)
+
+typedef enum
+{
+  OUTPUT_COMPRESS_NONE,
+  OUTPUT_COMPRESS_GZIP,
+  OUTPUT_COMPRESS_ZSTD,
+} output_compress_t;
+
+int output_compress_parse (char *name);
+int output_open (char *path, int compress);
+void output_close ();
+void output_detach ();
+
+#endif /*_BGPDUMP_OUTPUT_H_*/
@@ -25,10 +25,14 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <assert.h>
+
+#include "ptree.h"
 
 #include "bgpdump_option.h"
 
 #include "bgpdump_route.h"
+#include "bgpdump_sample.h"
 #include "bgpdump_query.h"
 #include "bgpdump_ptree.h"
 
@@ -36,21 +40,150 @@
 #include "bgpdump_data.h"
 
 struct peer peer_null;
-struct peer peer_table[PEER_MAX];
+struct peer *peer_table = NULL;
+struct peer_count *peer_count = NULL;
+uint64_t *peer_plen_count = NULL;
 int peer_size = 0;
+int peer_limit = 0;
 
-int peer_spec_index[PEER_INDEX_MAX];
+int *peer_spec_index = NULL;
 int peer_spec_size = 0;
+int peer_spec_limit = 0;
+uint64_t peer_spec_bitmap[PEER_INDEX_LIMIT / 64];
+uint16_t peer_spec_slot[PEER_INDEX_LIMIT];
 
-struct bgp_route *peer_route_table[PEER_INDEX_MAX];
-int peer_route_size[PEER_INDEX_MAX];
-struct ptree *peer_ptree[PEER_INDEX_MAX];
+struct bgp_route **peer_route_table = NULL;
+struct route_view **peer_view_table = NULL;
+int *peer_route_size = NULL;
+struct ptree **peer_ptree = NULL;
 
 void
 peer_table_init ()
 {
   memset (&peer_null, 0, sizeof (struct peer));
-  memset (peer_table, 0, sizeof (peer_table));
+  peer_table = NULL;
+  peer_count = NULL;
+  peer_plen_count = NULL;
+  peer_size = peer_limit = 0;
+}
+
+/* peer_table_resize() makes the room for the peers of the Peer Count
+   in the PEER_INDEX_TABLE. The table never shrinks. */
+void
+peer_table_resize (int size)
+{
+  int old = peer_limit;
+
+  if (size <= peer_limit)
+    return;
+
+  peer_limit = size;
+  peer_table = realloc (peer_table, peer_limit * sizeof (struct peer));
+  peer_count = realloc (peer_count,
+                        peer_limit * sizeof (struct peer_count));
+  assert (peer_table && peer_count);
+  memset (&peer_table[old], 0, (peer_limit - old) * sizeof (struct peer));
+  memset (&peer_count[old], 0,
+          (peer_limit - old) * sizeof (struct peer_count));
+
+  if (plen_dist)
+    {
+      peer_plen_count = realloc (peer_plen_count, (size_t) peer_limit *
+                                 (PEER_PLEN_MAX + 1) * sizeof (uint64_t));
+      assert (peer_plen_count);
+      memset (PEER_PLEN_COUNT (old), 0, (size_t) (peer_limit - old) *
+              (PEER_PLEN_MAX + 1) * sizeof (uint64_t));
+    }
+}
+
+void
+peer_table_finish ()
+{
+  free (peer_table);
+  free (peer_count);
+  free (peer_plen_count);
+  peer_table_init ();
+}
+
+/* peer_spec_reserve() makes the slots up to the size. The route
+   tables of a slot are allocated when the first route is stored. */
+void
+peer_spec_reserve (int size)
+{
+  int old = peer_spec_limit;
+  int i;
+
+  if (size <= peer_spec_limit)
+    return;
+
+  peer_spec_limit = (peer_spec_limit ? peer_spec_limit : 8);
+  while (peer_spec_limit < size)
+    peer_spec_limit *= 2;
+
+  peer_spec_index = realloc (peer_spec_index, peer_spec_limit * sizeof (int));
+  peer_route_table = realloc (peer_route_table,
+                              peer_spec_limit * sizeof (struct bgp_route *));
+  peer_view_table = realloc (peer_view_table,
+                             peer_spec_limit * sizeof (struct route_view *));
+  peer_route_size = realloc (peer_route_size, peer_spec_limit * sizeof (int));
+  peer_ptree = realloc (peer_ptree, peer_spec_limit * sizeof (struct ptree *));
+  assert (peer_spec_index && peer_route_table && peer_view_table &&
+          peer_route_size && peer_ptree);
+
+  for (i = old; i < peer_spec_limit; i++)
+    {
+      peer_spec_index[i] = -1;
+      peer_route_table[i] = NULL;
+      peer_view_table[i] = NULL;
+      peer_route_size[i] = 0;
+      peer_ptree[i] = ptree_create ();
+    }
+}
+
+/* peer_spec_add() registers the peer_index to be selected,
+   and returns its slot. A peer specified twice gets the same slot. */
+int
+peer_spec_add (int peer_index)
+{
+  int slot;
+
+  if (peer_index < 0 || peer_index >= PEER_INDEX_LIMIT)
+    return -1;
+
+  if (PEER_SPEC_MATCH (peer_index))
+    return PEER_SPEC_SLOT (peer_index);
+
+  slot = peer_spec_size++;
+  peer_spec_reserve (peer_spec_size);
+  peer_spec_index[slot] = peer_index;
+  peer_spec_bitmap[peer_index / 64] |= (1ULL << (peer_index % 64));
+  peer_spec_slot[peer_index] = slot;
+  return slot;
+}
+
+void
+peer_spec_finish ()
+{
+  int i;
+
+  for (i = 0; i < peer_spec_limit; i++)
+    {
+      free (peer_route_table[i]);
+      free (peer_view_table[i]);
+      ptree_delete (peer_ptree[i]);
+    }
+  free (peer_spec_index);
+  free (peer_route_table);
+  free (peer_view_table);
+  free (peer_route_size);
+  free (peer_ptree);
+  peer_spec_index = NULL;
+  peer_route_table = NULL;
+  peer_view_table = NULL;
+  peer_route_size = NULL;
+  peer_ptree = NULL;
+  peer_spec_size = peer_spec_limit = 0;
+  memset (peer_spec_bitmap, 0, sizeof (peer_spec_bitmap));
 }
 
 void
@@ -72,11 +205,26 @@ peer_route_count_show ()
   printf ("%lu,", (unsigned long) timestamp);
   for (i = 0; i < peer_size; i++)
     {
-      printf ("%llu", (unsigned long long) peer_table[i].route_count);
+      printf ("%llu", (unsigned long long)
+              sample_estimate (peer_count[i].route_count));
       if (i < peer_size - 1)
         printf (",");
     }
   printf ("\n");
+
+  /* the error bounds of the estimates in the sampling mode. */
+  if (sample_rate)
+    {
+      printf ("#ci95,");
+      for (i = 0; i < peer_size; i++)
+        {
+          printf ("%llu", (unsigned long long)
+                  sample_error (peer_count[i].route_count));
+          if (i < peer_size - 1)
+            printf (",");
+        }
+      printf ("\n");
+    }
   fflush (stdout);
 }
 
@@ -86,9 +234,9 @@ peer_route_count_clear ()
   int i;
   for (i = 0; i < peer_size; i++)
     {
-      peer_table[i].route_count = 0;
-      peer_table[i].route_count_ipv4 = 0;
-      peer_table[i].route_count_ipv6 = 0;
+      peer_count[i].route_count = 0;
+      peer_count[i].route_count_ipv4 = 0;
+      peer_count[i].route_count_ipv6 = 0;
     }
 }
 
@@ -104,11 +252,17 @@ peer_route_count_list ()
       inet_ntop (AF_INET, &peer->bgp_id, buf, sizeof (buf));
       inet_ntop (AF_INET, &peer->ipv4_addr, buf2, sizeof (buf2));
       inet_ntop (AF_INET6, &peer->ipv6_addr, buf3, sizeof (buf3));
-      printf ("peer[%d]: %s asn: %d #routes: %'llu (v4: %'llu v6: %'llu)",
-              i, buf, peer->asnumber,
-              (unsigned long long) peer->route_count,
-              (unsigned long long) peer->route_count_ipv4,
-              (unsigned long long) peer->route_count_ipv6);
+      printf ("peer[%d]: %s asn: %d #routes: %'llu",
+              i, buf, peer->asnumber, (unsigned long long)
+              sample_estimate (peer_count[i].route_count));
+      if (sample_rate)
+        printf (" +-%'llu", (unsigned long long)
+                sample_error (peer_count[i].route_count));
+      printf (" (v4: %'llu v6: %'llu)",
+              (unsigned long long)
+              sample_estimate (peer_count[i].route_count_ipv4),
+              (unsigned long long)
+              sample_estimate (peer_count[i].route_count_ipv6));
       if (verbose)
         printf (" [%s|%s]", buf2, buf3);
       printf ("\n");
@@ -119,38 +273,44 @@ void
 peer_route_count_by_plen_show ()
 {
   int i, j;
+  /* IPv6 prefixlens are shown only for the IPv6 query (-6). */
+  int plen_max = (qafi == AF_INET6 ? PEER_PLEN_MAX : 32);
 
   for (i = 0; i < peer_size; i++)
     {
-      if (peer_spec_size)
-        {
-          int match = 0;
-          for (j = 0; j < peer_spec_size; j++)
-            if (i == peer_spec_index[j])
-              match++;
-
-          if (! match)
-            continue;
-        }
+      if (peer_spec_size && ! PEER_SPEC_MATCH (i))
+        continue;
 
       printf ("%lu,", (unsigned long) timestamp);
-      for (j = 0; j < 33; j++)
+      for (j = 0; j <= plen_max; j++)
         {
           printf ("%llu", (unsigned long long)
-                  peer_table[i].route_count_by_plen[j]);
-          if (j < 32)
+                  sample_estimate (PEER_PLEN_COUNT (i)[j]));
+          if (j < plen_max)
             printf (",");
         }
       printf ("\n");
+
+      if (sample_rate)
+        {
+          printf ("#ci95,");
+          for (j = 0; j <= plen_max; j++)
+            {
+              printf ("%llu", (unsigned long long)
+                      sample_error (PEER_PLEN_COUNT (i)[j]));
+              if (j < plen_max)
+                printf (",");
+            }
+          printf ("\n");
+        }
     }
 }
 
 void
 peer_route_count_by_plen_clear ()
 {
-  int i, j;
-  for (i = 0; i < peer_size; i++)
-    for (j = 0; j < 33; j++)
-      peer_table[i].route_count_by_plen[j] = 0;
+  if (peer_plen_count)
+    memset (peer_plen_count, 0, (size_t) peer_limit *
+            (PEER_PLEN_MAX + 1) * sizeof (uint64_t));
 }
 
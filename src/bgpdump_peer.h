@@ -19,35 +19,64 @@
 #ifndef _BGPDUMP_PEER_H_
 #define _BGPDUMP_PEER_H_
 
+/* The peer metadata from the PEER_INDEX_TABLE. */
 struct peer
 {
   struct in_addr bgp_id;
   struct in_addr ipv4_addr;
   struct in6_addr ipv6_addr;
   uint32_t asnumber;
+  uint8_t type;
+};
+
+/* The per-peer counters updated for each rib entry are kept apart
+   from the metadata, and the counters by prefixlen are allocated
+   only for -j, so that the hot part stays small with many peers. */
+struct peer_count
+{
   uint64_t route_count;
-  uint64_t route_count_by_plen[33];
   uint64_t route_count_ipv4;
   uint64_t route_count_ipv6;
-  FILE *fp;
 };
 
-#define PEER_MAX 256
+#define PEER_PLEN_MAX 128
+#define PEER_PLEN_COUNT(index) \
+  (&peer_plen_count[(size_t) (index) * (PEER_PLEN_MAX + 1)])
 
-#define PEER_INDEX_MAX 8
+/* the peer_index is 16-bit in the RIB entry. */
+#define PEER_INDEX_LIMIT 65536
 
 extern struct peer peer_null;
-extern struct peer peer_table[];
+extern struct peer *peer_table;
+extern struct peer_count *peer_count;
+extern uint64_t *peer_plen_count;
 extern int peer_size;
+extern int peer_limit;
 
-extern int peer_spec_index[];
+/* The peers selected by -p (or -a) are kept in the order specified,
+   and the position (the slot) indexes the per-peer route tables.
+   The bitmap and the slot map give the slot of a peer_index in O(1)
+   for each rib entry. */
+extern int *peer_spec_index;
 extern int peer_spec_size;
+extern uint64_t peer_spec_bitmap[];
+extern uint16_t peer_spec_slot[];
+
+#define PEER_SPEC_MATCH(index) \
+  (peer_spec_bitmap[(index) / 64] & (1ULL << ((index) % 64)))
+#define PEER_SPEC_SLOT(index) (peer_spec_slot[(index)])
 
-extern struct bgp_route *peer_route_table[];
-extern int peer_route_size[];
-extern struct ptree *peer_ptree[];
+extern struct bgp_route **peer_route_table;
+extern struct route_view **peer_view_table;
+extern int *peer_route_size;
+extern struct ptree **peer_ptree;
 
 void peer_table_init ();
+void peer_table_resize (int size);
+void peer_table_finish ();
+int peer_spec_add (int peer_index);
+void peer_spec_reserve (int size);
+void peer_spec_finish ();
 void peer_print (struct peer *peer);
 void peer_route_count_show ();
 void peer_route_count_clear ();
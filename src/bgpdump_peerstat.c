@@ -25,6 +25,7 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <assert.h>
 
 #include "ptree.h"
 
@@ -33,68 +34,62 @@
 #include "bgpdump_route.h"
 #include "bgpdump_peer.h"
 #include "bgpdump_peerstat.h"
+#include "bgpdump_sample.h"
 
-struct peer_stat peer_stat[PEER_MAX];
+struct peer_stat *peer_stat = NULL;
+int peer_stat_size = 0;
 
 void
 peer_stat_init ()
 {
-  int i, index;
+  peer_stat = NULL;
+  peer_stat_size = 0;
+}
 
-  for (i = 0; i < PEER_MAX; i++)
-    memset (&peer_stat[i], 0, sizeof (struct peer_stat));
+/* peer_stat[] follows the peer_table. */
+static void
+peer_stat_resize (int size)
+{
+  if (size <= peer_stat_size)
+    return;
+
+  peer_stat = realloc (peer_stat, size * sizeof (struct peer_stat));
+  assert (peer_stat);
+  memset (&peer_stat[peer_stat_size], 0,
+          (size - peer_stat_size) * sizeof (struct peer_stat));
+  peer_stat_size = size;
+}
 
-  if (peer_spec_size)
-    {
-      for (i = 0; i < peer_spec_size; i++)
-        {
-          index = peer_spec_index[i];
-          peer_stat[index].nexthop_count = ptree_create ();
-          peer_stat[index].origin_as_count = ptree_create ();
-          peer_stat[index].as_path_count = ptree_create ();
-          peer_stat[index].as_path_len_count = ptree_create ();
-        }
-    }
-  else
-    {
-      for (i = 0; i < PEER_MAX; i++)
-        {
-          peer_stat[i].nexthop_count = ptree_create ();
-          peer_stat[i].origin_as_count = ptree_create ();
-          peer_stat[i].as_path_count = ptree_create ();
-          peer_stat[i].as_path_len_count = ptree_create ();
-        }
-    }
+/* only the peers that have been selected get the trees. A peer index
+   may be selected in a later file (e.g., by -a), so that the trees
+   are made when they are first needed. */
+static void
+peer_stat_trees (struct peer_stat *ps)
+{
+  if (ps->nexthop_count)
+    return;
+
+  ps->nexthop_count = ptree_create ();
+  ps->origin_as_count = ptree_create ();
+  ps->as_path_count = ptree_create ();
+  ps->as_path_len_count = ptree_create ();
 }
 
 void
 peer_stat_finish ()
 {
-  int i, index;
-  if (peer_spec_size)
-    {
-      for (i = 0; i < peer_spec_size; i++)
-        {
-          index = peer_spec_index[i];
-          ptree_delete (peer_stat[index].nexthop_count);
-          ptree_delete (peer_stat[index].origin_as_count);
-          ptree_delete (peer_stat[index].as_path_count);
-          ptree_delete (peer_stat[index].as_path_len_count);
-        }
-    }
-  else
+  int i;
+  for (i = 0; i < peer_stat_size; i++)
     {
-      for (i = 0; i < PEER_MAX; i++)
-        {
-          ptree_delete (peer_stat[i].nexthop_count);
-          ptree_delete (peer_stat[i].origin_as_count);
-          ptree_delete (peer_stat[i].as_path_count);
-          ptree_delete (peer_stat[i].as_path_len_count);
-        }
+      if (! peer_stat[i].nexthop_count)
+        continue;
+      ptree_delete (peer_stat[i].nexthop_count);
+      ptree_delete (peer_stat[i].origin_as_count);
+      ptree_delete (peer_stat[i].as_path_count);
+      ptree_delete (peer_stat[i].as_path_len_count);
     }
-
-  for (i = 0; i < PEER_MAX; i++)
-    memset (&peer_stat[i], 0, sizeof (struct peer_stat));
+  free (peer_stat);
+  peer_stat_init ();
 }
 
 extern uint8_t prefix_length;
@@ -112,6 +107,10 @@ peer_stat_save (int peer_index, struct bgp_route *route)
 
   memset (path_list, 0, sizeof (uint32_t) * ROUTE_PATH_LIMIT);
 
+  if (peer_index >= peer_stat_size)
+    peer_stat_resize (peer_size);
+  peer_stat_trees (&peer_stat[peer_index]);
+
   peer_stat[peer_index].route_count++;
   peer_stat[peer_index].route_count_by_plen[prefix_length]++;
 
@@ -188,36 +187,35 @@ peer_stat_show ()
   uint32_t val;
   uint64_t data;
   uint64_t count;
-  int match = 0;
+  char *sample_distinct;
+
+  /* the distinct values are not scaled by the sampling. */
+  sample_distinct = (sample_rate ? " (in the sample)" : "");
+
+  peer_stat_resize (peer_size);
 
   for (i = 0; i < peer_size; i++)
     {
-      match = 0;
-      if (peer_spec_size)
-        {
-          for (j = 0; j < peer_spec_size; j++)
-            if (i == peer_spec_index[j])
-              match++;
-        }
-      else
-        match++;
-
-      if (match)
-        index = i;
-      else
+      if (peer_spec_size && ! PEER_SPEC_MATCH (i))
         continue;
+      index = i;
+      peer_stat_trees (&peer_stat[index]);
 
       printf ("peer[%d]:\n", index);
 
-      printf ("Number of routes: %llu\n",
-              (unsigned long long) peer_stat[index].route_count);
+      printf ("Number of routes: %llu", (unsigned long long)
+              sample_estimate (peer_stat[index].route_count));
+      if (sample_rate)
+        printf (" (+-%llu)", (unsigned long long)
+                sample_error (peer_stat[index].route_count));
+      printf ("\n");
       printf ("Number of routes per plen:");
       for (j = 0; j < 33; j++)
         {
           if (j % 5 == 0)
             printf ("\n");
-          printf ("    /%-2d: %6llu", j,
-                  (unsigned long long) peer_stat[index].route_count_by_plen[j]);
+          printf ("    /%-2d: %6llu", j, (unsigned long long)
+                  sample_estimate (peer_stat[index].route_count_by_plen[j]));
         }
       printf ("\n");
 
@@ -231,14 +229,15 @@ peer_stat_show ()
           memset (&val, 0, sizeof (val));
           memcpy (&val, n->key, (n->keylen + 7) / 8);
           inet_ntop (AF_INET, &val, buf, sizeof (buf));
-          data = (uint64_t) n->data;
+          data = sample_estimate ((uint64_t) n->data);
 
           if (verbose)
             printf ("nexthop: %s/%d: count: %llu\n", buf, n->keylen,
                     (unsigned long long) data);
           count++;
         }
-      printf ("Number of nexthops: %lu\n", (unsigned long) count);
+      printf ("Number of nexthops: %lu%s\n", (unsigned long) count,
+              sample_distinct);
 
       count = 0;
       t = peer_stat[index].origin_as_count;
@@ -250,7 +249,7 @@ peer_stat_show ()
           memset (&netval, 0, sizeof (netval));
           memcpy (&netval, n->key, (n->keylen + 7) / 8);
           val = ntohl (netval);
-          data = (uint64_t) n->data;
+          data = sample_estimate ((uint64_t) n->data);
 
           if (verbose)
             printf ("origin_as: %lu/%d: count: %llu\n", 
@@ -258,7 +257,8 @@ peer_stat_show ()
                     (unsigned long long) data);
           count++;
         }
-      printf ("Number of origin_as: %lu\n", (unsigned long) count);
+      printf ("Number of origin_as: %lu%s\n", (unsigned long) count,
+              sample_distinct);
 
       count = 0;
       t = peer_stat[index].as_path_count;
@@ -268,7 +268,7 @@ peer_stat_show ()
             continue;
 
           uint32_t *p;
-          data = (uint64_t) n->data;
+          data = sample_estimate ((uint64_t) n->data);
 
           if (verbose)
             {
@@ -285,7 +285,8 @@ peer_stat_show ()
             }
           count++;
         }
-      printf ("Number of unique as paths: %lu\n", (unsigned long) count);
+      printf ("Number of unique as paths: %lu%s\n", (unsigned long) count,
+              sample_distinct);
 
       count = 0;
       t = peer_stat[index].as_path_len_count;
@@ -296,14 +297,15 @@ peer_stat_show ()
 
           uint8_t len = 0;
           len = *(uint8_t *) n->key;
-          data = (uint64_t) n->data;
+          data = sample_estimate ((uint64_t) n->data);
 
           if (verbose)
             printf ("as_path_len: %d/%d: count: %llu\n",
                     (int) len, n->keylen, (unsigned long long) data);
           count++;
         }
-      printf ("Number of as path len: %lu\n", (unsigned long) count);
+      printf ("Number of as path len: %lu%s\n", (unsigned long) count,
+              sample_distinct);
     }
 }
 
@@ -30,7 +30,8 @@ struct peer_stat
   struct ptree *as_path_len_count;
 };
 
-extern struct peer_stat peer_stat[];
+extern struct peer_stat *peer_stat;
+extern int peer_stat_size;
 
 void peer_stat_init ();
 void peer_stat_finish ();
@@ -34,6 +34,7 @@
 #include "bgpdump_option.h"
 #include "bgpdump_query.h"
 #include "bgpdump_route.h"
+#include "bgpdump_qcache.h"
 
 void
 ptree_list (struct ptree *ptree)
@@ -48,7 +49,7 @@ ptree_list (struct ptree *ptree)
     {
       if (x->data)
         {
-          br = x->data;
+          br = route_get (x->data);
           inet_ntop (qafi, br->prefix, buf, sizeof (buf));
           inet_ntop (qafi, br->nexthop, buf2, sizeof (buf2));
           printf ("%s/%d: %s\n", buf, br->prefix_length, buf2);
@@ -60,47 +61,200 @@ ptree_list (struct ptree *ptree)
   printf ("number of routes: %llu\n", (unsigned long long) count);
 }
 
+/* ptree_query_answer_route() prints the answer (the matched route,
+   or NULL) to the query. */
+void
+ptree_query_answer_route (int peer_index, struct query *q,
+                          struct bgp_route *route)
+{
+  char *query = q->destination;
+  char *answer = q->nexthop;
+  char buf[64];
+
+  if (route)
+    {
+      if (route->af != qafi)
+        {
+          printf ("wrong afi: query-afi: %d route-afi: %d\n",
+                  qafi, route->af);
+        }
+      else
+        {
+          memcpy (answer, route->nexthop, MAX_ADDR_LENGTH);
+          if (! benchmark)
+            {
+              if (lookup_file)
+                {
+                  inet_ntop (qafi, query, buf, sizeof (buf));
+                  printf ("%s: ", buf);
+                }
+              route_print (stdout, peer_index, route);
+            }
+        }
+    }
+  else if (! benchmark)
+    {
+      inet_ntop (qafi, query, buf, sizeof (buf));
+      printf ("%s: no route found.\n", buf);
+    }
+}
+
+/* ptree_query_answer() prints the answer (the data of the matched
+   node, or NULL) to the query. */
+void
+ptree_query_answer (int peer_index, struct query *q, void *data)
+{
+  ptree_query_answer_route (peer_index, q, (data ? route_get (data) : NULL));
+}
+
+/* ptree_query_prefix_answer() prints a route (the data of a node of
+   the prefix length keylen) that answers the prefix query, if the
+   prefix length is in the range [lo, hi]. returns 1 if printed. */
+int
+ptree_query_prefix_answer (int peer_index, struct query *q, int plen,
+                           void *data, int keylen, int lo, int hi)
+{
+  struct bgp_route *route;
+  char buf[64];
+
+  if (! data || keylen < lo || hi < keylen)
+    return 0;
+  route = route_get (data);
+  if (route->af != qafi)
+    return 0;
+
+  if (! benchmark)
+    {
+      inet_ntop (qafi, q->destination, buf, sizeof (buf));
+      printf ("%s/%d: ", buf, plen);
+      route_print (stdout, peer_index, route);
+    }
+  return 1;
+}
+
+void
+ptree_query_prefix_none (struct query *q, int plen)
+{
+  char buf[64];
+
+  if (benchmark)
+    return;
+  inet_ntop (qafi, q->destination, buf, sizeof (buf));
+  printf ("%s/%d: no route found.\n", buf, plen);
+}
+
+/* ptree_query_prefix() answers the prefix query (-Y): the exact
+   match, the less-specifics on the path from the top, or the
+   more-specifics in the subtree under the prefix, where the walk
+   does not go below the prefix length of the "le". */
+void
+ptree_query_prefix (int peer_index, struct ptree *ptree, struct query *q)
+{
+  struct ptree_node *x, *root;
+  int match, plen, lo, hi;
+  int found = 0;
+
+  match = query_prefix_range (q, &plen, &lo, &hi);
+  switch (match)
+    {
+    case QUERY_MATCH_SHORTER:
+    case QUERY_MATCH_ORSHORTER:
+      for (x = ptree->top; x && x->keylen <= hi; )
+        {
+          if (! ptree_match (x->key, q->destination, x->keylen))
+            break;
+          found += ptree_query_prefix_answer (peer_index, q, plen,
+                                              x->data, x->keylen, lo, hi);
+          if (x->keylen >= plen)
+            break;
+          x = x->child[check_bit (q->destination, x->keylen)];
+        }
+      break;
+
+    case QUERY_MATCH_LONGER:
+    case QUERY_MATCH_ORLONGER:
+      /* the root of the subtree is the first node on the path that is
+         not shorter than the prefix. */
+      for (x = ptree->top; x && x->keylen < plen; )
+        {
+          if (! ptree_match (x->key, q->destination, x->keylen))
+            break;
+          x = x->child[check_bit (q->destination, x->keylen)];
+        }
+      if (! x || ! ptree_match (x->key, q->destination, plen) ||
+          x->keylen < plen)
+        break;
+      for (root = x; x; x = ptree_next_within (root->keylen, hi, x))
+        found += ptree_query_prefix_answer (peer_index, q, plen,
+                                            x->data, x->keylen, lo, hi);
+      break;
+
+    default:
+      x = ptree_search_exact (q->destination, plen, ptree);
+      if (x)
+        found += ptree_query_prefix_answer (peer_index, q, plen,
+                                            x->data, x->keylen, lo, hi);
+      break;
+    }
+
+  if (! found)
+    ptree_query_prefix_none (q, plen);
+}
+
+/* ptree_search_block() is ptree_search() that also tells whether
+   no node is below the boundary in the block of the key, i.e., the
+   match is the same for all the addresses in the block. */
+void *
+ptree_search_block (void *trie, int slot, char *key, int keylen,
+                    int boundary, int *covered)
+{
+  struct ptree *t = trie;
+  struct ptree_node *x, *match;
+
+  *covered = 1;
+  match = NULL;
+  x = t->top;
+  while (x)
+    {
+      if ((x->keylen > boundary ||
+           (x->keylen == boundary && (x->child[0] || x->child[1]))) &&
+          ptree_match (x->key, key, boundary))
+        *covered = 0;
+      if (x->keylen > keylen || ! ptree_match (x->key, key, x->keylen))
+        break;
+      if (x->data)
+        match = x;
+      x = x->child[check_bit (key, x->keylen)];
+    }
+
+  return (match ? match->data : NULL);
+}
+
 void
 ptree_query (int peer_index, struct ptree *ptree,
              struct query *query_table, uint64_t query_size)
 {
   int i;
   struct ptree_node *x;
-  char buf[64];
 
   for (i = 0; i < query_size; i++)
     {
-      char *query = query_table[i].destination;
-      char *answer = query_table[i].nexthop;
       int plen = (qafi == AF_INET ? 32 : 128);
-      x = ptree_search (query, plen, ptree);
-      if (x)
+      if (query_is_prefix (&query_table[i]))
         {
-          struct bgp_route *route = x->data;
-          if (route->af != qafi)
-            {
-              printf ("wrong afi: query-afi: %d route-afi: %d\n",
-                      qafi, route->af);
-            }
-          else
-            {
-              memcpy (answer, route->nexthop, MAX_ADDR_LENGTH);
-              if (! benchmark)
-                {
-                  if (lookup_file)
-                    {
-                      inet_ntop (qafi, query, buf, sizeof (buf));
-                      printf ("%s: ", buf);
-                    }
-                  route_print (stdout, peer_index, route);
-                }
-            }
+          ptree_query_prefix (peer_index, ptree, &query_table[i]);
+          continue;
         }
-      else if (! benchmark)
+      if (lookup_qcache)
         {
-          inet_ntop (qafi, query, buf, sizeof (buf));
-          printf ("%s: no route found.\n", buf);
+          ptree_query_answer (peer_index, &query_table[i],
+                              qcache_lookup (lookup_qcache, peer_index, qafi,
+                                             query_table[i].destination,
+                                             ptree_search_block, ptree, 0));
+          continue;
         }
+      x = ptree_search (query_table[i].destination, plen, ptree);
+      ptree_query_answer (peer_index, &query_table[i], (x ? x->data : NULL));
     }
 }
 
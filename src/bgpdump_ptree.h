@@ -17,6 +17,16 @@
  */
 
 void ptree_list (struct ptree *ptree);
+void ptree_query_answer_route (int peer_index, struct query *q,
+                               struct bgp_route *route);
+void ptree_query_answer (int peer_index, struct query *q, void *data);
+int ptree_query_prefix_answer (int peer_index, struct query *q, int plen,
+                               void *data, int keylen, int lo, int hi);
+void ptree_query_prefix_none (struct query *q, int plen);
+void ptree_query_prefix (int peer_index, struct ptree *ptree,
+                         struct query *q);
+void *ptree_search_block (void *trie, int slot, char *key, int keylen,
+                          int boundary, int *covered);
 void ptree_query (int peer_index, struct ptree *ptree,
                   struct query *query_table, uint64_t query_size);
 
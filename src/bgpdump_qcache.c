@@ -0,0 +1,133 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "bgpdump_qcache.h"
+
+/* the cache for the lookups (-l, -L) of the table sink. */
+struct qcache *lookup_qcache = NULL;
+
+struct qcache *
+qcache_create (uint64_t size)
+{
+  struct qcache *c;
+  uint64_t n = 1;
+  int bits = 0;
+
+  while (n < size)
+    {
+      n <<= 1;
+      bits++;
+    }
+
+  c = malloc (sizeof (struct qcache));
+  assert (c);
+  memset (c, 0, sizeof (struct qcache));
+  c->entries = malloc (n * sizeof (struct qcache_entry));
+  assert (c->entries);
+  memset (c->entries, 0, n * sizeof (struct qcache_entry));
+  c->mask = n - 1;
+  c->shift = 64 - bits;
+  return c;
+}
+
+void
+qcache_flush (struct qcache *c)
+{
+  memset (c->entries, 0, (c->mask + 1) * sizeof (struct qcache_entry));
+}
+
+void
+qcache_delete (struct qcache *c)
+{
+  if (! c)
+    return;
+  free (c->entries);
+  free (c);
+}
+
+void *
+qcache_lookup (struct qcache *c, int peer_index, int af, char *key,
+               qcache_fill_t fill, void *trie, int slot)
+{
+  struct qcache_entry *e;
+  uint64_t k = 0;
+  uint64_t index;
+  int boundary, keylen, covered, i;
+  void *data;
+
+  if (af == AF_INET)
+    {
+      boundary = QCACHE_BOUNDARY_IPV4;
+      keylen = 32;
+    }
+  else
+    {
+      boundary = QCACHE_BOUNDARY_IPV6;
+      keylen = 128;
+    }
+
+  /* the peer in the upper 16 bits, and the block below. */
+  for (i = 0; i < boundary / 8; i++)
+    k = (k << 8) | (uint8_t) key[i];
+  k |= (uint64_t) (peer_index & 0xffff) << 48;
+
+  /* Fibonacci hashing: the upper bits of the product. */
+  index = (c->mask ? ((k ^ af) * 0x9e3779b97f4a7c15ULL) >> c->shift : 0);
+  e = &c->entries[index];
+
+  if (e->state != QCACHE_EMPTY && e->key == k && e->af == af)
+    {
+      if (e->state == QCACHE_COVERED)
+        {
+          c->hits++;
+          return e->data;
+        }
+      c->specifics++;
+      return (*fill) (trie, slot, key, keylen, boundary, &covered);
+    }
+
+  c->misses++;
+  data = (*fill) (trie, slot, key, keylen, boundary, &covered);
+  e->key = k;
+  e->af = af;
+  e->state = (covered ? QCACHE_COVERED : QCACHE_SPECIFIC);
+  e->data = data;
+  return data;
+}
+
+void
+qcache_print (FILE *fp, struct qcache *c)
+{
+  uint64_t total = c->hits + c->misses + c->specifics;
+
+  fprintf (fp, "lookup cache: %llu entries: %llu lookups, %llu hits "
+           "(%.1f%%), %llu misses, %llu more-specific.\n",
+           (unsigned long long) c->mask + 1, (unsigned long long) total,
+           (unsigned long long) c->hits,
+           (total ? 100.0 * c->hits / total : 0.0),
+           (unsigned long long) c->misses,
+           (unsigned long long) c->specifics);
+}
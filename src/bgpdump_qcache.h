@@ -0,0 +1,68 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BGPDUMP_QCACHE_H_
+#define _BGPDUMP_QCACHE_H_
+
+/* The lookup cache (-K) is a direct-mapped cache in front of the
+   tries, keyed by the peer and the /24 (/48 for IPv6) block of the
+   address. A block is cached only when no prefix more specific than
+   the block exists in it, so that the match is the same for all the
+   addresses in the block. The blocks with the more-specifics are
+   also remembered, and looked up in the trie as before. */
+
+#define QCACHE_BOUNDARY_IPV4 24
+#define QCACHE_BOUNDARY_IPV6 48
+
+#define QCACHE_EMPTY    0
+#define QCACHE_COVERED  1
+#define QCACHE_SPECIFIC 2
+
+struct qcache_entry
+{
+  uint64_t key;
+  void *data;               /* the match, or NULL for no route. */
+  uint8_t state;
+  uint8_t af;
+};
+
+struct qcache
+{
+  struct qcache_entry *entries;
+  uint64_t mask;
+  int shift;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t specifics;       /* looked up in the trie for a more-specific. */
+};
+
+/* the fill function searches the trie for the key (of keylen), and
+   tells whether the match covers the whole block of the boundary. */
+typedef void *(*qcache_fill_t) (void *trie, int slot, char *key,
+                                int keylen, int boundary, int *covered);
+
+extern struct qcache *lookup_qcache;
+
+struct qcache *qcache_create (uint64_t size);
+void qcache_flush (struct qcache *c);
+void qcache_delete (struct qcache *c);
+void *qcache_lookup (struct qcache *c, int peer_index, int af, char *key,
+                     qcache_fill_t fill, void *trie, int slot);
+void qcache_print (FILE *fp, struct qcache *c);
+
+#endif /*_BGPDUMP_QCACHE_H_*/
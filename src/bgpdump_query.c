@@ -28,6 +28,8 @@
 #include <sys/time.h>
 #include <assert.h>
 
+#include "bgpdump.h"
+#include "bgpdump_option.h"
 #include "bgpdump_route.h"
 #include "bgpdump_query.h"
 
@@ -36,6 +38,10 @@ struct query *query_table;
 uint64_t query_limit = QUERY_LIMIT_DEFAULT;
 uint64_t query_size = 0;
 
+int query_match = QUERY_MATCH_LONGEST;
+int query_match_ge = -1;
+int query_match_le = -1;
+
 void
 query_init ()
 {
@@ -44,19 +50,42 @@ query_init ()
   memset (query_table, 0, query_limit * sizeof (struct query));
 }
 
+/* query_parse() reads the address, or the prefix "<addr>/<plen>"
+   (plen is -1 for the address). */
+int
+query_parse (int af, char *str, char *addr, int *plen)
+{
+  char buf[64], *p, *endptr;
+  int maxlen = (af == AF_INET ? 32 : 128);
+
+  snprintf (buf, sizeof (buf), "%s", str);
+  *plen = -1;
+  p = index (buf, '/');
+  if (p)
+    {
+      *p++ = '\0';
+      *plen = strtol (p, &endptr, 10);
+      if (*p == '\0' || *endptr != '\0' || *plen < 0 || *plen > maxlen)
+        return -1;
+    }
+  if (inet_pton (af, buf, addr) != 1)
+    return -1;
+  return 0;
+}
+
 void
 query_addr (char *lookup_addr)
 {
-  printf ("looking up an address: %s\n", lookup_addr);
-  inet_pton (qafi, lookup_addr,
-             query_table[query_size++].destination);
+  struct query *q = &query_table[query_size++];
+  if (query_parse (qafi, lookup_addr, q->destination, &q->plen) < 0)
+    printf ("warning: malformed query: %s\n", lookup_addr);
 }
 
 unsigned long
 query_file_count (char *lookup_file)
 {
   unsigned long count = 0;
-  char *p, buf[32];
+  char *p, buf[64];
   FILE *fp;
 
   fp = fopen (lookup_file, "r");
@@ -81,7 +110,7 @@ void
 query_file (char *lookup_file)
 {
   FILE *fp;
-  char *p, buf[32];
+  char *p, buf[64];
   fp = fopen (lookup_file, "r");
   if (fp == NULL)
     {
@@ -99,7 +128,9 @@ query_file (char *lookup_file)
       p = index (buf, '\n');
       if (p)
         *p = '\0';
-      inet_pton (qafi, buf, query_table[query_size++].destination);
+      query_parse (qafi, buf, query_table[query_size].destination,
+                   &query_table[query_size].plen);
+      query_size++;
     }
   fclose (fp);
 }
@@ -126,6 +157,7 @@ query_random (int ntimes)
           p = (unsigned long *)&query_table[query_size].destination[12];
           *p = random ();
         }
+      query_table[query_size].plen = -1;
       query_size++;
     }
 }
@@ -152,3 +184,144 @@ query_list ()
 }
 
 
+
+/* query_load() constructs the query_table by the options
+   (-l, -L, -4, -6). */
+void
+query_load ()
+{
+  if (! qafi && lookup_addr)
+    {
+      struct in6_addr tmp;
+      if (inet_pton (AF_INET6, lookup_addr, &tmp) == 1)
+        qafi = AF_INET6;
+      else
+        qafi = AF_INET;
+    }
+
+  if (! qafi)
+    qafi = AF_INET;
+
+  query_limit = 0;
+
+  if (lookup_file)
+    query_limit = query_file_count (lookup_file);
+
+  if (lookup_addr)
+    query_limit++;
+
+  query_init ();
+
+  if (lookup_addr)
+    query_addr (lookup_addr);
+
+  if (lookup_file)
+    query_file (lookup_file);
+}
+
+/* query_print() shows the queries before the answers. */
+void
+query_print ()
+{
+  printf ("lookup: query afi: %d\n", qafi);
+  if (lookup_addr)
+    printf ("looking up an address: %s\n", lookup_addr);
+  if (debug)
+    query_list ();
+}
+
+/* query_match_parse() reads the match of -Y: "exact", "longer",
+   "orlonger", "shorter", or "orshorter", optionally followed by
+   "ge <n>" and "le <n>" to limit the prefix length of the routes. */
+int
+query_match_parse (char *spec)
+{
+  char buf[64], *word, *save, *endptr;
+  long n;
+
+  snprintf (buf, sizeof (buf), "%s", spec);
+  word = strtok_r (buf, " ,", &save);
+  if (! word)
+    return -1;
+
+  if (! strcmp (word, "exact"))
+    query_match = QUERY_MATCH_EXACT;
+  else if (! strcmp (word, "longer"))
+    query_match = QUERY_MATCH_LONGER;
+  else if (! strcmp (word, "orlonger"))
+    query_match = QUERY_MATCH_ORLONGER;
+  else if (! strcmp (word, "shorter"))
+    query_match = QUERY_MATCH_SHORTER;
+  else if (! strcmp (word, "orshorter"))
+    query_match = QUERY_MATCH_ORSHORTER;
+  else
+    return -1;
+
+  while ((word = strtok_r (NULL, " ,", &save)) != NULL)
+    {
+      char *arg = strtok_r (NULL, " ,", &save);
+      if (! arg)
+        return -1;
+      n = strtol (arg, &endptr, 10);
+      if (*endptr != '\0' || n < 0 || n > 128)
+        return -1;
+      if (! strcmp (word, "ge"))
+        query_match_ge = n;
+      else if (! strcmp (word, "le"))
+        query_match_le = n;
+      else
+        return -1;
+    }
+  return 0;
+}
+
+int
+query_is_prefix (struct query *q)
+{
+  return (query_match != QUERY_MATCH_LONGEST || q->plen >= 0);
+}
+
+int
+query_prefix_any ()
+{
+  uint64_t i;
+  for (i = 0; i < query_size; i++)
+    if (query_is_prefix (&query_table[i]))
+      return 1;
+  return 0;
+}
+
+/* query_prefix_range() returns the match of the prefix query, with
+   its prefix length, and the range of the prefix length of the routes
+   to answer. */
+int
+query_prefix_range (struct query *q, int *plen, int *lo, int *hi)
+{
+  int maxlen = (qafi == AF_INET ? 32 : 128);
+  int match = query_match;
+  int ge = (query_match_ge >= 0 ? query_match_ge : 0);
+  int le = (query_match_le >= 0 ? query_match_le : maxlen);
+
+  *plen = (q->plen >= 0 ? q->plen : maxlen);
+  if (match == QUERY_MATCH_LONGEST)
+    match = QUERY_MATCH_EXACT;
+
+  switch (match)
+    {
+    case QUERY_MATCH_LONGER:
+    case QUERY_MATCH_ORLONGER:
+      *lo = *plen + (match == QUERY_MATCH_LONGER ? 1 : 0);
+      *lo = (ge > *lo ? ge : *lo);
+      *hi = MIN (le, maxlen);
+      break;
+    case QUERY_MATCH_SHORTER:
+    case QUERY_MATCH_ORSHORTER:
+      *lo = ge;
+      *hi = MIN (le, *plen - (match == QUERY_MATCH_SHORTER ? 1 : 0));
+      break;
+    default:
+      *lo = *hi = *plen;
+      break;
+    }
+  return match;
+}
@@ -21,10 +21,25 @@
 struct query
 {
   char destination[MAX_ADDR_LENGTH];
-  int plen;
+  int plen;                 /* of the prefix query, or -1. */
   char nexthop[MAX_ADDR_LENGTH];
 };
 
+/* the match of the queries (-Y). A query of an address is answered
+   by the longest match, and of a prefix (e.g., 203.0.113.0/22) by the
+   exact match, unless specified. With -Y, an address is the prefix of
+   the full length. */
+#define QUERY_MATCH_LONGEST   0
+#define QUERY_MATCH_EXACT     1
+#define QUERY_MATCH_LONGER    2   /* the more-specifics. */
+#define QUERY_MATCH_ORLONGER  3   /* the more-specifics and the exact. */
+#define QUERY_MATCH_SHORTER   4   /* the less-specifics. */
+#define QUERY_MATCH_ORSHORTER 5   /* the less-specifics and the exact. */
+
+extern int query_match;
+extern int query_match_ge;
+extern int query_match_le;
+
 extern struct query *query_table;
 extern uint64_t query_limit;
 extern uint64_t query_size;
@@ -35,4 +50,12 @@ unsigned long query_file_count (char *lookup_file);
 void query_file (char *lookup_file);
 void query_random (int ntimes);
 void query_list ();
+void query_load ();
+void query_print ();
+
+int query_parse (int af, char *str, char *addr, int *plen);
+int query_match_parse (char *spec);
+int query_is_prefix (struct query *q);
+int query_prefix_any ();
+int query_prefix_range (struct query *q, int *plen, int *lo, int *hi);
 
@@ -0,0 +1,282 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#include "bgpdump.h"
+#include "bgpdump_option.h"
+#include "bgpdump_route.h"
+#include "bgpdump_savefile.h"
+#include "bgpdump_ribshm.h"
+
+#define RIBSHM_RETRY 16
+
+static struct ribshm_control *
+ribshm_control_map (char *name, int write)
+{
+  struct ribshm_control *control;
+  int fd;
+
+  fd = shm_open (name, (write ? O_RDWR | O_CREAT : O_RDONLY), 0644);
+  if (fd < 0)
+    {
+      fprintf (stderr, "ribshm: can't open %s: %s\n", name, strerror (errno));
+      return NULL;
+    }
+
+  if (write && lseek (fd, 0, SEEK_END) < sizeof (struct ribshm_control) &&
+      ftruncate (fd, sizeof (struct ribshm_control)) < 0)
+    {
+      fprintf (stderr, "ribshm: can't resize %s: %s\n",
+               name, strerror (errno));
+      close (fd);
+      return NULL;
+    }
+  if (! write && lseek (fd, 0, SEEK_END) < sizeof (struct ribshm_control))
+    {
+      fprintf (stderr, "ribshm: not published: %s\n", name);
+      close (fd);
+      return NULL;
+    }
+
+  control = mmap (NULL, sizeof (struct ribshm_control),
+                  (write ? PROT_READ | PROT_WRITE : PROT_READ),
+                  MAP_SHARED, fd, 0);
+  close (fd);
+  if (control == MAP_FAILED)
+    {
+      fprintf (stderr, "ribshm: can't map %s: %s\n", name, strerror (errno));
+      return NULL;
+    }
+  return control;
+}
+
+static int
+ribshm_control_valid (struct ribshm_control *control)
+{
+  return (! memcmp (control->magic, RIBSHM_MAGIC, sizeof (control->magic)) &&
+          control->version == RIBSHM_VERSION);
+}
+
+/* read the current segment and generation, consistently with the
+   update by the publisher. */
+static int
+ribshm_control_read (struct ribshm_control *control, char *segment,
+                     uint64_t *generation)
+{
+  uint64_t seq;
+
+  do
+    {
+      seq = __atomic_load_n (&control->sequence, __ATOMIC_ACQUIRE);
+      if (seq & 1)
+        continue;
+      if (! ribshm_control_valid (control))
+        return -1;
+      memcpy (segment, control->segment, RIBSHM_NAME_MAX);
+      segment[RIBSHM_NAME_MAX - 1] = '\0';
+      *generation = control->generation;
+      __atomic_thread_fence (__ATOMIC_ACQUIRE);
+    }
+  while ((seq & 1) ||
+         seq != __atomic_load_n (&control->sequence, __ATOMIC_ACQUIRE));
+  return 0;
+}
+
+/* ribshm_publish() writes the tables of the specified peers to a new
+   segment, and makes it the current one. */
+int
+ribshm_publish (char *name)
+{
+  struct ribshm_control *control;
+  char segment[RIBSHM_NAME_MAX], old[RIBSHM_NAME_MAX];
+  uint64_t generation;
+  int fd;
+
+  if (name[0] != '/' || strlen (name) + 24 >= RIBSHM_NAME_MAX)
+    {
+      fprintf (stderr, "ribshm: malformed name: %s "
+               "(\"/<name>\", e.g., /bgpdump2-rib).\n", name);
+      return -1;
+    }
+
+  control = ribshm_control_map (name, 1);
+  if (! control)
+    return -1;
+
+  old[0] = '\0';
+  generation = 1;
+  if (ribshm_control_valid (control))
+    {
+      memcpy (old, control->segment, RIBSHM_NAME_MAX);
+      old[RIBSHM_NAME_MAX - 1] = '\0';
+      generation = control->generation + 1;
+    }
+
+  snprintf (segment, sizeof (segment), "%s.%llu", name,
+            (unsigned long long) generation);
+  fd = shm_open (segment, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    {
+      fprintf (stderr, "ribshm: can't open %s: %s\n",
+               segment, strerror (errno));
+      munmap (control, sizeof (struct ribshm_control));
+      return -1;
+    }
+  if (savefile_save_fd (fd, segment, generation) < 0)
+    {
+      shm_unlink (segment);
+      munmap (control, sizeof (struct ribshm_control));
+      return -1;
+    }
+
+  __atomic_add_fetch (&control->sequence, 1, __ATOMIC_SEQ_CST);
+  memcpy (control->magic, RIBSHM_MAGIC, sizeof (control->magic));
+  control->version = RIBSHM_VERSION;
+  control->generation = generation;
+  memset (control->segment, 0, RIBSHM_NAME_MAX);
+  strcpy (control->segment, segment);
+  __atomic_add_fetch (&control->sequence, 1, __ATOMIC_SEQ_CST);
+  munmap (control, sizeof (struct ribshm_control));
+
+  if (old[0] && strcmp (old, segment))
+    shm_unlink (old);
+
+  if (verbose)
+    printf ("ribshm: published %s (generation %llu).\n",
+            segment, (unsigned long long) generation);
+  return 0;
+}
+
+/* ribshm_map() maps the current segment read-only. */
+struct savefile_version *
+ribshm_map (char *name)
+{
+  struct ribshm_control *control;
+  struct savefile_version *v = NULL;
+  char segment[RIBSHM_NAME_MAX];
+  uint64_t generation;
+  int fd, i;
+
+  control = ribshm_control_map (name, 0);
+  if (! control)
+    return NULL;
+
+  /* the segment may be unlinked by the next publish meanwhile. */
+  for (i = 0; i < RIBSHM_RETRY; i++)
+    {
+      if (ribshm_control_read (control, segment, &generation) < 0)
+        {
+          fprintf (stderr, "ribshm: not published: %s\n", name);
+          break;
+        }
+      fd = shm_open (segment, O_RDONLY, 0);
+      if (fd < 0 && errno == ENOENT)
+        continue;
+      if (fd < 0)
+        {
+          fprintf (stderr, "ribshm: can't open %s: %s\n",
+                   segment, strerror (errno));
+          break;
+        }
+      v = savefile_map_fd (fd, segment);
+      if (v && v->header->generation != generation)
+        {
+          fprintf (stderr, "ribshm: wrong generation: %s\n", segment);
+          savefile_unmap (v);
+          v = NULL;
+        }
+      break;
+    }
+
+  munmap (control, sizeof (struct ribshm_control));
+  return v;
+}
+
+/* ribshm_generation() returns the generation of the current segment,
+   to see if the mapped one is old, or 0 if not published. */
+uint64_t
+ribshm_generation (char *name)
+{
+  struct ribshm_control *control;
+  char segment[RIBSHM_NAME_MAX];
+  uint64_t generation = 0;
+
+  control = ribshm_control_map (name, 0);
+  if (! control)
+    return 0;
+  if (ribshm_control_read (control, segment, &generation) < 0)
+    generation = 0;
+  munmap (control, sizeof (struct ribshm_control));
+  return generation;
+}
+
+struct route_view *
+ribshm_lookup (struct savefile_version *v, int peer_index, int af,
+               char *addr)
+{
+  struct route_view *view;
+  int slot;
+
+  slot = savefile_version_slot (v, peer_index);
+  if (slot < 0)
+    return NULL;
+  view = savefile_version_search (v, slot, addr,
+                                  (af == AF_INET ? 32 : 128));
+  if (view && view->af != af)
+    return NULL;
+  return view;
+}
+
+/* call the func for each route of the peer, in the order of the
+   rib entries. */
+void
+ribshm_iterate (struct savefile_version *v, int peer_index,
+                void (*func) (struct route_view *view, char *attr,
+                              void *arg),
+                void *arg)
+{
+  struct savefile_slot *s;
+  struct route_view *views;
+  uint32_t i;
+  int slot;
+
+  slot = savefile_version_slot (v, peer_index);
+  if (slot < 0)
+    return;
+  s = &v->slots[slot];
+  views = (struct route_view *) (v->base + s->view_offset);
+  for (i = 0; i < s->route_size; i++)
+    (*func) (&views[i], v->arena + views[i].attr_offset, arg);
+}
+
+void
+ribshm_close (struct savefile_version *v)
+{
+  savefile_unmap (v);
+}
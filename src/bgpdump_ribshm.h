@@ -0,0 +1,76 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BGPDUMP_RIBSHM_H_
+#define _BGPDUMP_RIBSHM_H_
+
+/* The published rib (-Q <name>) is the savefile of the route tables
+   in a POSIX shared memory segment, so that the local processes share
+   one copy of the tables, mapped read-only. All the references in it
+   are the offsets from the start (see bgpdump_savefile.h).
+
+   The segment of each publish is "<name>.<generation>", and the small
+   control segment "<name>" tells the current one. A publish writes
+   the new segment, updates the control, and unlinks the old segment,
+   which remains for the readers still mapping it.
+
+   The readers open the current one by "-O shm:<name>" (e.g., with the
+   lookup server, which maps the new one on SIGHUP), or by the reader
+   API below:
+
+     struct savefile_version *v = ribshm_map ("/rib");
+     struct route_view *view = ribshm_lookup (v, peer_index, AF_INET, addr);
+     ribshm_iterate (v, peer_index, func, arg);
+     if (ribshm_generation ("/rib") != v->header->generation) ...
+     ribshm_close (v);
+
+   The attributes of a route are the raw BGP path attributes at
+   v->arena + view->attr_offset (decoded by route_decode()). */
+
+#define RIBSHM_PREFIX "shm:"
+#define RIBSHM_MAGIC "BGPDSHM1"
+#define RIBSHM_VERSION 1
+#define RIBSHM_NAME_MAX 256
+
+struct ribshm_control
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t sequence;        /* odd while the control is updated. */
+  uint64_t generation;
+  char segment[RIBSHM_NAME_MAX];
+};
+
+struct savefile_version;
+struct route_view;
+
+int ribshm_publish (char *name);
+
+struct savefile_version *ribshm_map (char *name);
+uint64_t ribshm_generation (char *name);
+struct route_view *
+ribshm_lookup (struct savefile_version *v, int peer_index, int af,
+               char *addr);
+void ribshm_iterate (struct savefile_version *v, int peer_index,
+                     void (*func) (struct route_view *view, char *attr,
+                                   void *arg),
+                     void *arg);
+void ribshm_close (struct savefile_version *v);
+
+#endif /*_BGPDUMP_RIBSHM_H_*/
@@ -31,6 +31,9 @@
 #include "bgpdump_option.h"
 #include "bgpdump_route.h"
 #include "bgpdump_peer.h"
+#include "bgpdump_community.h"
+#include "bgpdump_obuf.h"
+#include "bgpdump_data.h"
 
 extern uint32_t timestamp;
 extern uint16_t peer_index;
@@ -39,6 +42,10 @@ struct bgp_route *routes;
 int route_limit = 0;
 int route_size = 0;
 
+char *route_arena = NULL;
+uint64_t route_arena_size = 0;
+uint64_t route_arena_limit = 0;
+
 char addr_none[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
 
 void
@@ -67,78 +74,198 @@ route_table_create ()
   return table;
 }
 
+struct route_view *
+route_view_table_create ()
+{
+  struct route_view *table;
+  table = calloc (nroutes, sizeof (struct route_view));
+  assert (table);
+  return table;
+}
+
 void
-route_print_brief (FILE *fp, int peer_index, struct bgp_route *route)
+route_arena_finish ()
+{
+  free (route_arena);
+  route_arena = NULL;
+  route_arena_size = route_arena_limit = 0;
+}
+
+/* the raw attributes are copied into the arena. The views keep
+   the offset, which is still valid after the arena is realloc'ed. */
+static uint64_t
+route_arena_add (char *attr, int attr_length)
+{
+  uint64_t offset;
+
+  if (route_arena_size + attr_length > route_arena_limit)
+    {
+      while (route_arena_size + attr_length > route_arena_limit)
+        route_arena_limit = (route_arena_limit ?
+                             route_arena_limit * 2 : 16 * 1024 * 1024);
+      route_arena = realloc (route_arena, route_arena_limit);
+      assert (route_arena);
+    }
+  offset = route_arena_size;
+  memcpy (&route_arena[offset], attr, attr_length);
+  route_arena_size += attr_length;
+  return offset;
+}
+
+/* route_table_add() stores the route in the table of the slot
+   (the index in peer_spec_index[]), and returns the data for the ptree. */
+void *
+route_table_add (int slot, struct bgp_route *route, int peer_index,
+                 char *attr, int attr_length)
+{
+  int *route_size = &peer_route_size[slot];
+  struct route_view *view;
+  struct bgp_route *rp;
+
+  if (*route_size >= nroutes)
+    {
+      printf ("route table overflow: route_size: %'d.\n", *route_size);
+      printf ("try to increase the route_table size: "
+              "e.g., -M 2000000\n");
+      exit (-1);
+    }
+
+  if (lazy)
+    {
+      if (! peer_view_table[slot])
+        peer_view_table[slot] = route_view_table_create ();
+      view = &peer_view_table[slot][(*route_size)++];
+      memcpy (view->prefix, route->prefix, MAX_ADDR_LENGTH);
+      view->af = route->af;
+      view->prefix_length = route->prefix_length;
+      view->peer_index = peer_index;
+      view->attr_length = attr_length;
+      view->attr_offset = route_arena_add (attr, attr_length);
+      return view;
+    }
+
+  if (! peer_route_table[slot])
+    peer_route_table[slot] = route_table_create ();
+  rp = &peer_route_table[slot][(*route_size)++];
+  memcpy (rp, route, sizeof (struct bgp_route));
+  return rp;
+}
+
+/* route_decode() decodes the view with its attributes in the arena. */
+void
+route_decode (struct bgp_route *route, struct route_view *view, char *arena)
+{
+  int saved_detail = detail;
+
+  memset (route, 0, sizeof (struct bgp_route));
+  route->af = view->af;
+  memcpy (route->prefix, view->prefix, MAX_ADDR_LENGTH);
+  route->prefix_length = view->prefix_length;
+
+  /* the detail has been printed at the time of the rib entry. */
+  detail = 0;
+  bgpdump_process_bgp_attributes (route, &arena[view->attr_offset],
+                                  &arena[view->attr_offset] +
+                                  view->attr_length);
+  detail = saved_detail;
+}
+
+/* route_get() returns the route of the ptree data. In the lazy mode,
+   it is decoded from the arena into the buffer that is reused by
+   the next call. */
+struct bgp_route *
+route_get (void *data)
+{
+  static struct bgp_route route;
+
+  if (! lazy)
+    return (struct bgp_route *) data;
+
+  route_decode (&route, (struct route_view *) data, route_arena);
+  return &route;
+}
+
+void
+route_format_brief (struct obuf *ob, int peer_index, struct bgp_route *route)
 {
-  char buf[64], buf2[64];
-  inet_ntop (route->af, route->prefix, buf, sizeof (buf));
-  inet_ntop (route->af, route->nexthop, buf2, sizeof (buf2));
   if (! extract && peer_spec_size != 1 && ! unified)
-    fprintf (fp, "peer[%d]: ", peer_index);
-  fprintf (fp, "%s/%d %s\n", buf, route->prefix_length, buf2);
+    {
+      obuf_str (ob, "peer[");
+      obuf_int (ob, peer_index);
+      obuf_str (ob, "]: ");
+    }
+  obuf_addr (ob, route->af, route->prefix);
+  OBUF_CHAR (ob, '/');
+  obuf_u32 (ob, route->prefix_length);
+  OBUF_CHAR (ob, ' ');
+  obuf_addr (ob, route->af, route->nexthop);
+  OBUF_CHAR (ob, '\n');
 }
 
 void
-route_print (FILE *fp, int peer_index, struct bgp_route *route)
+route_format (struct obuf *ob, int peer_index, struct bgp_route *route)
 {
   int i;
-  char buf[64], buf2[64];
-  inet_ntop (route->af, route->prefix, buf, sizeof (buf));
-  inet_ntop (route->af, route->nexthop, buf2, sizeof (buf2));
   if (! extract && peer_spec_size != 1)
-    fprintf (fp, "peer[%d]: ", peer_index);
-  fprintf (fp, "%s/%d %s ", buf, route->prefix_length, buf2);
-  fprintf (fp, "origin_as: %lu ", (unsigned long) route->origin_as);
-  fprintf (fp, "as-path[%d]:", route->path_size);
+    {
+      obuf_str (ob, "peer[");
+      obuf_int (ob, peer_index);
+      obuf_str (ob, "]: ");
+    }
+  obuf_addr (ob, route->af, route->prefix);
+  OBUF_CHAR (ob, '/');
+  obuf_u32 (ob, route->prefix_length);
+  OBUF_CHAR (ob, ' ');
+  obuf_addr (ob, route->af, route->nexthop);
+  obuf_str (ob, " origin_as: ");
+  obuf_u32 (ob, route->origin_as);
+  obuf_str (ob, " as-path[");
+  obuf_u32 (ob, route->path_size);
+  obuf_str (ob, "]:");
   for (i = 0; i < MIN (route->path_size, ROUTE_PATH_LIMIT); i++)
-    fprintf (fp, " %lu", (unsigned long) route->path_list[i]);
+    {
+      OBUF_CHAR (ob, ' ');
+      obuf_u32 (ob, route->path_list[i]);
+    }
   if (route->set_size)
     {
-      fprintf (fp, " {");
+      obuf_str (ob, " {");
       for (i = 0; i < MIN (route->set_size, ROUTE_SET_LIMIT); i++)
-        fprintf (fp, "%s%lu", (i == 0 ? "" : " "),
-                (unsigned long) route->set_list[i]);
-      fprintf (fp, "}");
+        {
+          if (i > 0)
+            OBUF_CHAR (ob, ' ');
+          obuf_u32 (ob, route->set_list[i]);
+        }
+      OBUF_CHAR (ob, '}');
+    }
+  if (route->community != COMMUNITY_NONE)
+    {
+      struct community_entry *e = COMMUNITY_ENTRY (route->community);
+      if (e->std_size)
+        {
+          obuf_str (ob, " community: ");
+          community_std_format (ob, route->community);
+        }
+      if (e->ext_size)
+        {
+          obuf_str (ob, " ext-community: ");
+          community_ext_format (ob, route->community);
+        }
+      if (e->large_size)
+        {
+          obuf_str (ob, " large-community: ");
+          community_large_format (ob, route->community);
+        }
     }
-  fprintf (fp, "\n");
+  OBUF_CHAR (ob, '\n');
 }
 
 void
-route_print_compat (FILE *fp, int peer_index, struct bgp_route *route)
+route_format_compat (struct obuf *ob, int peer_index, struct bgp_route *route)
 {
   int i;
-  char prefix[64];
-  char nexthop[64];
-  int plen;
-  char peer_addr[64];
-  unsigned long peer_asn;
-
-  char *p, *e;
-  char as_path[128];
   char *origin;
 
-  unsigned long localpref;
-  unsigned long med;
-  unsigned long community;
-
-  inet_ntop (route->af, route->prefix, prefix, sizeof (prefix));
-  plen = route->prefix_length;
-  inet_ntop (route->af, route->nexthop, nexthop, sizeof (nexthop));
-  inet_ntop (AF_INET, &peer_table[peer_index].ipv4_addr,
-             peer_addr, sizeof (peer_addr));
-  peer_asn = peer_table[peer_index].asnumber;
-
-  p = as_path;
-  e = as_path + sizeof (as_path);
-  for (i = 0; i < MIN (route->path_size, ROUTE_PATH_LIMIT); i++)
-    {
-      if (i == 0)
-        snprintf (p, e - p, "%lu", (unsigned long) route->path_list[i]);
-      else
-        snprintf (p, e - p, " %lu", (unsigned long) route->path_list[i]);
-      p = as_path + strlen (as_path);
-    }
-
   switch (route->origin)
     {
     case '0':
@@ -153,29 +280,77 @@ route_print_compat (FILE *fp, int peer_index, struct bgp_route *route)
       break;
     }
 
-  char *atomicaggr;
-  char *atomicaggr_asn_addr;
-
-  localpref = route->localpref;
-  med = route->med;
-  community = route->community;
-
-  atomicaggr = (route->atomic_aggregate > 0 ? "AG" : "NAG");
-  atomicaggr_asn_addr = "";
-
 #if 0
   printf ("TABLE_DUMP2|Timestamp|B|Peer IP Address|Peer ASN|"
           "Prefix/Plen|AS-Path|Origin|Nexthop|LocalPref|MED|"
           "Community|AtomAggr|AggrAS AggrAddr|\n");
 #endif
 
-  fprintf (fp, "TABLE_DUMP2|%lu|B|%s|%lu|"
-          "%s/%d|%s|%s|%s|%lu|%lu|"
-          "%lu|%s|%s|\n",
-          (unsigned long) timestamp, peer_addr, (unsigned long) peer_asn,
-          prefix, plen, as_path, origin, nexthop,
-          (unsigned long) localpref, (unsigned long) med,
-          (unsigned long) community, atomicaggr, atomicaggr_asn_addr);
+  obuf_str (ob, "TABLE_DUMP2|");
+  obuf_u32 (ob, timestamp);
+  obuf_str (ob, "|B|");
+  obuf_ipv4 (ob, &peer_table[peer_index].ipv4_addr);
+  OBUF_CHAR (ob, '|');
+  obuf_u32 (ob, peer_table[peer_index].asnumber);
+  OBUF_CHAR (ob, '|');
+  obuf_addr (ob, route->af, route->prefix);
+  OBUF_CHAR (ob, '/');
+  obuf_u32 (ob, route->prefix_length);
+  OBUF_CHAR (ob, '|');
+
+  /* the whole AS path (it was cut at 128 bytes before). */
+  for (i = 0; i < MIN (route->path_size, ROUTE_PATH_LIMIT); i++)
+    {
+      if (i > 0)
+        OBUF_CHAR (ob, ' ');
+      obuf_u32 (ob, route->path_list[i]);
+    }
+
+  OBUF_CHAR (ob, '|');
+  obuf_str (ob, origin);
+  OBUF_CHAR (ob, '|');
+  obuf_addr (ob, route->af, route->nexthop);
+  OBUF_CHAR (ob, '|');
+  obuf_u32 (ob, route->localpref);
+  OBUF_CHAR (ob, '|');
+  obuf_u32 (ob, route->med);
+  OBUF_CHAR (ob, '|');
+
+  /* the standard and the large communities, as libbgpdump does. */
+  if (route->community != COMMUNITY_NONE)
+    {
+      struct community_entry *e = COMMUNITY_ENTRY (route->community);
+      community_std_format (ob, route->community);
+      if (e->std_size && e->large_size)
+        OBUF_CHAR (ob, ' ');
+      community_large_format (ob, route->community);
+    }
+
+  OBUF_CHAR (ob, '|');
+  obuf_str (ob, (route->atomic_aggregate > 0 ? "AG" : "NAG"));
+  obuf_str (ob, "||\n");
+}
+
+void
+route_print_brief (FILE *fp, int peer_index, struct bgp_route *route)
+{
+  struct obuf *ob = obuf_get ();
+  route_format_brief (ob, peer_index, route);
+  obuf_write (ob, fp);
+}
 
+void
+route_print (FILE *fp, int peer_index, struct bgp_route *route)
+{
+  struct obuf *ob = obuf_get ();
+  route_format (ob, peer_index, route);
+  obuf_write (ob, fp);
 }
 
+void
+route_print_compat (FILE *fp, int peer_index, struct bgp_route *route)
+{
+  struct obuf *ob = obuf_get ();
+  route_format_compat (ob, peer_index, route);
+  obuf_write (ob, fp);
+}
@@ -41,9 +41,25 @@ struct bgp_route
   uint8_t atomic_aggregate;
   uint32_t localpref;
   uint32_t med;
-  uint32_t community;
+  uint32_t community; /* id in the community pool. */
 };
 
+/* In the lazy mode (-z), the stored route is only this compact
+   header with the offset of its raw attribute bytes in route_arena,
+   and the attributes are decoded by route_get() when looked up. */
+struct route_view
+{
+  char prefix[MAX_ADDR_LENGTH];
+  uint8_t af;
+  uint8_t prefix_length;
+  uint16_t peer_index;
+  uint32_t attr_length;
+  uint64_t attr_offset;
+};
+
+extern char *route_arena;
+extern uint64_t route_arena_size;
+
 extern struct bgp_route *routes;
 extern int route_limit;
 extern int route_size;
@@ -59,6 +75,21 @@ void route_init ();
 void route_finish ();
 
 struct bgp_route *route_table_create ();
+struct route_view *route_view_table_create ();
+void route_arena_finish ();
+
+void *route_table_add (int slot, struct bgp_route *route, int peer_index,
+                       char *attr, int attr_length);
+void route_decode (struct bgp_route *route, struct route_view *view,
+                   char *arena);
+struct bgp_route *route_get (void *data);
+
+struct obuf;
+void route_format_brief (struct obuf *ob, int peer_index,
+                         struct bgp_route *route);
+void route_format (struct obuf *ob, int peer_index, struct bgp_route *route);
+void route_format_compat (struct obuf *ob, int peer_index,
+                          struct bgp_route *route);
 
 void route_print_brief (FILE *fp, int peer_index, struct bgp_route *route);
 void route_print (FILE *fp, int peer_index, struct bgp_route *route);
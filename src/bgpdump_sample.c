@@ -0,0 +1,114 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "bgpdump_sample.h"
+
+double sample_rate = 0.0;         /* 0 means no sampling. */
+uint32_t sample_threshold = 0;
+uint64_t sample_kept = 0;
+uint64_t sample_skipped = 0;
+
+/* the rate is given as "0.05" or "1/16". */
+int
+sample_parse (char *arg)
+{
+  char *endptr;
+  double num, den = 1.0;
+
+  num = strtod (arg, &endptr);
+  if (*endptr == '/')
+    den = strtod (endptr + 1, &endptr);
+  if (*endptr != '\0' || den <= 0.0)
+    return -1;
+
+  sample_rate = num / den;
+  if (sample_rate <= 0.0 || sample_rate > 1.0)
+    return -1;
+
+  sample_threshold = (uint32_t) (sample_rate * 4294967295.0);
+  return 0;
+}
+
+static uint32_t
+sample_hash (int af, char *prefix, int plen)
+{
+  uint32_t h = 2166136261U;
+  int i;
+
+  /* FNV-1a over the prefix, and the murmur3 finalizer
+     to spread the low-entropy addresses. */
+  h = (h ^ (uint8_t) af) * 16777619U;
+  h = (h ^ (uint8_t) plen) * 16777619U;
+  for (i = 0; i < (plen + 7) / 8; i++)
+    h = (h ^ (uint8_t) prefix[i]) * 16777619U;
+
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35U;
+  h ^= h >> 16;
+  return h;
+}
+
+int
+sample_record (int af, char *prefix, int plen)
+{
+  if (sample_rate >= 1.0 ||
+      sample_hash (af, prefix, plen) <= sample_threshold)
+    {
+      sample_kept++;
+      return 1;
+    }
+  sample_skipped++;
+  return 0;
+}
+
+/* the Horvitz-Thompson estimate of the count in the whole table
+   (the count itself without sampling). */
+uint64_t
+sample_estimate (uint64_t count)
+{
+  if (sample_rate == 0.0)
+    return count;
+  return (uint64_t) llround ((double) count / sample_rate);
+}
+
+/* the half width of the 95% interval of the estimate: each prefix
+   is in the sample with the probability of the rate, so the variance
+   of the estimate is about count * (1 - rate) / rate^2. */
+uint64_t
+sample_error (uint64_t count)
+{
+  return (uint64_t) ceil (1.96 * sqrt ((double) count * (1.0 - sample_rate))
+                          / sample_rate);
+}
+
+void
+sample_print ()
+{
+  uint64_t total = sample_kept + sample_skipped;
+  printf ("# sample: rate: %g: %'llu of %'llu records (%.2f%%)\n",
+          sample_rate, (unsigned long long) sample_kept,
+          (unsigned long long) total,
+          (total ? 100.0 * sample_kept / total : 0.0));
+}
@@ -0,0 +1,40 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BGPDUMP_SAMPLE_H_
+#define _BGPDUMP_SAMPLE_H_
+
+/* The sampling mode (-s) processes only the RIB records whose prefix
+   hashes below the rate, and skips the rest before their entries.
+   The hash depends only on the prefix, so that the same prefixes are
+   sampled in every file and by every peer. The counts are then shown
+   as the estimates (count / rate) with the 95% error bounds. */
+
+extern double sample_rate;
+extern uint64_t sample_kept;
+extern uint64_t sample_skipped;
+
+int sample_parse (char *arg);
+int sample_record (int af, char *prefix, int plen);
+
+uint64_t sample_estimate (uint64_t count);
+uint64_t sample_error (uint64_t count);
+
+void sample_print ();
+
+#endif /*_BGPDUMP_SAMPLE_H_*/
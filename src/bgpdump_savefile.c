@@ -18,104 +18,686 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <strings.h>
+#include <string.h>
 #include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/time.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
-#include <sys/time.h>
+#include <errno.h>
 #include <assert.h>
 
-#include "queue.h"
 #include "ptree.h"
 
+#include "bgpdump.h"
+#include "bgpdump_data.h"
 #include "bgpdump_route.h"
+#include "bgpdump_peer.h"
+#include "bgpdump_query.h"
+#include "bgpdump_ptree.h"
+#include "bgpdump_savefile.h"
+#include "bgpdump_qcache.h"
+#include "bgpdump_ribshm.h"
 
-#if 0
-void
-bgpdump_input (char *input, struct ptree *ptree)
+int savefile_loaded = 0;
+
+/* the nodes of the ptree in progress. */
+static struct savefile_node *savefile_nodes = NULL;
+static uint32_t savefile_nnodes = 0;
+static uint32_t savefile_node_limit = 0;
+
+/* the current version of the mapped savefile, and the epochs. */
+static struct savefile_version *savefile_current = NULL;
+static uint64_t savefile_epoch = 1;
+static uint64_t savefile_reader_epoch = 0;
+static uint64_t savefile_generation = 0;
+
+static FILE *savefile_fp = NULL;
+static char *savefile_path = NULL;
+static uint64_t savefile_offset = 0;
+
+static void
+savefile_write (const void *data, size_t len)
 {
-  FILE *fp;
-  char *p, buf[256];
-  struct in_addr prefix, nexthop;
-  int plen;
-  char *string;
-  char buf1[32], buf2[32];
-  uint64_t route_size = 0;
+  if (len && fwrite (data, 1, len, savefile_fp) != len)
+    {
+      fprintf (stderr, "savefile: write failed: %s: %s\n",
+               savefile_path, strerror (errno));
+      exit (-1);
+    }
+  savefile_offset += len;
+}
+
+static void
+savefile_align ()
+{
+  static const char pad[8] = { 0 };
+  savefile_write (pad, (8 - savefile_offset % 8) % 8);
+}
+
+/* number the nodes in the pre-order. */
+static int32_t
+savefile_node_add (struct ptree_node *x, int32_t parent,
+                   struct route_view *views)
+{
+  struct savefile_node *node;
+  int32_t index, child;
+  int i;
+
+  if (! x)
+    return SAVEFILE_NODE_NONE;
+
+  if (savefile_nnodes >= savefile_node_limit)
+    {
+      savefile_node_limit = (savefile_node_limit ?
+                             savefile_node_limit * 2 : 4096);
+      savefile_nodes = realloc (savefile_nodes, savefile_node_limit *
+                                sizeof (struct savefile_node));
+      assert (savefile_nodes);
+    }
+
+  index = savefile_nnodes++;
+  node = &savefile_nodes[index];
+  memset (node, 0, sizeof (struct savefile_node));
+  memcpy (node->key, x->key, PTREE_KEY_SIZE (x->keylen));
+  node->keylen = x->keylen;
+  node->parent = parent;
+  node->data = (x->data ? (struct route_view *) x->data - views : -1);
+
+  for (i = 0; i < 2; i++)
+    {
+      child = savefile_node_add (x->child[i], index, views);
+      savefile_nodes[index].child[i] = child;
+    }
+  return index;
+}
+
+/* savefile_save() writes the tables of the specified peers. The
+   routes must be in the lazy form (-z). */
+int
+savefile_save (char *path)
+{
+  int fd;
+
+  fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    {
+      fprintf (stderr, "savefile: can't open %s: %s\n",
+               path, strerror (errno));
+      return -1;
+    }
+  return savefile_save_fd (fd, path, 0);
+}
+
+/* savefile_save_fd() writes the savefile to the fd (e.g., of a shared
+   memory segment), and closes it. */
+int
+savefile_save_fd (int fd, char *path, uint32_t generation)
+{
+  struct savefile_header header;
+  struct savefile_slot *slots;
+  int i;
+
+  savefile_fp = fdopen (fd, "w");
+  assert (savefile_fp);
+  savefile_path = path;
+  savefile_offset = 0;
+
+  slots = calloc (peer_spec_size + 1, sizeof (struct savefile_slot));
+  assert (slots);
+
+  memset (&header, 0, sizeof (header));
+  savefile_write (&header, sizeof (header));
+
+  savefile_align ();
+  header.peer_offset = savefile_offset;
+  header.peer_size = peer_size;
+  savefile_write (peer_table, peer_size * sizeof (struct peer));
 
-  fp = fopen (input, "r");
-  if (! fp)
+  for (i = 0; i < peer_spec_size; i++)
     {
-      printf ("cannot open input file: %s\n", input);
+      slots[i].peer_index = peer_spec_index[i];
+      slots[i].route_size = peer_route_size[i];
+
+      savefile_align ();
+      slots[i].view_offset = savefile_offset;
+      if (peer_view_table[i])
+        savefile_write (peer_view_table[i],
+                        peer_route_size[i] * sizeof (struct route_view));
+
+      savefile_nnodes = 0;
+      slots[i].top = savefile_node_add (peer_ptree[i]->top,
+                                        SAVEFILE_NODE_NONE,
+                                        peer_view_table[i]);
+      slots[i].nnodes = savefile_nnodes;
+      savefile_align ();
+      slots[i].node_offset = savefile_offset;
+      savefile_write (savefile_nodes,
+                      savefile_nnodes * sizeof (struct savefile_node));
+    }
+
+  savefile_align ();
+  header.slot_offset = savefile_offset;
+  header.nslots = peer_spec_size;
+  savefile_write (slots, peer_spec_size * sizeof (struct savefile_slot));
+
+  savefile_align ();
+  header.arena_offset = savefile_offset;
+  header.arena_size = route_arena_size;
+  savefile_write (route_arena, route_arena_size);
+
+  memcpy (header.magic, SAVEFILE_MAGIC, sizeof (header.magic));
+  header.version = SAVEFILE_VERSION;
+  header.byte_order = SAVEFILE_BYTE_ORDER;
+  header.timestamp = timestamp;
+  header.generation = generation;
+  if (fseek (savefile_fp, 0, SEEK_SET) < 0)
+    {
+      fprintf (stderr, "savefile: seek failed: %s: %s\n",
+               path, strerror (errno));
+      exit (-1);
+    }
+  savefile_write (&header, sizeof (header));
+
+  if (fclose (savefile_fp) != 0)
+    {
+      fprintf (stderr, "savefile: close failed: %s: %s\n",
+               path, strerror (errno));
       exit (-1);
     }
+  savefile_fp = NULL;
 
-  assert (ptree);
-  route_size = 0;
+  free (slots);
+  free (savefile_nodes);
+  savefile_nodes = NULL;
+  savefile_nnodes = savefile_node_limit = 0;
+  return 0;
+}
 
-  while (1)
+/* the section of count entries of the size at the offset is in the
+   mapping, and aligned. */
+static int
+savefile_section_valid (struct savefile_version *v, uint64_t offset,
+                        uint64_t count, size_t size)
+{
+  return (offset % 8 == 0 && offset <= v->size &&
+          count <= (v->size - offset) / size);
+}
+
+/* the node index is a node of the slot, or none. */
+#define SAVEFILE_INDEX_VALID(index, nnodes) \
+  ((index) == SAVEFILE_NODE_NONE || \
+   ((index) >= 0 && (uint32_t) (index) < (nnodes)))
+
+/* the indices and the offsets in the slot are all checked, so that
+   the walks on the mapping never go outside of it. The keys get
+   longer from a node to its children, so that a walk always ends. */
+static int
+savefile_slot_valid (struct savefile_version *v, struct savefile_slot *s)
+{
+  struct savefile_node *nodes, *x;
+  struct route_view *views, *view;
+  uint32_t i;
+  int j, maxlen;
+
+  if (s->peer_index >= v->header->peer_size ||
+      ! savefile_section_valid (v, s->view_offset, s->route_size,
+                                sizeof (struct route_view)) ||
+      ! savefile_section_valid (v, s->node_offset, s->nnodes,
+                                sizeof (struct savefile_node)) ||
+      ! SAVEFILE_INDEX_VALID (s->top, s->nnodes))
+    return 0;
+
+  views = (struct route_view *) (v->base + s->view_offset);
+  for (i = 0; i < s->route_size; i++)
     {
-      p = fgets (buf, sizeof (buf), fp);
-      if (! p)
-        break;
+      view = &views[i];
+      if (view->af != AF_INET && view->af != AF_INET6)
+        return 0;
+      maxlen = (view->af == AF_INET ? 32 : 128);
+      if (view->prefix_length > maxlen ||
+          view->peer_index >= v->header->peer_size ||
+          view->attr_offset > v->header->arena_size ||
+          view->attr_length > v->header->arena_size - view->attr_offset)
+        return 0;
+    }
+
+  nodes = (struct savefile_node *) (v->base + s->node_offset);
+  for (i = 0; i < s->nnodes; i++)
+    {
+      x = &nodes[i];
+      if (x->keylen < 0 || x->keylen > MAX_ADDR_LENGTH * 8 ||
+          ! SAVEFILE_INDEX_VALID (x->parent, s->nnodes) ||
+          x->data < -1 || x->data >= (int64_t) s->route_size)
+        return 0;
+      if (x->data >= 0)
+        {
+          maxlen = (views[x->data].af == AF_INET ? 32 : 128);
+          if (x->keylen > maxlen)
+            return 0;
+        }
+      for (j = 0; j < 2; j++)
+        if (! SAVEFILE_INDEX_VALID (x->child[j], s->nnodes) ||
+            (x->child[j] != SAVEFILE_NODE_NONE &&
+             nodes[x->child[j]].keylen <= x->keylen))
+          return 0;
+    }
+  return 1;
+}
+
+static int
+savefile_valid (struct savefile_version *v)
+{
+  struct savefile_header *h = v->header;
+  uint32_t i;
+
+  if (v->size < sizeof (struct savefile_header) ||
+      memcmp (h->magic, SAVEFILE_MAGIC, sizeof (h->magic)) ||
+      h->version != SAVEFILE_VERSION ||
+      h->byte_order != SAVEFILE_BYTE_ORDER)
+    return 0;
+  if (! savefile_section_valid (v, h->peer_offset, h->peer_size,
+                                sizeof (struct peer)) ||
+      ! savefile_section_valid (v, h->slot_offset, h->nslots,
+                                sizeof (struct savefile_slot)) ||
+      ! savefile_section_valid (v, h->arena_offset, h->arena_size, 1))
+    return 0;
+
+  v->slots = (struct savefile_slot *) (v->base + h->slot_offset);
+  for (i = 0; i < h->nslots; i++)
+    if (! savefile_slot_valid (v, &v->slots[i]))
+      return 0;
+  return 1;
+}
+
+void
+savefile_unmap (struct savefile_version *v)
+{
+  if (v->base)
+    munmap (v->base, v->size);
+  free (v->peer_slot);
+  free (v);
+}
+
+/* savefile_map() maps the savefile as a new version. The path
+   "shm:<name>" is the current one published to the shared memory. */
+struct savefile_version *
+savefile_map (char *path)
+{
+  int fd;
 
-      memset (&prefix, 0, sizeof (struct in_addr));
-      memset (&nexthop, 0, sizeof (struct in_addr));
-      string = buf;
+  if (! strncmp (path, RIBSHM_PREFIX, strlen (RIBSHM_PREFIX)))
+    return ribshm_map (path + strlen (RIBSHM_PREFIX));
 
-      p = strsep (&string, " \t/");
-      inet_pton (AF_INET, p, &prefix);
+  fd = open (path, O_RDONLY);
+  if (fd < 0)
+    {
+      fprintf (stderr, "savefile: can't open %s: %s\n",
+               path, strerror (errno));
+      return NULL;
+    }
+  return savefile_map_fd (fd, path);
+}
 
-      p = strsep (&string, " \t/");
-      plen = (int) strtol (p, NULL, 0);
+/* savefile_map_fd() maps the savefile of the fd read-only, and
+   closes the fd. */
+struct savefile_version *
+savefile_map_fd (int fd, char *path)
+{
+  struct savefile_version *v;
+  uint32_t i;
+  off_t size;
 
-      p = strsep (&string, " \t/");
-      inet_pton (AF_INET, p, &nexthop);
+  v = calloc (1, sizeof (struct savefile_version));
+  assert (v);
+  size = lseek (fd, 0, SEEK_END);
+  v->base = (size > 0 ?
+             mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) :
+             MAP_FAILED);
+  close (fd);
+  if (v->base == MAP_FAILED)
+    {
+      fprintf (stderr, "savefile: can't map %s: %s\n",
+               path, strerror (errno));
+      v->base = NULL;
+      savefile_unmap (v);
+      return NULL;
+    }
+  v->size = size;
+  v->header = (struct savefile_header *) v->base;
 
-      inet_ntop (AF_INET, &prefix, buf1, sizeof (buf1));
-      inet_ntop (AF_INET, &nexthop, buf2, sizeof (buf2));
-      printf ("prefix: %s/%d nexthop: %s\n", buf1, plen, buf2);
+  if (! savefile_valid (v))
+    {
+      fprintf (stderr, "savefile: not a valid savefile: %s\n", path);
+      savefile_unmap (v);
+      return NULL;
+    }
 
-      routes[route_size].prefix = prefix;
-      routes[route_size].prefix_length = plen;
-      routes[route_size].nexthop = nexthop;
-      ptree_add ((char *)&prefix, plen, &routes[route_size], ptree);
-      route_size++;
+  v->generation = __atomic_add_fetch (&savefile_generation, 1,
+                                      __ATOMIC_RELAXED);
+  v->peers = (struct peer *) (v->base + v->header->peer_offset);
+  v->arena = v->base + v->header->arena_offset;
+  v->peer_slot = malloc ((v->header->peer_size + 1) * sizeof (int32_t));
+  assert (v->peer_slot);
+  for (i = 0; i < v->header->peer_size; i++)
+    v->peer_slot[i] = -1;
+  for (i = 0; i < v->header->nslots; i++)
+    v->peer_slot[v->slots[i].peer_index] = i;
+  return v;
+}
+
+/* savefile_open() maps the savefile, and sets up the peer table and
+   the peer spec from it (only the peers given by -p, if any). */
+int
+savefile_open (char *path)
+{
+  struct savefile_version *v;
+  int i;
+
+  v = savefile_map (path);
+  if (! v)
+    return -1;
+
+  peer_table_resize (v->header->peer_size);
+  memcpy (peer_table, v->peers, v->header->peer_size * sizeof (struct peer));
+  peer_size = v->header->peer_size;
+  timestamp = v->header->timestamp;
+
+  if (! peer_spec_size)
+    for (i = 0; i < v->header->nslots; i++)
+      peer_spec_add (v->slots[i].peer_index);
+
+  for (i = 0; i < peer_spec_size; i++)
+    {
+      if (savefile_version_slot (v, peer_spec_index[i]) < 0)
+        {
+          fprintf (stderr, "savefile: no peer %d in %s\n",
+                   peer_spec_index[i], path);
+          savefile_unmap (v);
+          return -1;
+        }
     }
 
-  fclose (fp);
+  /* the routes are decoded from the mapped arena by route_get(). */
+  route_arena = v->arena;
+  route_arena_size = v->header->arena_size;
+  savefile_current = v;
+  savefile_loaded++;
+  return 0;
 }
 
+int
+savefile_version_slot (struct savefile_version *v, int peer_index)
+{
+  if (peer_index < 0 || peer_index >= v->header->peer_size)
+    return -1;
+  return v->peer_slot[peer_index];
+}
+
+/* the same as ptree_search(), on the nodes of the slot. */
+struct route_view *
+savefile_version_search (struct savefile_version *v, int slot,
+                         char *key, int keylen)
+{
+  struct savefile_slot *s = &v->slots[slot];
+  struct savefile_node *nodes, *x;
+  struct route_view *views;
+  int64_t match = -1;
+  int32_t index;
+
+  nodes = (struct savefile_node *) (v->base + s->node_offset);
+  views = (struct route_view *) (v->base + s->view_offset);
+
+  index = s->top;
+  while (index != SAVEFILE_NODE_NONE)
+    {
+      x = &nodes[index];
+      if (x->keylen > keylen || ! ptree_match (x->key, key, x->keylen))
+        break;
+      if (x->data >= 0)
+        match = x->data;
+      index = x->child[check_bit (key, x->keylen)];
+    }
+
+  return (match >= 0 ? &views[match] : NULL);
+}
+
+/* the same as ptree_search_block(), on the nodes of the slot. */
+void *
+savefile_search_block (void *trie, int slot, char *key, int keylen,
+                       int boundary, int *covered)
+{
+  struct savefile_version *v = trie;
+  struct savefile_slot *s = &v->slots[slot];
+  struct savefile_node *nodes, *x;
+  struct route_view *views;
+  int64_t match = -1;
+  int32_t index;
+
+  nodes = (struct savefile_node *) (v->base + s->node_offset);
+  views = (struct route_view *) (v->base + s->view_offset);
+
+  *covered = 1;
+  index = s->top;
+  while (index != SAVEFILE_NODE_NONE)
+    {
+      x = &nodes[index];
+      if ((x->keylen > boundary ||
+           (x->keylen == boundary &&
+            (x->child[0] != SAVEFILE_NODE_NONE ||
+             x->child[1] != SAVEFILE_NODE_NONE))) &&
+          ptree_match (x->key, key, boundary))
+        *covered = 0;
+      if (x->keylen > keylen || ! ptree_match (x->key, key, x->keylen))
+        break;
+      if (x->data >= 0)
+        match = x->data;
+      index = x->child[check_bit (key, x->keylen)];
+    }
+
+  return (match >= 0 ? &views[match] : NULL);
+}
+
+void *
+savefile_search (int slot, char *key, int keylen)
+{
+  struct savefile_version *v = savefile_current;
+  return savefile_version_search (v, savefile_version_slot (v,
+                                  peer_spec_index[slot]), key, keylen);
+}
+
+/* the same as ptree_query_prefix(), on the nodes of the slot. the
+   subtree is walked with a stack, in the same (pre-)order. */
 void
-bgpdump_output (char *output, struct ptree *ptree)
+savefile_query_prefix (int peer_index, struct savefile_version *v, int slot,
+                       struct query *q)
 {
-  FILE *fp;
-  char buf[256];
-  char buf1[32], buf2[32];
-  struct ptree_node *x;
+  struct savefile_slot *s = &v->slots[slot];
+  struct savefile_node *nodes, *x;
+  struct route_view *views;
+  int32_t index, stack[2 * (MAX_ADDR_LENGTH * 8 + 1)];
+  int match, plen, lo, hi, depth;
+  int found = 0;
 
-  assert (ptree);
+  nodes = (struct savefile_node *) (v->base + s->node_offset);
+  views = (struct route_view *) (v->base + s->view_offset);
+#define SAVEFILE_NODE_DATA(x) ((x)->data >= 0 ? &views[(x)->data] : NULL)
 
-  fp = fopen (output, "w");
-  if (! fp)
+  match = query_prefix_range (q, &plen, &lo, &hi);
+  index = s->top;
+  switch (match)
     {
-      printf ("cannot open output file: %s\n", output);
-      exit (-1);
+    case QUERY_MATCH_SHORTER:
+    case QUERY_MATCH_ORSHORTER:
+      for (; index != SAVEFILE_NODE_NONE; )
+        {
+          x = &nodes[index];
+          if (x->keylen > hi ||
+              ! ptree_match (x->key, q->destination, x->keylen))
+            break;
+          found += ptree_query_prefix_answer (peer_index, q, plen,
+                                              SAVEFILE_NODE_DATA (x),
+                                              x->keylen, lo, hi);
+          if (x->keylen >= plen)
+            break;
+          index = x->child[check_bit (q->destination, x->keylen)];
+        }
+      break;
+
+    case QUERY_MATCH_LONGER:
+    case QUERY_MATCH_ORLONGER:
+      for (; index != SAVEFILE_NODE_NONE; )
+        {
+          x = &nodes[index];
+          if (x->keylen >= plen ||
+              ! ptree_match (x->key, q->destination, x->keylen))
+            break;
+          index = x->child[check_bit (q->destination, x->keylen)];
+        }
+      if (index == SAVEFILE_NODE_NONE ||
+          nodes[index].keylen < plen ||
+          ! ptree_match (nodes[index].key, q->destination, plen))
+        break;
+      depth = 0;
+      stack[depth++] = index;
+      while (depth)
+        {
+          x = &nodes[stack[--depth]];
+          found += ptree_query_prefix_answer (peer_index, q, plen,
+                                              SAVEFILE_NODE_DATA (x),
+                                              x->keylen, lo, hi);
+          if (x->keylen >= hi)
+            continue;
+          if (x->child[1] != SAVEFILE_NODE_NONE)
+            stack[depth++] = x->child[1];
+          if (x->child[0] != SAVEFILE_NODE_NONE)
+            stack[depth++] = x->child[0];
+        }
+      break;
+
+    default:
+      for (; index != SAVEFILE_NODE_NONE; )
+        {
+          x = &nodes[index];
+          if (x->keylen > plen ||
+              ! ptree_match (x->key, q->destination, x->keylen))
+            break;
+          if (x->keylen == plen)
+            {
+              found += ptree_query_prefix_answer (peer_index, q, plen,
+                                                  SAVEFILE_NODE_DATA (x),
+                                                  x->keylen, lo, hi);
+              break;
+            }
+          index = x->child[check_bit (q->destination, x->keylen)];
+        }
+      break;
+    }
+#undef SAVEFILE_NODE_DATA
+
+  if (! found)
+    ptree_query_prefix_none (q, plen);
+}
+
+void
+savefile_query (int slot, struct query *query_table, uint64_t query_size)
+{
+  struct savefile_version *v = savefile_current;
+  int peer_index = peer_spec_index[slot];
+  int plen = (qafi == AF_INET ? 32 : 128);
+  uint64_t i;
+
+  for (i = 0; i < query_size; i++)
+    {
+      if (query_is_prefix (&query_table[i]))
+        savefile_query_prefix (peer_index, v,
+                               savefile_version_slot (v, peer_index),
+                               &query_table[i]);
+      else if (lookup_qcache)
+        ptree_query_answer (peer_index, &query_table[i],
+                            qcache_lookup (lookup_qcache, peer_index, qafi,
+                                           query_table[i].destination,
+                                           savefile_search_block, v,
+                                           savefile_version_slot
+                                             (v, peer_index)));
+      else
+        ptree_query_answer (peer_index, &query_table[i],
+                            savefile_search (slot,
+                                             query_table[i].destination,
+                                             plen));
     }
+}
+
+/* The readers (the server thread) take the current version between
+   savefile_acquire() and savefile_release(). A reader announces the
+   epoch in which it takes the version; savefile_publish() swaps the
+   version, advances the epoch, and waits until no reader remains in
+   an older epoch, before it unmaps the old version. */
+struct savefile_version *
+savefile_acquire ()
+{
+  __atomic_store_n (&savefile_reader_epoch,
+                    __atomic_load_n (&savefile_epoch, __ATOMIC_SEQ_CST),
+                    __ATOMIC_SEQ_CST);
+  return __atomic_load_n (&savefile_current, __ATOMIC_SEQ_CST);
+}
+
+void
+savefile_release ()
+{
+  __atomic_store_n (&savefile_reader_epoch, 0, __ATOMIC_RELEASE);
+}
+
+/* publish the new version, and returns the time (in usec) waiting
+   for the readers of the old version. */
+uint64_t
+savefile_publish (struct savefile_version *v)
+{
+  struct savefile_version *old;
+  struct timeval start, end;
+  uint64_t epoch, reader;
+
+  gettimeofday (&start, NULL);
+  old = __atomic_exchange_n (&savefile_current, v, __ATOMIC_SEQ_CST);
+  epoch = __atomic_add_fetch (&savefile_epoch, 1, __ATOMIC_SEQ_CST);
 
-  for (x = ptree_head (ptree); x; x = ptree_next (x))
+  while (1)
     {
-      struct bgp_route *r = x->data;
-      inet_ntop (AF_INET, &r->prefix, buf1, sizeof (buf1));
-      inet_ntop (AF_INET, &r->nexthop, buf2, sizeof (buf2));
-      snprintf (buf, sizeof (buf), "%s/%d %s\n",
-                buf1, r->prefix_length, buf2);
-      fputs (buf, fp);
+      reader = __atomic_load_n (&savefile_reader_epoch, __ATOMIC_SEQ_CST);
+      if (reader == 0 || reader >= epoch)
+        break;
+      usleep (100);
     }
+  gettimeofday (&end, NULL);
 
-  fclose (fp);
+  /* for route_get() after the server, in the main thread. */
+  if (savefile_loaded)
+    {
+      route_arena = v->arena;
+      route_arena_size = v->header->arena_size;
+    }
+  if (old)
+    savefile_unmap (old);
+  return (end.tv_sec - start.tv_sec) * 1000000ULL +
+         end.tv_usec - start.tv_usec;
 }
 
+void
+savefile_close ()
+{
+  if (! savefile_current)
+    return;
 
-#endif
+  if (savefile_loaded)
+    {
+      route_arena = NULL;
+      route_arena_size = 0;
+    }
+  savefile_unmap (savefile_current);
+  savefile_current = NULL;
+  savefile_loaded = 0;
+}
@@ -16,6 +16,101 @@
  * with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-void bgpdump_input (char *input);
-void bgpdump_output (char *output);
+#ifndef _BGPDUMP_SAVEFILE_H_
+#define _BGPDUMP_SAVEFILE_H_
 
+/* The savefile is a snapshot of the loaded route tables: the peer
+   table, and for each specified peer, its routes (in the lazy form,
+   struct route_view, with the raw attributes in the arena) and its
+   ptree, whose nodes are linked by their indices instead of pointers.
+   -S saves the snapshot after the files are read. -O maps the snapshot
+   file and looks up (-l, -L) on it directly: no parse, no decompression,
+   and no malloc for the nodes. The attributes of the matched route are
+   decoded when it is printed, as in the lazy mode (-z).
+
+   The file is in the host byte order (byte_order in the header tells
+   it), and all the sections are 8-byte aligned. */
+
+#define SAVEFILE_MAGIC "BGPDSNP1"
+#define SAVEFILE_VERSION 1
+#define SAVEFILE_BYTE_ORDER 0x01020304
+#define SAVEFILE_NODE_NONE (-1)
+
+struct savefile_header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t timestamp;
+  uint32_t peer_size;       /* struct peer [peer_size] */
+  uint32_t nslots;          /* struct savefile_slot [nslots] */
+  uint32_t generation;      /* of the publish (-Q), or 0. */
+  uint64_t peer_offset;
+  uint64_t slot_offset;
+  uint64_t arena_offset;
+  uint64_t arena_size;
+};
+
+struct savefile_slot
+{
+  uint32_t peer_index;
+  uint32_t route_size;      /* struct route_view [route_size] */
+  uint64_t view_offset;
+  uint64_t node_offset;     /* struct savefile_node [nnodes] */
+  uint32_t nnodes;
+  int32_t top;
+};
+
+struct savefile_node
+{
+  char key[MAX_ADDR_LENGTH];
+  int32_t keylen;
+  int32_t parent;
+  int32_t child[2];
+  int64_t data;             /* the index of the route, or -1. */
+};
+
+/* A mapped savefile. The lookup server (-q) replaces the version on
+   a reload while it keeps serving (see savefile_publish()). */
+struct savefile_version
+{
+  char *base;
+  size_t size;
+  struct savefile_header *header;
+  struct peer *peers;
+  struct savefile_slot *slots;
+  char *arena;
+  int32_t *peer_slot;       /* the slot of each peer index, or -1. */
+  uint64_t generation;      /* the serial number of the mapping. */
+};
+
+struct query;
+struct route_view;
+
+extern int savefile_loaded;
+
+int savefile_save (char *path);
+int savefile_save_fd (int fd, char *path, uint32_t generation);
+int savefile_open (char *path);
+void *savefile_search (int slot, char *key, int keylen);
+void savefile_query_prefix (int peer_index, struct savefile_version *v,
+                            int slot, struct query *q);
+void savefile_query (int slot, struct query *query_table,
+                     uint64_t query_size);
+void savefile_close ();
+
+struct savefile_version *savefile_map (char *path);
+struct savefile_version *savefile_map_fd (int fd, char *path);
+void savefile_unmap (struct savefile_version *v);
+int savefile_version_slot (struct savefile_version *v, int peer_index);
+void *savefile_search_block (void *trie, int slot, char *key, int keylen,
+                             int boundary, int *covered);
+struct route_view *
+savefile_version_search (struct savefile_version *v, int slot,
+                         char *key, int keylen);
+
+struct savefile_version *savefile_acquire ();
+void savefile_release ();
+uint64_t savefile_publish (struct savefile_version *v);
+
+#endif /*_BGPDUMP_SAVEFILE_H_*/
@@ -0,0 +1,793 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "ptree.h"
+
+#include "bgpdump.h"
+#include "bgpdump_option.h"
+#include "bgpdump_route.h"
+#include "bgpdump_peer.h"
+#include "bgpdump_query.h"
+#include "bgpdump_ptree.h"
+#include "bgpdump_savefile.h"
+#include "bgpdump_qcache.h"
+#include "bgpdump_server.h"
+
+#define SERVER_CLIENT_MAX 64
+
+extern char **environ;
+
+static int server_stop = 0;
+static int server_signal_pipe[2] = { -1, -1 };
+
+static struct server_query *server_queries = NULL;
+static char *server_buf = NULL;
+static size_t server_buf_size = 0;
+
+/* a client of the socket. The fd is non-blocking: the request is
+   gathered in the input buffer as it arrives, and is served only
+   when it is complete, so that a slow client does not stop the
+   others. The rest of the response that the socket does not take
+   at once is kept in the output buffer, and no request is read
+   until it is written. */
+struct server_client
+{
+  int fd;
+  char *in;
+  size_t in_len;
+  size_t in_size;
+  char *out;
+  size_t out_len;
+  size_t out_off;
+  size_t out_size;
+};
+static struct server_client server_clients[SERVER_CLIENT_MAX];
+
+/* the reload: the loader thread builds (or maps) the new version,
+   while the main thread keeps serving the current one. */
+static char *server_path = NULL;
+static char **server_argv = NULL;
+static pthread_t server_loader;
+static int server_loading = 0;     /* the loader thread is running. */
+static int server_loader_joinable = 0;
+static int server_reload_pending = 0;
+
+struct server_stat
+{
+  uint64_t reloads;
+  uint64_t failures;
+  double build_time;        /* sec, the last one. */
+  double map_time;          /* msec. */
+  double publish_time;      /* usec, including the reclaim. */
+  double reclaim_time;      /* usec, waiting for the readers. */
+};
+static struct server_stat server_stat;
+
+/* the lookup cache (-K), for the version of the generation. */
+static struct qcache *server_cache = NULL;
+static uint64_t server_cache_generation = 0;
+
+static void
+server_signal (int sig)
+{
+  char c = sig;
+  int saved_errno = errno;
+
+  if (write (server_signal_pipe[1], &c, 1) < 0)
+    ;
+  errno = saved_errno;
+}
+
+static double
+server_time ()
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/* build the savefile of the rib files in a child process, as the
+   parser keeps its states in the globals: the child is this program
+   with the same arguments, which saves the tables to the path given
+   in the environment, instead of serving. */
+static int
+server_build (char *path)
+{
+  posix_spawn_file_actions_t actions;
+  char **envp;
+  char *env;
+  pid_t pid;
+  int n, status, ret;
+
+  for (n = 0; environ[n]; n++)
+    ;
+  envp = malloc ((n + 2) * sizeof (char *));
+  assert (envp);
+  memcpy (envp, environ, n * sizeof (char *));
+  env = malloc (strlen (SERVER_RELOAD_ENV) + strlen (path) + 2);
+  assert (env);
+  sprintf (env, "%s=%s", SERVER_RELOAD_ENV, path);
+  envp[n] = env;
+  envp[n + 1] = NULL;
+
+  posix_spawn_file_actions_init (&actions);
+  posix_spawn_file_actions_addopen (&actions, 1, "/dev/null", O_WRONLY, 0);
+
+  ret = posix_spawnp (&pid, server_argv[0], &actions, NULL,
+                      server_argv, envp);
+  posix_spawn_file_actions_destroy (&actions);
+  free (env);
+  free (envp);
+  if (ret)
+    {
+      fprintf (stderr, "server: can't run %s: %s\n",
+               server_argv[0], strerror (ret));
+      return -1;
+    }
+
+  while (waitpid (pid, &status, 0) < 0)
+    if (errno != EINTR)
+      return -1;
+  if (! WIFEXITED (status) || WEXITSTATUS (status))
+    {
+      fprintf (stderr, "server: the rebuild failed.\n");
+      return -1;
+    }
+  return 0;
+}
+
+static void *
+server_reload (void *arg)
+{
+  struct savefile_version *v;
+  char *path;
+  double start, built, mapped, published;
+  uint64_t reclaim;
+
+  start = server_time ();
+
+  /* with -O, the savefile is replaced by others (e.g., by rename()).
+     otherwise, the rib files are read again. */
+  if (load_file)
+    path = load_file;
+  else
+    {
+      path = malloc (strlen (server_path) + sizeof (".reload"));
+      assert (path);
+      sprintf (path, "%s.reload", server_path);
+      if (server_build (path) < 0)
+        {
+          unlink (path);
+          free (path);
+          server_stat.failures++;
+          __atomic_store_n (&server_loading, 0, __ATOMIC_RELEASE);
+          return NULL;
+        }
+    }
+  built = server_time ();
+
+  v = savefile_map (path);
+  if (! load_file)
+    {
+      /* the mapping remains after the unlink. */
+      unlink (path);
+      free (path);
+    }
+  if (! v)
+    {
+      server_stat.failures++;
+      __atomic_store_n (&server_loading, 0, __ATOMIC_RELEASE);
+      return NULL;
+    }
+  mapped = server_time ();
+
+  reclaim = savefile_publish (v);
+  published = server_time ();
+
+  server_stat.reloads++;
+  server_stat.build_time = built - start;
+  server_stat.map_time = (mapped - built) * 1000;
+  server_stat.reclaim_time = reclaim;
+  server_stat.publish_time = (published - mapped) * 1000000;
+
+  fprintf (stderr, "server: reload #%llu: %u peers: "
+           "build %.3fs, map %.3fms, publish %.1fus (reclaim wait %.1fus).\n",
+           (unsigned long long) server_stat.reloads, v->header->nslots,
+           server_stat.build_time, server_stat.map_time,
+           server_stat.publish_time, server_stat.reclaim_time);
+
+  __atomic_store_n (&server_loading, 0, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+/* start the loader thread, with the signals blocked in it, so that
+   they are delivered to the main thread. */
+static void
+server_reload_start ()
+{
+  sigset_t set, oset;
+
+  if (__atomic_load_n (&server_loading, __ATOMIC_ACQUIRE))
+    {
+      server_reload_pending++;
+      return;
+    }
+  if (server_loader_joinable)
+    pthread_join (server_loader, NULL);
+  server_loader_joinable = 0;
+
+  server_reload_pending = 0;
+  server_loading = 1;
+  sigfillset (&set);
+  pthread_sigmask (SIG_BLOCK, &set, &oset);
+  if (pthread_create (&server_loader, NULL, server_reload, NULL))
+    {
+      fprintf (stderr, "server: can't create the loader thread.\n");
+      server_loading = 0;
+    }
+  else
+    server_loader_joinable++;
+  pthread_sigmask (SIG_SETMASK, &oset, NULL);
+}
+
+static void
+server_answer (struct server_query *q, struct server_answer *a,
+               uint32_t *path)
+{
+  static struct bgp_route decoded;
+  struct savefile_version *v;
+  struct bgp_route *route;
+  struct ptree_node *x;
+  void *data;
+  int af, i, slot;
+
+  memset (a, 0, sizeof (struct server_answer));
+
+  af = (q->af == 4 ? AF_INET : q->af == 6 ? AF_INET6 : 0);
+  q->peer_index = ntohs (q->peer_index);
+  if (! af)
+    {
+      a->status = SERVER_BAD_REQUEST;
+      return;
+    }
+
+  /* the version is not unmapped until the release. */
+  v = savefile_acquire ();
+  if (v)
+    slot = savefile_version_slot (v, q->peer_index);
+  else
+    slot = (q->peer_index < peer_size &&
+            PEER_SPEC_MATCH (q->peer_index) ?
+            PEER_SPEC_SLOT (q->peer_index) : -1);
+  if (slot < 0)
+    {
+      savefile_release ();
+      a->status = SERVER_NO_PEER;
+      return;
+    }
+
+  route = NULL;
+  if (server_cache && v && v->generation != server_cache_generation)
+    {
+      qcache_flush (server_cache);
+      server_cache_generation = v->generation;
+    }
+
+  if (v)
+    {
+      if (server_cache)
+        data = qcache_lookup (server_cache, q->peer_index, af,
+                              (char *) q->addr, savefile_search_block,
+                              v, slot);
+      else
+        data = savefile_version_search (v, slot, (char *) q->addr,
+                                        (af == AF_INET ? 32 : 128));
+      if (data)
+        {
+          route_decode (&decoded, data, v->arena);
+          route = &decoded;
+        }
+    }
+  else
+    {
+      if (server_cache)
+        data = qcache_lookup (server_cache, q->peer_index, af,
+                              (char *) q->addr, ptree_search_block,
+                              peer_ptree[slot], slot);
+      else
+        {
+          x = ptree_search ((char *) q->addr, (af == AF_INET ? 32 : 128),
+                            peer_ptree[slot]);
+          data = (x ? x->data : NULL);
+        }
+      if (data)
+        route = route_get (data);
+    }
+  savefile_release ();
+
+  if (! route || route->af != af)
+    {
+      a->status = SERVER_NOT_FOUND;
+      return;
+    }
+
+  a->status = SERVER_FOUND;
+  a->prefix_length = route->prefix_length;
+  a->path_size = MIN (route->path_size, ROUTE_PATH_LIMIT);
+  memcpy (a->prefix, route->prefix, sizeof (a->prefix));
+  memcpy (a->nexthop, route->nexthop, sizeof (a->nexthop));
+  a->origin_as = htonl (route->origin_as);
+  for (i = 0; i < a->path_size; i++)
+    path[i] = htonl (route->path_list[i]);
+}
+
+static int
+server_read (int fd, void *buf, size_t len)
+{
+  char *p = buf;
+  ssize_t ret;
+
+  while (len)
+    {
+      ret = read (fd, p, len);
+      if (ret < 0 && errno == EINTR)
+        continue;
+      if (ret <= 0)
+        return -1;
+      p += ret;
+      len -= ret;
+    }
+  return 0;
+}
+
+/* fd -1 is the stdout, which may be the stream of the output stage. */
+static int
+server_write (int fd, void *buf, size_t len)
+{
+  char *p = buf;
+  ssize_t ret;
+
+  if (fd < 0)
+    {
+      if (fwrite (buf, 1, len, stdout) != len || fflush (stdout))
+        return -1;
+      return 0;
+    }
+
+  while (len)
+    {
+      ret = write (fd, p, len);
+      if (ret < 0 && errno == EINTR)
+        continue;
+      if (ret <= 0)
+        return -1;
+      p += ret;
+      len -= ret;
+    }
+  return 0;
+}
+
+static int
+server_header_valid (struct server_header *header)
+{
+  if (ntohl (header->magic) != SERVER_MAGIC ||
+      ntohs (header->version) != SERVER_VERSION)
+    {
+      fprintf (stderr, "server: bad request header.\n");
+      return 0;
+    }
+  return 1;
+}
+
+/* answer the queries of the request (in server_queries) into
+   server_buf, and returns the length of the response. */
+static size_t
+server_response (struct server_header *header)
+{
+  struct server_answer *a;
+  size_t len, size;
+  int count, i;
+
+  count = ntohs (header->count);
+  size = sizeof (struct server_header) +
+         count * (sizeof (struct server_answer) +
+                  ROUTE_PATH_LIMIT * sizeof (uint32_t));
+  if (size > server_buf_size)
+    {
+      server_buf_size = size;
+      server_buf = realloc (server_buf, server_buf_size);
+      assert (server_buf);
+    }
+
+  memcpy (server_buf, header, sizeof (struct server_header));
+  len = sizeof (struct server_header);
+  for (i = 0; i < count; i++)
+    {
+      a = (struct server_answer *) (server_buf + len);
+      server_answer (&server_queries[i], a,
+                     (uint32_t *) (server_buf + len + sizeof (*a)));
+      len += sizeof (*a) + a->path_size * sizeof (uint32_t);
+    }
+  return len;
+}
+
+/* read a request from the fd, and write the response to the wfd.
+   (for the stdin, where the only client may block the server.) */
+static int
+server_request (int fd, int wfd)
+{
+  struct server_header header;
+
+  if (server_read (fd, &header, sizeof (header)) < 0)
+    return -1;
+  if (! server_header_valid (&header))
+    return -1;
+  if (server_read (fd, server_queries,
+                   ntohs (header.count) * sizeof (struct server_query)) < 0)
+    return -1;
+
+  return server_write (wfd, server_buf, server_response (&header));
+}
+
+/* write the pending response of the client as far as the socket
+   takes it. */
+static int
+server_client_write (struct server_client *c)
+{
+  ssize_t ret;
+
+  while (c->out_off < c->out_len)
+    {
+      ret = write (c->fd, c->out + c->out_off, c->out_len - c->out_off);
+      if (ret < 0 && errno == EINTR)
+        continue;
+      if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return 0;
+      if (ret <= 0)
+        return -1;
+      c->out_off += ret;
+    }
+  c->out_len = c->out_off = 0;
+  return 0;
+}
+
+/* send the response in server_buf, and keep the rest that the socket
+   does not take now. */
+static int
+server_client_respond (struct server_client *c, size_t len)
+{
+  ssize_t ret;
+  size_t off = 0;
+
+  while (off < len)
+    {
+      ret = write (c->fd, server_buf + off, len - off);
+      if (ret < 0 && errno == EINTR)
+        continue;
+      if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        break;
+      if (ret <= 0)
+        return -1;
+      off += ret;
+    }
+  if (off == len)
+    return 0;
+
+  if (len - off > c->out_size)
+    {
+      c->out_size = len - off;
+      c->out = realloc (c->out, c->out_size);
+      assert (c->out);
+    }
+  memcpy (c->out, server_buf + off, len - off);
+  c->out_len = len - off;
+  c->out_off = 0;
+  return 0;
+}
+
+/* read what has arrived from the client, and serve the request if
+   it is complete. returns -1 to close the client. */
+static int
+server_client_read (struct server_client *c)
+{
+  struct server_header *header;
+  size_t need;
+  ssize_t ret;
+
+  while (! c->out_len)
+    {
+      need = sizeof (struct server_header);
+      if (c->in_len >= need)
+        {
+          header = (struct server_header *) c->in;
+          if (! server_header_valid (header))
+            return -1;
+          need += ntohs (header->count) * sizeof (struct server_query);
+        }
+      if (need > c->in_size)
+        {
+          c->in_size = need;
+          c->in = realloc (c->in, c->in_size);
+          assert (c->in);
+        }
+
+      /* only up to the end of the request, and the next one is left
+         in the socket. */
+      if (c->in_len < need)
+        {
+          ret = read (c->fd, c->in + c->in_len, need - c->in_len);
+          if (ret < 0 && errno == EINTR)
+            continue;
+          if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+          if (ret <= 0)
+            return -1;
+          c->in_len += ret;
+          continue;
+        }
+      if (need == sizeof (struct server_header) &&
+          ntohs (((struct server_header *) c->in)->count))
+        continue;
+
+      /* one request at a time, for the other clients. the next one
+         in the socket is noticed by the next poll(). */
+      header = (struct server_header *) c->in;
+      memcpy (server_queries, c->in + sizeof (struct server_header),
+              need - sizeof (struct server_header));
+      c->in_len = 0;
+      return server_client_respond (c, server_response (header));
+    }
+  return 0;
+}
+
+static void
+server_client_close (struct server_client *c)
+{
+  close (c->fd);
+  free (c->in);
+  free (c->out);
+  memset (c, 0, sizeof (struct server_client));
+}
+
+static int
+server_listen (char *path)
+{
+  struct sockaddr_un sun;
+  int fd;
+
+  if (strlen (path) >= sizeof (sun.sun_path))
+    {
+      fprintf (stderr, "server: too long socket path: %s\n", path);
+      return -1;
+    }
+
+  fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    {
+      fprintf (stderr, "server: socket() failed: %s\n", strerror (errno));
+      return -1;
+    }
+
+  memset (&sun, 0, sizeof (sun));
+  sun.sun_family = AF_UNIX;
+  strcpy (sun.sun_path, path);
+  unlink (path);
+  if (bind (fd, (struct sockaddr *) &sun, sizeof (sun)) < 0 ||
+      listen (fd, SERVER_CLIENT_MAX) < 0)
+    {
+      fprintf (stderr, "server: can't listen on %s: %s\n",
+               path, strerror (errno));
+      close (fd);
+      return -1;
+    }
+  return fd;
+}
+
+static void
+server_signal_read ()
+{
+  char sig[16];
+  ssize_t ret;
+  int i;
+
+  ret = read (server_signal_pipe[0], sig, sizeof (sig));
+  for (i = 0; i < ret; i++)
+    {
+      if (sig[i] == SIGHUP)
+        server_reload_start ();
+      else
+        server_stop++;
+    }
+}
+
+static void
+server_finish ()
+{
+  if (server_cache)
+    {
+      qcache_print (stderr, server_cache);
+      qcache_delete (server_cache);
+      server_cache = NULL;
+    }
+
+  free (server_queries);
+  free (server_buf);
+  server_queries = NULL;
+  server_buf = NULL;
+  server_buf_size = 0;
+}
+
+/* server_run() serves until the stdin is closed ("-"), or until
+   SIGINT or SIGTERM for the socket. SIGHUP reloads the tables
+   (see server_reload()) without stopping the service. argv is the
+   whole arguments of the program, for the rebuild. */
+int
+server_run (char *path, char **argv)
+{
+  struct pollfd fds[SERVER_CLIENT_MAX + 2];
+  struct server_client *c;
+  struct sigaction sa;
+  int nfds, fd, i;
+
+  server_queries = malloc (65536 * sizeof (struct server_query));
+  assert (server_queries);
+  if (lookup_cache)
+    server_cache = qcache_create (lookup_cache);
+
+  /* not to the stdout, which may be the channel. */
+  if (! peer_spec_size)
+    fprintf (stderr, "warning: no peer spec. "
+             "lookup needs a specified peer.\n");
+
+  if (! strcmp (path, "-"))
+    {
+      fflush (stdout);
+      while (server_request (0, -1) == 0)
+        ;
+      server_finish ();
+      return 0;
+    }
+
+  fd = server_listen (path);
+  if (fd < 0)
+    return -1;
+  server_path = path;
+  server_argv = argv;
+
+  if (pipe (server_signal_pipe) < 0)
+    {
+      fprintf (stderr, "server: pipe() failed: %s\n", strerror (errno));
+      close (fd);
+      return -1;
+    }
+  fcntl (server_signal_pipe[0], F_SETFL, O_NONBLOCK);
+  fcntl (server_signal_pipe[1], F_SETFL, O_NONBLOCK);
+
+  memset (&sa, 0, sizeof (sa));
+  sa.sa_handler = server_signal;
+  sigaction (SIGINT, &sa, NULL);
+  sigaction (SIGTERM, &sa, NULL);
+  sigaction (SIGHUP, &sa, NULL);
+  signal (SIGPIPE, SIG_IGN);
+
+  if (verbose)
+    printf ("server: listening on %s.\n", path);
+  fflush (stdout);
+
+  fds[0].fd = fd;
+  fds[0].events = POLLIN;
+  fds[1].fd = server_signal_pipe[0];
+  fds[1].events = POLLIN;
+  nfds = 2;
+
+  while (! server_stop)
+    {
+      /* the SIGHUP during the last reload. */
+      if (server_reload_pending &&
+          ! __atomic_load_n (&server_loading, __ATOMIC_ACQUIRE))
+        server_reload_start ();
+
+      if (poll (fds, nfds, (server_reload_pending ? 100 : -1)) < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          fprintf (stderr, "server: poll() failed: %s\n", strerror (errno));
+          break;
+        }
+
+      /* the requests are served when they have arrived whole. */
+      for (i = 2; i < nfds; i++)
+        {
+          c = &server_clients[i - 2];
+          if (! fds[i].revents)
+            continue;
+          if ((fds[i].revents & POLLNVAL) ||
+              (c->out_len && server_client_write (c) < 0) ||
+              (! c->out_len && server_client_read (c) < 0))
+            {
+              server_client_close (c);
+              nfds--;
+              fds[i] = fds[nfds];
+              server_clients[i - 2] = server_clients[nfds - 2];
+              memset (&server_clients[nfds - 2], 0,
+                      sizeof (struct server_client));
+              i--;
+              continue;
+            }
+          fds[i].events = (c->out_len ? POLLOUT : POLLIN);
+        }
+
+      if (fds[0].revents & POLLIN)
+        {
+          int client = accept (fd, NULL, NULL);
+          if (client >= 0 && nfds < SERVER_CLIENT_MAX + 2)
+            {
+              fcntl (client, F_SETFL, O_NONBLOCK);
+              fds[nfds].fd = client;
+              fds[nfds].events = POLLIN;
+              fds[nfds].revents = 0;
+              server_clients[nfds - 2].fd = client;
+              nfds++;
+            }
+          else if (client >= 0)
+            close (client);
+        }
+
+      if (fds[1].revents & POLLIN)
+        server_signal_read ();
+    }
+
+  if (server_loader_joinable)
+    pthread_join (server_loader, NULL);
+  server_loader_joinable = 0;
+  if (verbose)
+    fprintf (stderr, "server: %llu reloads, %llu failures.\n",
+             (unsigned long long) server_stat.reloads,
+             (unsigned long long) server_stat.failures);
+
+  for (i = 2; i < nfds; i++)
+    server_client_close (&server_clients[i - 2]);
+  close (fds[0].fd);
+  close (fds[1].fd);
+  close (server_signal_pipe[1]);
+  server_signal_pipe[0] = server_signal_pipe[1] = -1;
+  unlink (path);
+
+  server_finish ();
+  return 0;
+}
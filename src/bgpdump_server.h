@@ -0,0 +1,81 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BGPDUMP_SERVER_H_
+#define _BGPDUMP_SERVER_H_
+
+/* The lookup server (-q) answers the longest-prefix-match queries on
+   the route tables of the specified peers (or of the savefile, -O),
+   over a Unix-domain socket, or over the stdin/stdout for "-".
+
+   A request is a batch of queries, and its response has the answers
+   in the same order. All the integers are in the network byte order.
+
+   request:  struct server_header, struct server_query [count]
+   response: struct server_header, and for each query,
+             struct server_answer, uint32_t path[path_size]
+
+   A client may send any number of requests on a connection.
+
+   On SIGHUP, the server reloads the tables in the background: the
+   savefile (-O) is mapped again, or else the rib files are read again
+   (into a savefile, by a child process). The new tables replace the
+   old ones between the requests, and the old ones are unmapped after
+   the request in progress on them. */
+
+#define SERVER_MAGIC 0x42475051   /* "BGPQ" */
+#define SERVER_VERSION 1
+
+#define SERVER_FOUND       0
+#define SERVER_NOT_FOUND   1
+#define SERVER_NO_PEER     2
+#define SERVER_BAD_REQUEST 3
+
+struct server_header
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t count;
+};
+
+struct server_query
+{
+  uint8_t af;               /* 4 or 6. */
+  uint8_t reserved;
+  uint16_t peer_index;
+  uint8_t addr[16];
+};
+
+struct server_answer
+{
+  uint8_t status;
+  uint8_t prefix_length;
+  uint8_t path_size;
+  uint8_t reserved;
+  uint8_t prefix[16];
+  uint8_t nexthop[16];
+  uint32_t origin_as;
+};
+
+/* the environment variable that makes the child process save the
+   tables to its value, instead of serving. */
+#define SERVER_RELOAD_ENV "BGPDUMP2_RELOAD_SAVE"
+
+int server_run (char *path, char **argv);
+
+#endif /*_BGPDUMP_SERVER_H_*/
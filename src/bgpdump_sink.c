@@ -0,0 +1,599 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+
+#include "benchmark.h"
+#include "ptree.h"
+
+#include "bgpdump.h"
+#include "bgpdump_option.h"
+#include "bgpdump_data.h"
+#include "bgpdump_route.h"
+#include "bgpdump_query.h"
+#include "bgpdump_ptree.h"
+#include "bgpdump_peer.h"
+#include "bgpdump_peerstat.h"
+#include "bgpdump_heatmap.h"
+#include "bgpdump_udiff.h"
+#include "bgpdump_columnar.h"
+#include "bgpdump_obuf.h"
+#include "bgpdump_extract.h"
+#include "bgpdump_mrt.h"
+#include "bgpdump_savefile.h"
+#include "bgpdump_qcache.h"
+#include "bgpdump_join.h"
+#include "bgpdump_ribshm.h"
+#include "bgpdump_diff.h"
+#include "bgpdump_matrix.h"
+#include "bgpdump_sink.h"
+
+struct sink *sink_list[SINK_MAX];
+int sink_size = 0;
+int sink_decode = 0;   /* some sink needs the decoded attributes. */
+int sink_rib = 0;      /* some sink consumes the rib entries. */
+
+
+/* peer-table (-P): the peer table is printed while it is parsed. */
+
+struct sink sink_peer_table =
+{
+  "peer-table", 0, NULL, NULL, NULL, NULL, NULL
+};
+
+/* count (-c, -C): the number of routes for each peer. */
+
+static void
+sink_count_route (int peer_index, int slot, struct bgp_route *route,
+                  char *attr, int attr_length)
+{
+  peer_count[peer_index].route_count++;
+  if (route->af == AF_INET)
+    peer_count[peer_index].route_count_ipv4++;
+  if (route->af == AF_INET6)
+    peer_count[peer_index].route_count_ipv6++;
+}
+
+static void
+sink_count_file_end ()
+{
+  if (route_count)
+    {
+      peer_route_count_show ();
+      peer_route_count_clear ();
+    }
+  if (route_count_peers)
+    peer_route_count_list ();
+}
+
+struct sink sink_count =
+{
+  "count", 0, NULL, sink_count_route, NULL, sink_count_file_end, NULL
+};
+
+/* plen-dist (-j): the number of routes for each prefixlen. */
+
+static void
+sink_plen_route (int peer_index, int slot, struct bgp_route *route,
+                 char *attr, int attr_length)
+{
+  PEER_PLEN_COUNT (peer_index)[route->prefix_length]++;
+}
+
+static void
+sink_plen_file_end ()
+{
+  peer_route_count_by_plen_show ();
+  peer_route_count_by_plen_clear ();
+}
+
+struct sink sink_plen =
+{
+  "plen-dist", 0, NULL, sink_plen_route, NULL, sink_plen_file_end, NULL
+};
+
+/* output (-b, -m, show): print the routes to the stdout. */
+
+static void
+sink_route_format (struct obuf *ob, int peer_index, struct bgp_route *route)
+{
+  if (brief)
+    route_format_brief (ob, peer_index, route);
+  else if (show)
+    route_format (ob, peer_index, route);
+  else if (compat_mode)
+    route_format_compat (ob, peer_index, route);
+}
+
+static void
+sink_output_route (int peer_index, int slot, struct bgp_route *route,
+                   char *attr, int attr_length)
+{
+  struct obuf *ob = obuf_get ();
+  sink_route_format (ob, peer_index, route);
+  obuf_write (ob, stdout);
+}
+
+struct sink sink_output =
+{
+  "output", 1, NULL, sink_output_route, NULL, NULL, NULL
+};
+
+/* mrt (-W): copy the selected rib entries to the MRT file. */
+
+static void
+sink_mrt_init ()
+{
+  if (mrt_open (mrt_file) < 0)
+    exit (-1);
+}
+
+static void
+sink_mrt_route (int peer_index, int slot, struct bgp_route *route,
+                char *attr, int attr_length)
+{
+  mrt_entry (peer_index, route, attr, attr_length);
+}
+
+static void
+sink_mrt_record_end (uint32_t sequence_number)
+{
+  mrt_record_end ();
+}
+
+struct sink sink_mrt =
+{
+  "mrt", 0, sink_mrt_init, sink_mrt_route, sink_mrt_record_end, NULL,
+  mrt_close
+};
+
+/* extract (-x): write the routes to a file for each file and peer. */
+
+static void
+sink_extract_route (int peer_index, int slot, struct bgp_route *route,
+                    char *attr, int attr_length)
+{
+  struct obuf *ob = obuf_get ();
+  sink_route_format (ob, peer_index, route);
+  extract_write (peer_index, ob->buf, OBUF_LEN (ob));
+  ob->p = ob->buf;
+}
+
+struct sink sink_extract =
+{
+  "extract", 1, extract_init, sink_extract_route, NULL, extract_file_end,
+  extract_finish
+};
+
+/* columnar (-E): export the routes in the columnar binary format. */
+
+static void
+sink_columnar_init ()
+{
+  if (columnar_open (export_file) < 0)
+    exit (-1);
+}
+
+static void
+sink_columnar_route (int peer_index, int slot, struct bgp_route *route,
+                     char *attr, int attr_length)
+{
+  columnar_route (peer_index, route);
+}
+
+struct sink sink_columnar =
+{
+  "columnar", 1, sink_columnar_init, sink_columnar_route, NULL,
+  columnar_flush, columnar_close
+};
+
+/* table (-l, -L): the route table of each specified peer,
+   for the lookup (and for the heatmap and the diff). */
+
+static void
+sink_table_init ()
+{
+  if (lookup)
+    {
+      route_init ();
+      ptree[AF_INET] = ptree_create ();
+      ptree[AF_INET6] = ptree_create ();
+    }
+}
+
+static void
+sink_table_route (int peer_index, int slot, struct bgp_route *route,
+                  char *attr, int attr_length)
+{
+  void *data;
+
+  if (slot < 0)
+    return;
+
+  data = route_table_add (slot, route, peer_index, attr, attr_length);
+  ptree_add ((char *)&route->prefix, route->prefix_length,
+             data, peer_ptree[slot]);
+}
+
+static void
+sink_table_finish ()
+{
+  int i;
+
+  if (save_file && savefile_save (save_file) < 0)
+    exit (-1);
+  if (publish_name && ribshm_publish (publish_name) < 0)
+    exit (-1);
+
+  if (! lookup || lookup_join)
+    return;
+
+  query_load ();
+  query_print ();
+
+  if (lookup_cache)
+    lookup_qcache = qcache_create (lookup_cache);
+
+  /* query to route_table (ptree). */
+  if (benchmark)
+    benchmark_start ();
+
+  if (! peer_spec_size)
+    printf ("warning: no peer spec. lookup needs a specified peer.\n");
+  for (i = 0; i < peer_spec_size; i++)
+    {
+      printf ("peer %d:\n", peer_spec_index[i]);
+      if (verbose)
+        ptree_list (peer_ptree[i]);
+      if (savefile_loaded)
+        savefile_query (i, query_table, query_size);
+      else
+        ptree_query (peer_spec_index[i], peer_ptree[i], query_table,
+                     query_size);
+    }
+
+  if (benchmark)
+    {
+      benchmark_stop ();
+      benchmark_print (query_size);
+    }
+
+  if (lookup_qcache)
+    {
+      qcache_print (stdout, lookup_qcache);
+      qcache_delete (lookup_qcache);
+      lookup_qcache = NULL;
+    }
+
+  free (query_table);
+  ptree_delete (ptree[AF_INET]);
+  ptree_delete (ptree[AF_INET6]);
+  route_finish ();
+}
+
+struct sink sink_table =
+{
+  "table", 1, sink_table_init, sink_table_route, NULL, NULL,
+  sink_table_finish
+};
+
+/* join (-J with -l, -L): the lookups merged with the rib entries,
+   without the route table (see bgpdump_join.h). */
+
+struct sink sink_join =
+{
+  "join", 0, join_init, join_route, NULL, join_file_end, join_finish
+};
+
+/* unified (-y): the first route of each prefix, printed at the end. */
+
+static void
+sink_unified_init ()
+{
+  /* the unified table is in the slot 0. */
+  peer_spec_reserve (1);
+}
+
+static void
+sink_unified_route (int peer_index, int slot, struct bgp_route *route,
+                    char *attr, int attr_length)
+{
+  void *data;
+
+  data = route_table_add (0, route, peer_index, attr, attr_length);
+  ptree_add ((char *)&route->prefix, route->prefix_length,
+             data, peer_ptree[0]);
+}
+
+static void
+sink_unified_finish ()
+{
+  struct obuf *ob = obuf_get ();
+  struct ptree_node *x;
+
+  for (x = ptree_head (peer_ptree[0]); x; x = ptree_next (x))
+    {
+      if (! x->data)
+        continue;
+      sink_route_format (ob, 0, route_get (x->data));
+      obuf_write (ob, stdout);
+    }
+}
+
+struct sink sink_unified =
+{
+  "unified", 1, sink_unified_init, sink_unified_route, NULL, NULL,
+  sink_unified_finish
+};
+
+/* heatmap (-H): drawn from the tables of the specified peers. */
+
+static void
+sink_heatmap_finish ()
+{
+  int i;
+
+  if (! strcmp (heatmap_prefix, "testprint"))
+    {
+      struct ptree *ptree;
+      unsigned char addr[4] = {0};
+      for (i = 0; i < 256; i++)
+        {
+          addr[0] = (unsigned char) i;
+          ptree = ptree_create ();
+          ptree_add ((char *)addr, 8, (void *)1, ptree);
+          heatmap_image_hilbert_gplot (i);
+          heatmap_image_hilbert_data (i, ptree);
+          ptree_delete (ptree);
+        }
+      return;
+    }
+
+  for (i = 0; i < peer_spec_size; i++)
+    {
+      int peer_index = peer_spec_index[i];
+      struct ptree *ptree = peer_ptree[i];
+      heatmap_image_hilbert_gplot (peer_index);
+      heatmap_image_hilbert_data (peer_index, ptree);
+      //heatmap_image_hilbert_data_aspath_max_distance (peer_index);
+    }
+}
+
+struct sink sink_heatmap =
+{
+  "heatmap", 0, NULL, NULL, NULL, NULL, sink_heatmap_finish
+};
+
+/* udiff (-u, -U): compare the first two peers for each prefix. */
+
+static void
+sink_udiff_init ()
+{
+  /* the diff compares the routes of the first two peers. */
+  if (peer_spec_size < 2)
+    {
+      printf ("the diff needs two peers (-p).\n");
+      exit (-1);
+    }
+}
+
+static void
+sink_udiff_route (int peer_index, int slot, struct bgp_route *route,
+                  char *attr, int attr_length)
+{
+  if (slot < 0 || slot >= 2)
+    return;
+
+  bgpdump_udiff_route (slot, route);
+}
+
+static void
+sink_udiff_record_end (uint32_t sequence_number)
+{
+  bgpdump_udiff_compare (sequence_number);
+}
+
+static void
+sink_udiff_file_end ()
+{
+  bgpdump_udiff_file_end ();
+}
+
+struct sink sink_udiff =
+{
+  "udiff", 1, sink_udiff_init, sink_udiff_route, sink_udiff_record_end,
+  sink_udiff_file_end, NULL
+};
+
+/* diff (-D): the routes of each of the two files, in a child
+   process, to the merge in the parent (see bgpdump_diff.h). */
+
+static void
+sink_diff_route (int peer_index, int slot, struct bgp_route *route,
+                 char *attr, int attr_length)
+{
+  struct obuf *ob = obuf_get ();
+
+  /* the peer is always shown, as the other file may have it in
+     another index. */
+  if (peer_spec_size == 1 && ! compat_mode)
+    {
+      obuf_str (ob, "peer[");
+      obuf_int (ob, peer_index);
+      obuf_str (ob, "]: ");
+    }
+  sink_route_format (ob, peer_index, route);
+  diff_route (peer_index, route, ob->buf, OBUF_LEN (ob));
+  ob->p = ob->buf;
+}
+
+struct sink sink_diff =
+{
+  "diff", 1, NULL, sink_diff_route, NULL, diff_file_end, diff_finish
+};
+
+/* peer-matrix (-T): the comparison of all the pairs of the peers,
+   by the entries of each record (see bgpdump_matrix.h). */
+
+struct sink sink_matrix =
+{
+  "peer-matrix", 1, NULL, matrix_route, matrix_record_end,
+  matrix_file_end, NULL
+};
+
+/* stat (-k): the statistics of each peer, shown at the end. */
+
+static void
+sink_stat_route (int peer_index, int slot, struct bgp_route *route,
+                 char *attr, int attr_length)
+{
+  peer_stat_save (peer_index, route);
+}
+
+static void
+sink_stat_finish ()
+{
+  peer_stat_show ();
+  peer_stat_finish ();
+}
+
+struct sink sink_stat =
+{
+  "stat", 1, peer_stat_init, sink_stat_route, NULL, NULL, sink_stat_finish
+};
+
+static void
+sink_add (struct sink *sink)
+{
+  assert (sink_size < SINK_MAX);
+  sink_list[sink_size++] = sink;
+  if (sink->decode)
+    sink_decode++;
+  if (sink->route)
+    sink_rib++;
+}
+
+/* sink_setup() selects the sinks by the options. The order in
+   the list is the order of the outputs at the end. */
+void
+sink_setup ()
+{
+  /* in the lazy mode, the stored routes are decoded when used. */
+  sink_table.decode = ! lazy;
+  sink_unified.decode = ! lazy;
+
+  /* the diff of the files runs alone. */
+  if (diff_files)
+    {
+      sink_add (&sink_diff);
+      return;
+    }
+
+  if (peer_table_only)
+    sink_add (&sink_peer_table);
+  if (route_count || route_count_peers || heatmap)
+    sink_add (&sink_count);
+  if (plen_dist)
+    sink_add (&sink_plen);
+  if ((brief || show || compat_mode) && ! unified)
+    sink_add (extract ? &sink_extract : &sink_output);
+  if (export_file)
+    sink_add (&sink_columnar);
+  if (mrt_file)
+    sink_add (&sink_mrt);
+  if (lookup && lookup_join)
+    sink_add (&sink_join);
+  if ((lookup && ! lookup_join) || heatmap || save_file ||
+      publish_name || serve_path)
+    sink_add (&sink_table);
+  if (unified)
+    sink_add (&sink_unified);
+  if (heatmap)
+    sink_add (&sink_heatmap);
+  if (udiff)
+    sink_add (&sink_udiff);
+  if (stat)
+    sink_add (&sink_stat);
+  if (peer_matrix)
+    sink_add (&sink_matrix);
+}
+
+void
+sink_print ()
+{
+  int i;
+  printf ("sinks:");
+  for (i = 0; i < sink_size; i++)
+    printf (" %s", sink_list[i]->name);
+  printf (" (decode: %s)\n", (sink_decode ? "yes" : "no"));
+}
+
+void
+sink_init ()
+{
+  int i;
+  for (i = 0; i < sink_size; i++)
+    if (sink_list[i]->init)
+      (*sink_list[i]->init) ();
+}
+
+void
+sink_route (int peer_index, int slot, struct bgp_route *route,
+            char *attr, int attr_length)
+{
+  int i;
+  for (i = 0; i < sink_size; i++)
+    if (sink_list[i]->route)
+      (*sink_list[i]->route) (peer_index, slot, route, attr, attr_length);
+}
+
+void
+sink_record_end (uint32_t sequence_number)
+{
+  int i;
+  for (i = 0; i < sink_size; i++)
+    if (sink_list[i]->record_end)
+      (*sink_list[i]->record_end) (sequence_number);
+}
+
+void
+sink_file_end ()
+{
+  int i;
+  for (i = 0; i < sink_size; i++)
+    if (sink_list[i]->file_end)
+      (*sink_list[i]->file_end) ();
+}
+
+void
+sink_finish ()
+{
+  int i;
+  for (i = 0; i < sink_size; i++)
+    if (sink_list[i]->finish)
+      (*sink_list[i]->finish) ();
+}
@@ -0,0 +1,63 @@
+/*
+ * Bgpdump2: A Tool to Read and Compare the BGP RIB Dump Files.
+ * Copyright (C) 2015.  Yasuhiro Ohara <yasu@nttv6.jp>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BGPDUMP_SINK_H_
+#define _BGPDUMP_SINK_H_
+
+/* A sink is one analysis that consumes the rib entries. The sinks
+   selected by the options are all run over the same parse of the
+   files, so that combining the modes costs one decompression.
+
+   route() is called for each rib entry that passes the peer spec and
+   the filter. slot is the index in peer_spec_index[], or -1 if the
+   peer is not specified. The attributes in the route are decoded
+   only if a sink sets decode (attr points to the raw ones). */
+
+struct sink
+{
+  char *name;
+  int decode;
+  void (*init) ();
+  void (*route) (int peer_index, int slot, struct bgp_route *route,
+                 char *attr, int attr_length);
+  void (*record_end) (uint32_t sequence_number);
+  void (*file_end) ();
+  void (*finish) ();
+};
+
+#define SINK_MAX 16
+
+extern struct sink sink_table;
+extern struct sink sink_join;
+
+extern struct sink *sink_list[];
+extern int sink_size;
+extern int sink_decode;
+extern int sink_rib;
+
+void sink_setup ();
+void sink_print ();
+
+void sink_init ();
+void sink_route (int peer_index, int slot, struct bgp_route *route,
+                 char *attr, int attr_length);
+void sink_record_end (uint32_t sequence_number);
+void sink_file_end ();
+void sink_finish ();
+
+#endif /*_BGPDUMP_SINK_H_*/
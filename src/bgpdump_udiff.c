@@ -33,153 +33,214 @@
 #include "bgpdump_route.h"
 #include "bgpdump_peer.h"
 
+/* the routes of the two peers in the current record. Only the pair
+   is kept: the records come in the order of the prefixes, so that the
+   reachability (-r) needs only the routes covering the current one. */
+static struct bgp_route udiff_route[2];
+
+/* a covering route, only what the classification looks at. */
+struct udiff_cover
+{
+  char prefix[MAX_ADDR_LENGTH];
+  uint8_t prefix_length;
+  char flag;
+};
+
+/* the stack of the routes covering the current prefix, in a side
+   and an address family. */
+struct udiff_stack
+{
+  struct udiff_cover cover[MAX_ADDR_LENGTH * 8 + 1];
+  int size;
+};
+
+static struct udiff_stack udiff_stack[2][2];
+
+/* the last prefix in each address family, to detect the records
+   out of the order. */
+static struct udiff_cover udiff_last[2];
+static int udiff_last_valid[2];
+static int udiff_unordered = 0;
+
+/* bgpdump_udiff_route() keeps the route of the side (0: left, 1:
+   right) for the current record. */
+void
+bgpdump_udiff_route (int side, struct bgp_route *route)
+{
+  udiff_route[side] = *route;
+}
+
+/* the order of the prefixes in the rib: the address, then the
+   shorter first. */
+static int
+udiff_cover_cmp (struct udiff_cover *a, struct bgp_route *b)
+{
+  int ret = memcmp (a->prefix, b->prefix, MAX_ADDR_LENGTH);
+  if (ret)
+    return ret;
+  return (int) a->prefix_length - (int) b->prefix_length;
+}
+
+/* pop the routes not covering the route, and returns the longest
+   covering one, if any. */
+static struct udiff_cover *
+udiff_cover (struct udiff_stack *s, struct bgp_route *route)
+{
+  struct udiff_cover *top;
+
+  while (s->size)
+    {
+      top = &s->cover[s->size - 1];
+      if (top->prefix_length < route->prefix_length &&
+          ptree_match (top->prefix, route->prefix, top->prefix_length))
+        return top;
+      s->size--;
+    }
+  return NULL;
+}
+
+static void
+udiff_push (struct udiff_stack *s, struct bgp_route *route)
+{
+  struct udiff_cover *c;
+
+  if (s->size >= MAX_ADDR_LENGTH * 8 + 1)
+    return;
+  c = &s->cover[s->size++];
+  memcpy (c->prefix, route->prefix, MAX_ADDR_LENGTH);
+  c->prefix_length = route->prefix_length;
+  c->flag = route->flag;
+}
+
+static void
+udiff_print (char flag, int side, struct bgp_route *route)
+{
+  route->flag = flag;
+  printf ("%c", flag);
+  route_print (stdout, peer_spec_index[side], route);
+}
+
+/* udiff_classify() classifies the reachability (-r) of the prefix
+   of the record. The longest covering route of each side is on the
+   top of its stack, so that no table of the whole rib is needed.
+
+   <: the prefix is only in left, and no route in right covers it.
+   >: the prefix is only in right, and no route in left covers it.
+   -, +: the prefix is only in left (right), and covered in the other.
+   (: the prefix is in left, and the covering route in right is '>'.
+   ): the prefix is in right, and the covering route in left is '<'. */
+static void
+udiff_classify (struct bgp_route *left, struct bgp_route *right)
+{
+  struct bgp_route *route = (left ? left : right);
+  struct udiff_cover *cover[2];
+  int af = (route->af == AF_INET6);
+
+  if (udiff_last_valid[af] &&
+      udiff_cover_cmp (&udiff_last[af], route) > 0 && ! udiff_unordered)
+    {
+      fprintf (stderr, "udiff: the prefixes are not in order; "
+               "the reachability (-r) may be wrong.\n");
+      udiff_unordered++;
+    }
+  memcpy (udiff_last[af].prefix, route->prefix, MAX_ADDR_LENGTH);
+  udiff_last[af].prefix_length = route->prefix_length;
+  udiff_last_valid[af] = 1;
+
+  cover[0] = udiff_cover (&udiff_stack[0][af], route);
+  cover[1] = udiff_cover (&udiff_stack[1][af], route);
+
+  if (left && ! right)
+    {
+      if (! cover[1])
+        udiff_print ('<', 0, left);
+      else if (cover[1]->flag == '>')
+        udiff_print ('(', 0, left);
+      else
+        udiff_print ('-', 0, left);
+    }
+  else if (right && ! left)
+    {
+      if (! cover[0])
+        udiff_print ('>', 1, right);
+      else if (cover[0]->flag == '<')
+        udiff_print (')', 1, right);
+      else
+        udiff_print ('+', 1, right);
+    }
+  else
+    {
+      /* in both, but the shorter in the other may be unreachable. */
+      if (cover[1] && cover[1]->flag == '>')
+        udiff_print ('(', 0, left);
+      if (cover[0] && cover[0]->flag == '<')
+        udiff_print (')', 1, right);
+    }
+
+  if (left)
+    udiff_push (&udiff_stack[0][af], left);
+  if (right)
+    udiff_push (&udiff_stack[1][af], right);
+}
+
+/* bgpdump_udiff_compare() compares the routes of the two peers in
+   the record, and forgets them for the next. */
 void
 bgpdump_udiff_compare (uint32_t sequence_number)
 {
-  struct bgp_route *route;
-  struct bgp_route *rt0 = peer_route_table[0];
-  struct bgp_route *rt1 = peer_route_table[1];
-  struct ptree *pt0 = peer_ptree[0];
-  struct ptree *pt1 = peer_ptree[1];
+  struct bgp_route *left = &udiff_route[0];
+  struct bgp_route *right = &udiff_route[1];
 
   if (udiff_verbose)
     {
       printf ("seq: %lu\n", (unsigned long) sequence_number);
-      if (! IS_ROUTE_NULL (&rt0[sequence_number]))
+      if (! IS_ROUTE_NULL (left))
         {
-          route = &rt0[sequence_number];
           printf ("{");
-          route_print (stdout, peer_spec_index[0], route);
+          route_print (stdout, peer_spec_index[0], left);
         }
-      if (! IS_ROUTE_NULL (&rt1[sequence_number]))
+      if (! IS_ROUTE_NULL (right))
         {
-          route = &rt1[sequence_number];
           printf ("}");
-          route_print (stdout, peer_spec_index[1], route);
+          route_print (stdout, peer_spec_index[1], right);
         }
     }
 
-  /* only in left */
-  if (! IS_ROUTE_NULL (&rt0[sequence_number]) &&
-      IS_ROUTE_NULL (&rt1[sequence_number]))
+  if (IS_ROUTE_NULL (left))
+    left = NULL;
+  if (IS_ROUTE_NULL (right))
+    right = NULL;
+
+  if (udiff_lookup)
+    {
+      if (left || right)
+        udiff_classify (left, right);
+    }
+  else
     {
-      route = &rt0[sequence_number];
-      if (! udiff_lookup)
+      /* only in left */
+      if (left && ! right)
         {
           printf ("-");
-          route_print (stdout, peer_spec_index[0], route);
+          route_print (stdout, peer_spec_index[0], left);
         }
-      else
-        {
-          struct ptree_node *x;
-          int plen = (qafi == AF_INET ? 32 : 128);
-          x = ptree_search ((char *)&route->prefix, plen, pt1);
-          if (x)
-            {
-              /* only in left but also entirely reachable in right */
-              struct bgp_route *other = x->data;
-              if (other->flag == '>')
-                {
-                  route->flag = '(';
-                  printf ("(");
-                }
-              else
-                {
-                  route->flag = '-';
-                  printf ("-");
-                }
-              route_print (stdout, peer_spec_index[0], route);
-            }
-          else
-            {
-              /* only in left and unreachable in right (maybe partially) */
-              route->flag = '<';
-              printf ("<");
-              route_print (stdout, peer_spec_index[0], route);
-            }
-        }
-    }
 
-  /* only in right */
-  if (IS_ROUTE_NULL (&rt0[sequence_number]) &&
-      ! IS_ROUTE_NULL (&rt1[sequence_number]))
-    {
-      route = &rt1[sequence_number];
-      if (! udiff_lookup)
+      /* only in right */
+      if (right && ! left)
         {
           printf ("+");
-          route_print (stdout, peer_spec_index[1], route);
-        }
-      else
-        {
-          struct ptree_node *x;
-          int plen = (qafi == AF_INET ? 32 : 128);
-          x = ptree_search ((char *)&route->prefix, plen, pt0);
-          if (x)
-            {
-              /* only in right but also entirely reachable in left */
-              struct bgp_route *other = x->data;
-              if (other->flag == '<')
-                {
-                  route->flag = ')';
-                  printf (")");
-                }
-              else
-                {
-                  route->flag = '+';
-                  printf ("+");
-                }
-              route_print (stdout, peer_spec_index[1], route);
-            }
-          else
-            {
-              /* only in right and unreachable in left (maybe partially) */
-              route->flag = '>';
-              printf (">");
-              route_print (stdout, peer_spec_index[1], route);
-            }
+          route_print (stdout, peer_spec_index[1], right);
         }
     }
 
-  /* exist in both */
-  if (! IS_ROUTE_NULL (&rt0[sequence_number]) &&
-      ! IS_ROUTE_NULL (&rt1[sequence_number]) &&
-      rt0[sequence_number].prefix_length > 0)
-    {
-      int plen = rt0[sequence_number].prefix_length - 1;
-
-      if (udiff_lookup)
-        {
-          struct ptree_node *x;
-
-          route = &rt0[sequence_number];
-          x = ptree_search ((char *)&route->prefix, plen, pt1);
-          if (x)
-            {
-              /* the shorter in right was '>' */
-              struct bgp_route *other = x->data;
-              if (other->flag == '>')
-                {
-                  route->flag = '(';
-                  printf ("(");
-                  route_print (stdout, peer_spec_index[0], route);
-                }
-            }
-
-          route = &rt1[sequence_number];
-          x = ptree_search ((char *)&route->prefix, plen, pt0);
-          if (x)
-            {
-              /* the shorter in left was '<' */
-              struct bgp_route *other = x->data;
-              if (other->flag == '<')
-                {
-                  route->flag = ')';
-                  printf (")");
-                  route_print (stdout, peer_spec_index[1], route);
-                }
-            }
-        }
-    }
+  memset (udiff_route, 0, sizeof (udiff_route));
 }
 
+/* bgpdump_udiff_file_end() starts over the covering routes for the
+   next file. */
+void
+bgpdump_udiff_file_end ()
+{
+  memset (udiff_stack, 0, sizeof (udiff_stack));
+  memset (udiff_last_valid, 0, sizeof (udiff_last_valid));
+}
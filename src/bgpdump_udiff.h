@@ -19,8 +19,12 @@
 #ifndef _BGPDUMP_UDIFF_H_
 #define _BGPDUMP_UDIFF_H_
 
+void
+bgpdump_udiff_route (int side, struct bgp_route *route);
 void
 bgpdump_udiff_compare (uint32_t sequence_number);
+void
+bgpdump_udiff_file_end ();
 
 #endif /*_BGPDUMP_UDIFF_H_*/
 